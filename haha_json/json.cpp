@@ -1,5 +1,9 @@
 #include "json.h"
 #include <limits.h>
+#include <stdint.h>
+#include <charconv>
+#include <algorithm>
+#include <iterator>
 
 namespace haha
 {
@@ -9,19 +13,23 @@ namespace json
 
 /* ---------------------------------------------parse--------------------------------------------- */
 
-JsonNode::ptr parse_string(std::string_view &str){
-    if(str[0] != '"')return nullptr;
-    str.remove_prefix(1);
-
-    std::string output;
+bool parse_escaped(std::string_view &str, std::string &output){
     while(!str.empty() && str[0] != '"'){
         if(str[0] == '\\'){
             if(str.size() < 2){
-                return nullptr;
+                return false;
             }
             // 处理转义字符
             switch (str[1]) 
             {
+                case '"':
+                    output += '"';
+                    str.remove_prefix(2);
+                    break;
+                case '/':
+                    output += '/';
+                    str.remove_prefix(2);
+                    break;
                 case '\\':
                     output += '\\';
                     str.remove_prefix(2);
@@ -55,12 +63,12 @@ JsonNode::ptr parse_string(std::string_view &str){
                     {
                         std::string hexs;
                         str.remove_prefix(2);
-                        while(util::isHex(str[0])){
+                        while(!str.empty() && util::isHex(str[0])){
                             hexs += str[0];
                             str.remove_prefix(1);
                         }
                         if(hexs.empty()){
-                            return nullptr;
+                            return false;
                         }
                         output += std::move(std::to_string(util::toBase<int, 16>(hexs)));
                         break;
@@ -70,207 +78,887 @@ JsonNode::ptr parse_string(std::string_view &str){
                     {
                         auto temp = std::move(util::utf16_literal_to_utf8(str));
                         if(temp.empty()){
-                            return nullptr;
+                            return false;
                         }
                         output += std::move(temp);
                         break;
                     }
                 default:
-                    return nullptr;
+                    return false;
             }
         }
         else{
-            output += str[0];
-            str.remove_prefix(1);
+            // 两个转义符之间的普通字符整段追加
+            size_t n = 1;
+            while(n < str.size() && str[n] != '"' && str[n] != '\\'){
+                ++n;
+            }
+            output.append(str.data(), n);
+            str.remove_prefix(n);
         }
     }
 
-    if(str.empty() || str[0] != '"')return nullptr;
+    if(str.empty() || str[0] != '"')return false;
     str.remove_prefix(1);
+    return true;
+}
 
-    JsonString::ptr jstr(std::make_shared<JsonString>(output));
 
-    return std::static_pointer_cast<JsonNode>(jstr);
+JsonString::ptr ParseContext::makeString(std::string_view raw, EscapeHint hint){
+    JsonString::ptr res;
+    if(opts_.borrowed){
+        res = make<JsonString>(raw, owner_);
+    }
+    else{
+        res = make<JsonString>(std::string(raw));
+    }
+    res->setEscapeHint(hint);
+    return res;
 }
 
 
-JsonNode::ptr parse_number(std::string_view &str){
-    if(!isdigit(str[0]) && str[0] != '-')return nullptr;
-
-    bool isInt = true;
-    double number = 0;
-    std::string number_str;
-    while(!str.empty() && util::isNumberComponent(str[0])){
-        isInt = str[0] != '.';
-        number_str += str[0];
-        str.remove_prefix(1);
+JsonString::ptr ParseContext::makeEscapedString(const char *raw_begin, std::string_view unescaped){
+    if(!opts_.borrowed){
+        return make<JsonString>(std::string(unescaped));
     }
-    try{
-        number = std::stod(number_str);
+    // 反转义后不会变长，可写的输入直接原地覆盖
+    if(raw_begin >= wbegin_ && raw_begin < wend_){
+        char *dst = const_cast<char*>(raw_begin);
+        memcpy(dst, unescaped.data(), unescaped.size());
+        return make<JsonString>(std::string_view(dst, unescaped.size()), owner_);
     }
-    catch(std::exception& e)
-    {
-        return nullptr;
+    if(arena_){
+        char *dst = static_cast<char*>(arena_->allocate(unescaped.size(), 1));
+        memcpy(dst, unescaped.data(), unescaped.size());
+        return make<JsonString>(std::string_view(dst, unescaped.size()), nullptr);
+    }
+    if(pool_ == nullptr){
+        pool_ = std::make_shared<JsonStringPool>();
     }
+    return make<JsonString>(pool_->store(unescaped), pool_);
+}
+
 
-    JsonNode::ptr res = nullptr;
-    if(isInt && number <= INT_MAX && number >= INT_MIN){
-        res = std::make_shared<JsonInteger>((int)number);
+bool scan_number(std::string_view str, NumberToken &tok){
+    const char *p = str.data();
+    const char *end = p + str.size();
+
+    if(p != end && *p == '-'){
+        tok.negative = true;
+        ++p;
+    }
+    if(p == end || !util::isNumber(*p)){
+        return false;
+    }
+    if(*p == '0'){
+        ++p;
     }
     else{
-        res = std::make_shared<JsonDouble>(number);
+        while(p != end && util::isNumber(*p)){
+            uint64_t d = *p - '0';
+            if(tok.magnitude > (UINT64_MAX - d) / 10){
+                tok.overflow = true;
+            }
+            tok.magnitude = tok.magnitude * 10 + d;
+            ++p;
+        }
     }
 
-    return res;
+    if(p != end && *p == '.'){
+        tok.integer = false;
+        ++p;
+        if(p == end || !util::isNumber(*p)){
+            return false;
+        }
+        while(p != end && util::isNumber(*p)){
+            ++p;
+        }
+    }
+
+    if(p != end && util::isExponent(*p)){
+        tok.integer = false;
+        ++p;
+        if(p != end && (*p == '+' || *p == '-')){
+            ++p;
+        }
+        if(p == end || !util::isNumber(*p)){
+            return false;
+        }
+        while(p != end && util::isNumber(*p)){
+            ++p;
+        }
+    }
+
+    tok.len = p - str.data();
+    return true;
 }
 
 
-JsonNode::ptr parse_array(std::string_view &str){
-    if(str[0] != '[')return nullptr;
-    str.remove_prefix(1);
+JsonType number_type(const NumberToken &tok){
+    if(tok.integer && !tok.overflow){
+        uint64_t m = tok.magnitude;
+        if(tok.negative){
+            if(m <= (uint64_t)INT_MAX + 1){
+                return JsonType::Integer;
+            }
+            if(m <= (uint64_t)INT64_MAX + 1){
+                return JsonType::Int64;
+            }
+        }
+        else{
+            if(m <= (uint64_t)INT_MAX){
+                return JsonType::Integer;
+            }
+            if(m <= (uint64_t)INT64_MAX){
+                return JsonType::Int64;
+            }
+            return JsonType::UInt64;
+        }
+    }
+    return JsonType::Double;
+}
 
-    JsonArray::ptr arr(std::make_shared<JsonArray>());
 
-    if(!str.empty() && str[0] == ']'){
-        str.remove_prefix(1);
-        return arr;
+static JsonNode::ptr make_number(std::string_view text, const NumberToken &tok, ParseContext &ctx){
+    uint64_t m = tok.magnitude;
+    switch (number_type(tok))
+    {
+    case JsonType::Integer:
+        return ctx.make<JsonInteger>(tok.negative ? (int)(0 - m) : (int)m);
+    case JsonType::Int64:
+        return ctx.make<JsonInt64>(tok.negative ? (int64_t)(0 - m) : (int64_t)m);
+    case JsonType::UInt64:
+        return ctx.make<JsonUInt64>(m);
+    default:
+        break;
     }
 
-    auto check_func = [&str](){
-        if(str[0] == ','){
-            str.remove_prefix(1);
-            /* 支持最后一个加逗号 */
-            if(str.size() && str[0] == ']'){
-                return false;
-            }
-            return true;
+    double number = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), number);
+    if(ec != std::errc() || ptr != text.data() + text.size()){
+        // 超出double范围
+        return nullptr;
+    }
+    return ctx.make<JsonDouble>(number);
+}
+
+
+/* 延迟模式只记下原文，类型由扫描结果决定
+   整数的类型已保证放得下；浮点数只有带指数或位数很多时才可能超出double范围，这时照常转换一遍，与非延迟模式一样拒绝 */
+static JsonNode::ptr make_lazy_number(std::string_view text, const NumberToken &tok, ParseContext &ctx){
+    const auto &owner = ctx.owner();
+    switch (number_type(tok))
+    {
+    case JsonType::Integer:
+        return ctx.make<JsonInteger>(text, owner);
+    case JsonType::Int64:
+        return ctx.make<JsonInt64>(text, owner);
+    case JsonType::UInt64:
+        return ctx.make<JsonUInt64>(text, owner);
+    default:
+        break;
+    }
+    if(text.size() > 300 || text.find_first_of("eE") != std::string_view::npos){
+        double number = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), number);
+        if(ec != std::errc() || ptr != text.data() + text.size()){
+            return nullptr;
         }
+    }
+    return ctx.make<JsonDouble>(text, owner);
+}
+
+
+/* 对象的键不创建JsonString节点：没有转义时key直接指向输入，否则反转义到scratch */
+static bool parse_key(std::string_view &str, std::string &scratch, std::string_view &key){
+    if(str.empty() || str[0] != '"')return false;
+    str.remove_prefix(1);
+
+    size_t n = 0;
+    while(n < str.size() && str[n] != '"' && str[n] != '\\'){
+        ++n;
+    }
+    if(n == str.size())return false;
+
+    if(str[n] == '"'){
+        key = str.substr(0, n);
+        str.remove_prefix(n + 1);
+        return true;
+    }
+    scratch.assign(str.data(), n);
+    str.remove_prefix(n);
+    if(!parse_escaped(str, scratch)){
         return false;
+    }
+    key = scratch;
+    return true;
+}
+
+
+/* 建树的事件处理器：容器开始时入栈，结束时出栈挂到上一层 */
+class DomBuilder : public SaxHandler{
+public:
+    explicit DomBuilder(ParseContext &ctx):ctx_(ctx){}
+
+    JsonNode::ptr root() { return std::move(root_); }
+
+    bool onNull(){
+        return add(ctx_.make<JsonNull>());
+    }
+    bool onBool(bool b){
+        return add(ctx_.make<JsonBoolean>(b));
+    }
+    bool onRawNumber(std::string_view raw, const NumberToken &tok){
+        JsonNode::ptr res = ctx_.options().lazy_numbers
+                            ? make_lazy_number(raw, tok, ctx_)
+                            : make_number(raw, tok, ctx_);
+        return res != nullptr && add(std::move(res));
+    }
+    bool onRawString(std::string_view value, const char *escaped, EscapeHint hint){
+        return add(escaped ? ctx_.makeEscapedString(escaped, value) : ctx_.makeString(value, hint));
+    }
+    bool onKey(std::string_view key){
+        stack_.back().key = ctx_.makeKey(key);
+        return true;
+    }
+    bool onObjectStart(){
+        auto obj = ctx_.make<JsonObject>(ctx_.options().object_index);
+        JsonObject *p = obj.get();
+        stack_.push_back({std::move(obj), p, nullptr, ObjectKey()});
+        return true;
+    }
+    bool onObjectEnd(size_t){
+        return pop();
+    }
+    bool onArrayStart(){
+        auto arr = ctx_.make<JsonArray>();
+        JsonArray *p = arr.get();
+        stack_.push_back({std::move(arr), nullptr, p, ObjectKey()});
+        return true;
+    }
+    bool onArrayEnd(size_t){
+        return pop();
+    }
+
+    /* 之后的事件加到已有的容器里，用于解析容器内部的一段 */
+    void into(const JsonNode::ptr &container){
+        JsonObject *obj = container->isObject() ? static_cast<JsonObject*>(container.get()) : nullptr;
+        JsonArray *arr = obj ? nullptr : static_cast<JsonArray*>(container.get());
+        stack_.push_back({container, obj, arr, ObjectKey()});
+    }
+
+protected:
+    struct Frame{
+        JsonNode::ptr node;
+        JsonObject *obj;
+        JsonArray *arr;
+        ObjectKey key;      // 对象中等待值的键
     };
 
-    do{
-        str = util::skip_CtrlAndSpace(str);
-        if(str.empty()){return nullptr;}
-        auto jv = parse_value(str);
-        if(jv == nullptr){
-            return nullptr;
+    bool add(JsonNode::ptr v){
+        v = ctx_.intern(std::move(v));
+        if(stack_.empty()){
+            root_ = std::move(v);
+            return true;
         }
-        arr->add(jv);
-        str = util::skip_CtrlAndSpace(str);
-    } while(!str.empty() && check_func());
+        Frame &top = stack_.back();
+        if(top.obj){
+            top.obj->getValue().emplace(std::move(top.key), std::move(v));
+        }
+        else{
+            top.arr->add(std::move(v));
+        }
+        return true;
+    }
+
+    bool pop(){
+        JsonNode::ptr node = std::move(stack_.back().node);
+        stack_.pop_back();
+        return add(std::move(node));
+    }
+
+protected:
+    ParseContext &ctx_;
+    std::vector<Frame> stack_;
+    JsonNode::ptr root_;
+};
+
 
-    if(str[0] != ']'){
+/* 树就是事件解析的一种处理器 */
+JsonNode::ptr parse_value(std::string_view &str, ParseContext &ctx){
+    DomBuilder builder(ctx);
+    if(SaxReader<DomBuilder>(builder).parseValue(str) != SaxResult::Ok){
         return nullptr;
     }
-    str.remove_prefix(1);
+    return builder.root();
+}
 
-    return std::static_pointer_cast<JsonNode>(arr);
+
+JsonNode::ptr parse_string(std::string_view &str, ParseContext &ctx){
+    if(str.empty() || str[0] != '"')return nullptr;
+    return parse_value(str, ctx);
+}
+
+
+JsonNode::ptr parse_number(std::string_view &str, ParseContext &ctx){
+    if(str.empty() || (str[0] != '-' && !util::isNumber(str[0])))return nullptr;
+    return parse_value(str, ctx);
 }
 
 
+JsonNode::ptr parse_array(std::string_view &str, ParseContext &ctx){
+    if(str.empty() || str[0] != '[')return nullptr;
+    return parse_value(str, ctx);
+}
+
+
+JsonNode::ptr parse_object(std::string_view &str, ParseContext &ctx){
+    if(str.empty() || str[0] != '{')return nullptr;
+    return parse_value(str, ctx);
+}
+
+JsonNode::ptr parse_string(std::string_view &str){
+    ParseContext ctx;
+    return parse_string(str, ctx);
+}
+
+JsonNode::ptr parse_number(std::string_view &str){
+    ParseContext ctx;
+    return parse_number(str, ctx);
+}
+
+JsonNode::ptr parse_array(std::string_view &str){
+    ParseContext ctx;
+    return parse_array(str, ctx);
+}
+
 JsonNode::ptr parse_object(std::string_view &str){
-    if(str[0] != '{')return nullptr;
-    str.remove_prefix(1);
+    ParseContext ctx;
+    return parse_object(str, ctx);
+}
 
-    JsonObject::ptr obj(std::make_shared<JsonObject>());
+JsonNode::ptr parse_value(std::string_view &str){
+    ParseContext ctx;
+    return parse_value(str, ctx);
+}
 
-    if(!str.empty() && str[0] == '}'){
-        str.remove_prefix(1);
-        return obj;
-    }
+/* ---------------------------------------------projection--------------------------------------------- */
 
-    auto check_func = [&str](){
-        if(str[0] == ','){
-            str.remove_prefix(1);
-            /* 支持最后一个加逗号 */
-            if(str.size() && str[0] == '}'){
+/* 按投影建树：每层记下自动机的状态，没被选中的值让SaxReader直接跳过 */
+class ProjectionBuilder : public DomBuilder{
+public:
+    ProjectionBuilder(ParseContext &ctx, const Projection &projection)
+        :DomBuilder(ctx), proj_(projection), next_(projection.start()){}
+
+    bool skipValue(char first){
+        if(!frames_.empty()){
+            Frame &top = frames_.back();
+            if(proj_.accepts(top.state)){
                 return false;
             }
+            if(top.array){
+                next_ = proj_.stepIndex(top.state, top.index++);
+            }
+        }
+        if(next_ == Projection::dead){
             return true;
         }
-        return false;
+        // 路径还没走完时只有容器可能含有选中的值
+        return !proj_.accepts(next_) && first != '{' && first != '[';
+    }
+
+    bool onKey(std::string_view key){
+        Frame &top = frames_.back();
+        if(!proj_.accepts(top.state)){
+            next_ = proj_.step(top.state, key);
+            if(next_ == Projection::dead){
+                // 值会被跳过，键也不必保存
+                return true;
+            }
+        }
+        return DomBuilder::onKey(key);
+    }
+    bool onObjectStart(){
+        push(false);
+        return DomBuilder::onObjectStart();
+    }
+    bool onObjectEnd(size_t count){
+        return drop() || DomBuilder::onObjectEnd(count);
+    }
+    bool onArrayStart(){
+        push(true);
+        return DomBuilder::onArrayStart();
+    }
+    bool onArrayEnd(size_t count){
+        return drop() || DomBuilder::onArrayEnd(count);
+    }
+
+private:
+    struct Frame{
+        uint32_t state;
+        bool array;
+        size_t index;   // 数组中下一个元素的下标
     };
 
-    do{
-        str = util::skip_CtrlAndSpace(str);
-        if(str.empty()){return nullptr;}
+    void push(bool array){
+        uint32_t state = next_;
+        if(!frames_.empty() && proj_.accepts(frames_.back().state)){
+            state = frames_.back().state;
+        }
+        frames_.push_back({state, array, 0});
+    }
 
-        // 解析键
-        auto k = parse_string(str);
-        if(k == nullptr){
-            return nullptr;
+    /* 路径上的容器里没有选中任何值时丢掉它，返回true；根值总是保留 */
+    bool drop(){
+        bool accepted = proj_.accepts(frames_.back().state);
+        frames_.pop_back();
+        auto &top = stack_.back();
+        bool empty = top.obj ? top.obj->empty() : top.arr->empty();
+        if(accepted || !empty || stack_.size() == 1){
+            return false;
         }
+        stack_.pop_back();
+        return true;
+    }
 
-        str = util::skip_CtrlAndSpace(str);
+private:
+    const Projection &proj_;
+    uint32_t next_;
+    std::vector<Frame> frames_;
+};
 
-        // 分隔符
-        if(str[0] != ':'){
-            return nullptr;
-        }
-        str.remove_prefix(1);
 
-        str = util::skip_CtrlAndSpace(str);
+JsonNode::ptr parse(std::string_view str, const Projection &projection, const ParseOptions &opts){
+    ParseContext ctx(opts);
+    auto view = util::skip_CtrlAndSpace(util::skip_utf8_bom(str));
+    ProjectionBuilder builder(ctx, projection);
+    if(SaxReader<ProjectionBuilder>(builder).parseValue(view) != SaxResult::Ok
+        || !util::skip_CtrlAndSpace(view).empty())
+    {
+        return nullptr;
+    }
+    return builder.root();
+}
+
+/* ---------------------------------------------parallel--------------------------------------------- */
 
-        // 解析值
-        if(str.empty()){return nullptr;}
-        auto v = parse_value(str);
-        if(v == nullptr){
-            return nullptr;
+/* 并行解析：预扫描找出的大容器按切分处分成几段，各段在线程池里各自解析成一个部分容器，再按顺序拼接
+   段里遇到更小的大容器时同样展开，在线程池的线程里等待时会帮着执行任务 */
+class ParallelParser{
+public:
+    ParallelParser(std::string_view input, std::vector<ContainerSpan> spans, ParseContext &ctx, ThreadPool &pool)
+        :input_(input), spans_(std::move(spans)), ctx_(ctx), pool_(pool){}
+
+    /* 解析input开头的一个值，rest为值之后的部分 */
+    JsonNode::ptr parse(std::string_view &rest);
+
+    /* 从p开始的容器是不是预扫描找出的大容器 */
+    const ContainerSpan* find(const char *p) const {
+        size_t pos = p - input_.data();
+        auto it = std::lower_bound(spans_.begin(), spans_.end(), pos, [](const ContainerSpan &s, size_t pos){
+            return s.open < pos;
+        });
+        return it != spans_.end() && it->open == pos ? &*it : nullptr;
+    }
+
+    JsonNode::ptr parseSpan(const ContainerSpan &span);
+
+private:
+    JsonNode::ptr parseChunk(ParseContext &ctx, bool is_obj, size_t begin, size_t end, bool last);
+
+private:
+    std::string_view input_;
+    std::vector<ContainerSpan> spans_;
+    ParseContext &ctx_;
+    ThreadPool &pool_;
+};
+
+
+/* 遇到大容器时交给ParallelParser，其余同DomBuilder */
+class SpanBuilder : public DomBuilder{
+public:
+    SpanBuilder(ParseContext &ctx, ParallelParser &parser):DomBuilder(ctx), parser_(parser){}
+
+    bool takeContainer(std::string_view &str, bool &ok){
+        const ContainerSpan *span = parser_.find(str.data());
+        if(span == nullptr){
+            return false;
         }
+        auto node = parser_.parseSpan(*span);
+        ok = node != nullptr && add(std::move(node));
+        str.remove_prefix(span->close + 1 - span->open);
+        return true;
+    }
+
+private:
+    ParallelParser &parser_;
+};
+
+
+JsonNode::ptr ParallelParser::parse(std::string_view &rest){
+    rest = input_;
+    SpanBuilder builder(ctx_, *this);
+    if(SaxReader<SpanBuilder>(builder).parseValue(rest) != SaxResult::Ok){
+        return nullptr;
+    }
+    return builder.root();
+}
 
-        obj->add(std::static_pointer_cast<JsonString>(k), v);
 
-        str = util::skip_CtrlAndSpace(str);
+JsonNode::ptr ParallelParser::parseChunk(ParseContext &ctx, bool is_obj, size_t begin, size_t end, bool last){
+    JsonNode::ptr part;
+    if(is_obj){
+        part = ctx.make<JsonObject>(ctx.options().object_index);
+    }
+    else{
+        part = ctx.make<JsonArray>();
+    }
+    SpanBuilder builder(ctx, *this);
+    builder.into(part);
+    auto res = SaxReader<SpanBuilder>(builder).parseSequence(input_.substr(begin, end - begin), is_obj, last);
+    return res == SaxResult::Ok ? part : nullptr;
+}
 
-    }while(!str.empty() && check_func());
 
-    if(str[0] != '}'){
+JsonNode::ptr ParallelParser::parseSpan(const ContainerSpan &span){
+    bool is_obj = input_[span.open] == '{';
+    size_t n = span.cuts.size() + 1;
+    std::vector<JsonNode::ptr> parts(n);
+    std::atomic<bool> failed{false};
+    {
+        TaskGroup group(pool_);
+        for(size_t i = 0; i < n; ++i){
+            size_t begin = i == 0 ? span.open + 1 : span.cuts[i - 1] + 1;
+            size_t end = i + 1 == n ? span.close : span.cuts[i];
+            group.run([&, i, begin, end](unsigned){
+                if(failed.load(std::memory_order_relaxed)){
+                    return;
+                }
+                auto ctx = ctx_.fork();
+                parts[i] = parseChunk(ctx, is_obj, begin, end, i + 1 == n);
+                if(parts[i] == nullptr){
+                    failed = true;
+                }
+            });
+        }
+    }
+    if(failed){
         return nullptr;
     }
-    str.remove_prefix(1);
 
-    return std::static_pointer_cast<JsonNode>(obj);
+    // 只搬动指针，节点不拷贝
+    size_t total = 0;
+    for(auto &p : parts){
+        total += is_obj ? static_cast<JsonObject&>(*p).size() : static_cast<JsonArray&>(*p).size();
+    }
+    if(!is_obj){
+        auto arr = ctx_.make<JsonArray>();
+        auto &dst = arr->getValue();
+        dst.reserve(total);
+        for(auto &p : parts){
+            auto &src = static_cast<JsonArray&>(*p).getValue();
+            std::move(src.begin(), src.end(), std::back_inserter(dst));
+        }
+        return arr;
+    }
+    // 重复的键同逐个解析一样保留第一个
+    auto obj = ctx_.make<JsonObject>(ctx_.options().object_index);
+    auto &dst = obj->getValue();
+    dst.reserve(total);
+    for(auto &p : parts){
+        for(auto &kv : static_cast<JsonObject&>(*p).getValue()){
+            dst.emplace(std::move(kv.first), std::move(kv.second));
+        }
+    }
+    return obj;
 }
 
 
-JsonNode::ptr parse_value(std::string_view &str){
-    if(str.empty())return nullptr;
+/* 输入不够大、没有可切分的容器或预扫描失败时返回false，由调用者逐个解析；否则view留下根值之后的部分 */
+static bool parse_parallel(std::string_view &view, ParseContext &ctx, JsonNode::ptr &res){
+    const ParseOptions &opts = ctx.options();
+    if((opts.threads == 1 && opts.pool == nullptr) || ctx.arena() || view.size() < opts.parallel_min_bytes){
+        return false;
+    }
+    // 每段大约是最小并行大小的四分之一，一个大容器至少切成几段
+    size_t min_bytes = std::max<size_t>(opts.parallel_min_bytes, 4096);
+    std::vector<ContainerSpan> spans;
+    if(!scan_spans(view, min_bytes, min_bytes / 4, spans) || spans.empty()){
+        return false;
+    }
+    // 按cpu核数时用共用的线程池，在它的线程里等待时会帮着执行任务；指定了别的线程数才临时创建
+    std::unique_ptr<ThreadPool> own;
+    ThreadPool *pool = opts.pool;
+    if(pool == nullptr){
+        ThreadPool &shared = ThreadPool::shared();
+        if(opts.threads == 0 || opts.threads == shared.size()){
+            pool = &shared;
+        }
+        else{
+            own = std::make_unique<ThreadPool>(opts.threads);
+            pool = own.get();
+        }
+    }
+    res = ParallelParser(view, std::move(spans), ctx, *pool).parse(view);
+    return true;
+}
+
+
+/* ---------------------------------------------push--------------------------------------------- */
+
+static ParseOptions push_options(ParseOptions opts){
+    // 块随时会被调用者释放，节点不能引用它
+    opts.borrowed = false;
+    opts.lazy_numbers = false;
+    return opts;
+}
+
+struct PushParser::Impl{
+    explicit Impl(const ParseOptions &opts):ctx(push_options(opts)),builder(ctx),parser(builder){}
+
+    ParseContext ctx;
+    DomBuilder builder;
+    SaxPushParser<DomBuilder> parser;
+};
+
+
+PushParser::PushParser(const ParseOptions &opts):impl_(std::make_unique<Impl>(opts)){}
+
+
+PushParser::~PushParser(){}
+
 
-    if(str.size() && (str[0] == '{')){
-        return parse_object(str);
+bool PushParser::feed(const char *data, size_t len){
+    return impl_->parser.feed(data, len);
+}
+
+
+JsonNode::ptr PushParser::finish(){
+    if(impl_->parser.finish() != SaxResult::Ok){
+        return nullptr;
     }
-    if(str.size() && (str[0] == '[')){
-        return parse_array(str);
+    return impl_->builder.root();
+}
+
+
+/* 两阶段解析的第二阶段：沿结构索引构建树，不再逐字节判断 */
+class IndexedParser{
+public:
+    IndexedParser(std::string_view input, const StructuralIndex &index, ParseContext &ctx)
+        :input_(input),
+        index_(index),
+        ctx_(ctx)
+    {
     }
-    if(str.size() && (int)str[0] == '"'){
-        return parse_string(str);
+
+    JsonNode::ptr parse(){
+        if(index_.size() == 0)return nullptr;
+        return parse_value();
     }
-    if(str.size() && (str[0] == '-' || isdigit(str[0]))){
-        return parse_number(str);
+
+    /* 解析成功后根值之后的位置：还有没用到的索引时是它的位置 */
+    size_t end() const {
+        if(more()){
+            return pos(cur_);
+        }
+        // 根值是标量时已经检查过它一直到输入末尾都是空白
+        size_t last = pos(cur_ - 1);
+        char c = input_[last];
+        return c == '"' || c == ']' || c == '}' ? last + 1 : input_.size();
     }
-    if(str.size() >= 4 && str.compare(0, 4, "null") == 0){
-        str.remove_prefix(4);
-        return std::make_shared<JsonNull>();
+
+private:
+    size_t pos(size_t i) const { return index_[i] & StructuralIndex::pos_mask; }
+    bool more() const { return cur_ < index_.size(); }
+    char cur() const { return input_[pos(cur_)]; }
+
+    JsonNode::ptr parse_value(){
+        switch (cur())
+        {
+        case '{':
+            return parse_object();
+        case '[':
+            return parse_array();
+        case '"':
+            return parse_string();
+        case '}':
+        case ']':
+        case ':':
+        case ',':
+            return nullptr;
+        default:
+            return parse_scalar();
+        }
     }
-    if(str.size() >= 4 && str.compare(0, 4, "true") == 0){
-        str.remove_prefix(4);
-        return std::make_shared<JsonBoolean>(true);
+
+    JsonNode::ptr parse_string(){
+        // 开始引号后面一定紧跟着结束引号
+        if(cur_ + 1 >= index_.size())return nullptr;
+        size_t open = pos(cur_);
+        uint32_t close_entry = index_[cur_ + 1];
+        size_t close = close_entry & StructuralIndex::pos_mask;
+        if(input_[close] != '"')return nullptr;
+        cur_ += 2;
+
+        if(close_entry & StructuralIndex::escape_flag){
+            auto view = input_.substr(open);
+            return json::parse_string(view, ctx_);
+        }
+        auto raw = input_.substr(open + 1, close - open - 1);
+        return ctx_.intern(ctx_.makeString(raw));
     }
-    if(str.size() >= 5 && str.compare(0, 5, "false") == 0){
-        str.remove_prefix(5);
-        return std::make_shared<JsonBoolean>(false);
+
+    bool parse_key(ObjectKey &key){
+        if(cur_ + 1 >= index_.size())return false;
+        size_t open = pos(cur_);
+        uint32_t close_entry = index_[cur_ + 1];
+        size_t close = close_entry & StructuralIndex::pos_mask;
+        if(input_[close] != '"')return false;
+        cur_ += 2;
+
+        std::string_view raw = input_.substr(open + 1, close - open - 1);
+        if(close_entry & StructuralIndex::escape_flag){
+            auto view = input_.substr(open);
+            if(!json::parse_key(view, ctx_.scratch(), raw)){
+                return false;
+            }
+        }
+        key = ctx_.makeKey(raw);
+        return true;
     }
-    else{
+
+    /* 数字、true、false、null：一直延伸到下一个索引位置，其后只能是空白 */
+    JsonNode::ptr parse_scalar(){
+        size_t begin = pos(cur_);
+        ++cur_;
+        size_t end = more() ? pos(cur_) : input_.size();
+        auto view = input_.substr(begin, end - begin);
+        auto res = json::parse_value(view, ctx_);
+        if(res == nullptr || !util::skip_CtrlAndSpace(view).empty()){
+            return nullptr;
+        }
+        return res;
+    }
+
+    JsonNode::ptr parse_array(){
+        ++cur_;
+        JsonArray::ptr arr(ctx_.make<JsonArray>());
+        if(!more())return nullptr;
+        if(cur() == ']'){
+            ++cur_;
+            return ctx_.intern(std::move(arr));
+        }
+
+        while(true){
+            auto jv = parse_value();
+            if(jv == nullptr || !more()){
+                return nullptr;
+            }
+            arr->add(jv);
+            char c = cur();
+            ++cur_;
+            if(c == ']'){
+                break;
+            }
+            if(c != ',' || !more()){
+                return nullptr;
+            }
+            /* 支持最后一个加逗号 */
+            if(cur() == ']'){
+                ++cur_;
+                break;
+            }
+        }
+        return ctx_.intern(std::move(arr));
+    }
+
+    JsonNode::ptr parse_object(){
+        ++cur_;
+        JsonObject::ptr obj(ctx_.make<JsonObject>(ctx_.options().object_index));
+        if(!more())return nullptr;
+        if(cur() == '}'){
+            ++cur_;
+            return ctx_.intern(std::move(obj));
+        }
+
+        while(true){
+            // 解析键
+            if(cur() != '"')return nullptr;
+            ObjectKey k;
+            if(!parse_key(k) || !more() || cur() != ':'){
+                return nullptr;
+            }
+            ++cur_;
+
+            // 解析值
+            if(!more())return nullptr;
+            auto v = parse_value();
+            if(v == nullptr || !more()){
+                return nullptr;
+            }
+            obj->getValue().emplace(std::move(k), v);
+
+            char c = cur();
+            ++cur_;
+            if(c == '}'){
+                break;
+            }
+            if(c != ',' || !more()){
+                return nullptr;
+            }
+            /* 支持最后一个加逗号 */
+            if(cur() == '}'){
+                ++cur_;
+                break;
+            }
+        }
+        return ctx_.intern(std::move(obj));
+    }
+
+private:
+    std::string_view input_;
+    const StructuralIndex &index_;
+    ParseContext &ctx_;
+    size_t cur_ = 0;
+};
+
+
+static JsonNode::ptr parse(std::string_view str, ParseContext &ctx){
+    auto view = util::skip_CtrlAndSpace(util::skip_utf8_bom(str));
+    JsonNode::ptr res;
+    bool done = parse_parallel(view, ctx, res);
+    if(!done && ctx.options().structural_index){
+        StructuralIndex index;
+        if(index.build(view)){
+            IndexedParser parser(view, index, ctx);
+            res = parser.parse();
+            if(res != nullptr){
+                view.remove_prefix(parser.end());
+            }
+            done = true;
+        }
+        // 超出索引范围的输入退回逐字节解析
+        else if(view.size() <= StructuralIndex::max_input){
+            return nullptr;
+        }
+    }
+    if(!done){
+        res = parse_value(view, ctx);
+    }
+    // 不论哪种方式，根值之后都只能是空白
+    if(res != nullptr && !util::skip_CtrlAndSpace(view).empty()){
         return nullptr;
     }
+    return res;
+}
+
+JsonNode::ptr parse(std::string_view str, const ParseOptions &opts){
+    ParseContext ctx(opts);
+    return parse(str, ctx);
 }
 
 JsonNode::ptr parse(std::string_view str){
-    auto view = str;
-    view = util::skip_utf8_bom(view);
-    view = util::skip_CtrlAndSpace(view);
-    auto obj = parse_value(view);
-    return obj;
+    return parse(str, ParseOptions());
 }
 
 JsonNode::ptr parse(const char *str){
@@ -295,28 +983,91 @@ JsonNode::ptr fromString(const std::string &str){
 
 
 JsonNode::ptr fromFile(const char* filePath){
-    JsonBuffer buffer;
-    buffer.readFile(filePath);
-    return parse(buffer.to_stringview());
+    return fromFile(filePath, ParseOptions());
 }
 
 
 JsonNode::ptr fromFile(const std::string &filePath){
-    JsonBuffer buffer;
-    buffer.readFile(filePath.c_str());
-    return parse(buffer.to_stringview());
+    return fromFile(filePath.c_str(), ParseOptions());
+}
+
+
+JsonNode::ptr fromFile(const char* filePath, const ParseOptions &opts){
+    auto buffer = std::make_shared<JsonBuffer>();
+    if(!buffer->readFile(filePath)){
+        return nullptr;
+    }
+    ParseContext ctx(opts);
+    if(opts.borrowed || opts.lazy_numbers){
+        // 借用的字符串和延迟的数字持有缓冲区，缓冲区随最后一个持有者释放
+        ctx.setWritable(buffer->data(), buffer->data() + buffer->len(), buffer);
+    }
+    return parse(buffer->to_stringview(), ctx);
+}
+
+
+JsonNode::ptr fromFile(const std::string &filePath, const ParseOptions &opts){
+    return fromFile(filePath.c_str(), opts);
+}
+
+
+void Document::reset(){
+    // 旧树的节点在旧内存池里，必须先于内存池释放
+    root_ = nullptr;
+    buffer_ = nullptr;
+    arena_ = std::make_unique<JsonArena>();
+}
+
+
+bool Document::parse(std::string_view str, ParseOptions opts){
+    reset();
+    char *buf = static_cast<char*>(arena_->allocate(str.size(), 1));
+    memcpy(buf, str.data(), str.size());
+
+    // 输入和节点都由文档持有，借用的字符串和延迟的数字不必再持有owner
+    opts.borrowed = true;
+    ParseContext ctx(opts);
+    ctx.setWritable(buf, buf + str.size(), nullptr);
+    ctx.setArena(arena_.get());
+    root_ = json::parse(std::string_view(buf, str.size()), ctx);
+    return root_ != nullptr;
+}
+
+
+bool Document::parseFile(const char *filePath, ParseOptions opts){
+    reset();
+    buffer_ = std::make_shared<JsonBuffer>();
+    if(!buffer_->readFile(filePath)){
+        return false;
+    }
+
+    // 文件已经映射进内存，不再拷贝
+    opts.borrowed = true;
+    ParseContext ctx(opts);
+    ctx.setWritable(buffer_->data(), buffer_->data() + buffer_->len(), nullptr);
+    ctx.setArena(arena_.get());
+    root_ = json::parse(buffer_->to_stringview(), ctx);
+    return root_ != nullptr;
 }
 
 
 void toFile(JsonNode::ptr js, const char* filePath, const PrintFormatter &fmter){
-    JsonBuffer buffer(js->toString(fmter));
-    buffer.writeFile(filePath);
+    FILE *fp = fopen(filePath, "wb");
+    if(fp == nullptr){
+        return;
+    }
+    {
+        // 边序列化边写文件，不在内存里拼出整个字符串
+        FileSink sink(fp);
+        JsonWriter writer(sink, fmter);
+        writer.write(*js);
+    }
+    fclose(fp);
 }
 
 
 void toFile(JsonNode::ptr js, const std::string &filePath, const PrintFormatter &fmter){
-    JsonBuffer buffer(js->toString(fmter));
-    buffer.writeFile(filePath.c_str());
+    toFile(js, filePath.c_str(), fmter);
 }
 
 void toFile(JsonNode::ptr js, const char* filePath, 
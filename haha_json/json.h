@@ -5,6 +5,20 @@
 #include "jsonTypeCast.h"
 #include "jsonUtil.h"
 #include "jsonBuffer.h"
+#include "jsonIndex.h"
+#include "jsonWriter.h"
+#include "jsonArena.h"
+#include "jsonTape.h"
+#include "jsonLazy.h"
+#include "jsonProjection.h"
+#include "jsonPath.h"
+#include "jsonSnapshot.h"
+#include "jsonKeyPool.h"
+#include "jsonNodePool.h"
+#include "jsonSax.h"
+#include "jsonPush.h"
+#include "jsonThreadPool.h"
+#include "jsonLines.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -15,6 +29,158 @@ namespace haha
 namespace json
 {
 
+/* 解析选项：各个选项只影响速度和内存，不影响接受哪些输入
+   不论用哪种方式解析，根值之后都只能是空白(含控制字符)，否则解析失败 */
+struct ParseOptions{
+    /* 借用模式：无转义的字符串直接引用输入缓冲区而不拷贝，含转义的字符串反转义到解析器持有的缓冲区
+       parse时调用者需保证输入比解析结果活得久；fromFile的缓冲区由解析结果自己持有 */
+    bool borrowed = false;
+    /* 两阶段解析：先用simd找出所有结构字符建立索引，再沿索引构建树，适合大输入 */
+    bool structural_index = false;
+    /* 延迟数字：只记下数字的原文，首次getValue时才转换，未修改的数字toString时原样输出
+       对输入生命周期的要求同借用模式 */
+    bool lazy_numbers = false;
+    /* 解析出的对象的成员查找方式 */
+    ObjectIndexPolicy object_index = ObjectIndexPolicy::Auto;
+    /* 对象的键从这个池里取，多次解析、多个线程可以共用一个池；池要比解析结果活得久 */
+    KeyPool *key_pool = nullptr;
+    /* 解析时把每个建好的节点交给这个池，相同的字符串和标量只留一份(池设置了share_containers时还有相同的子树)
+       池持有节点，池里的节点是只读的，统计见NodePool::stats；解析要慢不少(默认约1.6倍，共享子树时2倍以上)，只在内存比解析速度要紧时打开
+       Document和按行解析的arena模式下节点在内存池里，不去重 */
+    NodePool *node_pool = nullptr;
+    /* 并行解析：大于1时先扫描出大的数组和对象，把它们的元素切成几段由多个线程解析，再按原顺序拼接
+       0表示按cpu核数，这时用ThreadPool::shared()，其他值每次调用临时创建线程池；设置了pool时用它的线程。输入小于parallel_min_bytes时仍单线程解析
+       与structural_index同时设置时并行优先；Document的节点在内存池里，不并行 */
+    unsigned threads = 1;
+    ThreadPool *pool = nullptr;
+    size_t parallel_min_bytes = 8 << 20;
+};
+
+/* 单次解析的上下文 */
+class ParseContext{
+public:
+    explicit ParseContext(const ParseOptions &opts = ParseOptions()):opts_(opts){}
+
+    const ParseOptions& options() const { return opts_; }
+
+    /* 输入位于[begin, end)这段可写且由owner持有的内存中，反转义可以原地进行 */
+    void setWritable(char *begin, char *end, std::shared_ptr<const void> owner){
+        wbegin_ = begin;
+        wend_ = end;
+        owner_ = std::move(owner);
+    }
+
+    /* 给另一个线程用的上下文：选项、可写的输入和持有者相同，临时空间、字符串池各自独立，不用arena */
+    ParseContext fork() const {
+        ParseContext ctx(opts_);
+        ctx.setWritable(wbegin_, wend_, owner_);
+        return ctx;
+    }
+
+    /* 让输入内存活着的对象，借用的字符串和延迟的数字持有它 */
+    const std::shared_ptr<const void>& owner() const { return owner_; }
+
+    /* 节点改从arena分配，反转义后的字符串也存进arena，arena要比解析结果活得久 */
+    void setArena(JsonArena *arena){ arena_ = arena; }
+    JsonArena* arena() const { return arena_; }
+
+    /* 创建节点：设置了arena时从arena分配，否则同std::make_shared */
+    template<typename T, typename... Args>
+    std::shared_ptr<T> make(Args&&... args){
+        if(arena_){
+            return std::allocate_shared<T>(ArenaAllocator<T>(arena_), std::forward<Args>(args)...);
+        }
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+
+    /* 对象的键：设置了key_pool时取池里的那一份，否则拷贝 */
+    ObjectKey makeKey(std::string_view key){
+        if(opts_.key_pool){
+            return ObjectKey(opts_.key_pool->intern(key));
+        }
+        return ObjectKey(key);
+    }
+
+    /* 设置了node_pool时换成池里相同的那一份，子节点要已经交给过池 */
+    JsonNode::ptr intern(JsonNode::ptr node){
+        if(opts_.node_pool && arena_ == nullptr){
+            return opts_.node_pool->intern(std::move(node));
+        }
+        return node;
+    }
+
+    /* 反转义用的临时空间，跨字符串复用 */
+    std::string& scratch() { return scratch_; }
+
+    /* raw是输入中不含转义的字符串内容，hint为其是否需要转义 */
+    JsonString::ptr makeString(std::string_view raw, EscapeHint hint = EscapeHint::Unknown);
+    /* raw_begin是含转义字符串在输入中的起始位置，unescaped为反转义后的内容 */
+    JsonString::ptr makeEscapedString(const char *raw_begin, std::string_view unescaped);
+
+private:
+    ParseOptions opts_;
+    char *wbegin_ = nullptr;
+    char *wend_ = nullptr;
+    std::shared_ptr<const void> owner_;
+    std::shared_ptr<JsonStringPool> pool_;
+    JsonArena *arena_ = nullptr;
+    std::string scratch_;
+};
+
+
+/* 文档：解析出的节点、借用的字符串以及输入本身都放在文档的内存池里，节点不再逐个向系统申请内存
+   数组的成员表、对象的成员表和超出内联长度的键仍用普通的分配器，释放时照样逐个归还，析构也仍要遍历整棵树
+   节点只在文档存活期间有效，不要让取出的节点比文档活得久 */
+class Document{
+public:
+    Document() {}
+    Document(Document &&) = default;
+    Document &operator=(Document &&other){
+        // 先释放旧树再换内存池
+        root_ = std::move(other.root_);
+        buffer_ = std::move(other.buffer_);
+        arena_ = std::move(other.arena_);
+        return *this;
+    }
+
+    /* 输入先拷贝进内存池，总是以借用模式解析，失败时返回false */
+    bool parse(std::string_view str, ParseOptions opts = ParseOptions());
+    bool parseFile(const char *filePath, ParseOptions opts = ParseOptions());
+
+    const JsonNode::ptr& root() const { return root_; }
+    /* 内存池已分配的字节数 */
+    size_t arenaBytes() const { return arena_ ? arena_->used() : 0; }
+
+private:
+    void reset();
+
+private:
+    // 析构时逆序进行：先释放树，再释放输入和内存池
+    std::unique_ptr<JsonArena> arena_;
+    std::shared_ptr<JsonBuffer> buffer_;
+    JsonNode::ptr root_;
+};
+
+/* 分块输入的建树解析：feed的块用完即可释放，节点里的字符串和数字都是拷贝
+   因此借用模式和延迟数字不起作用，其余选项同parse */
+class PushParser{
+public:
+    explicit PushParser(const ParseOptions &opts = ParseOptions());
+    ~PushParser();
+    PushParser(const PushParser &) = delete;
+    PushParser &operator=(const PushParser &) = delete;
+
+    /* 出错后返回false */
+    bool feed(const char *data, size_t len);
+    bool feed(std::string_view chunk){ return feed(chunk.data(), chunk.size()); }
+    /* 输入结束，返回解析出的树，出错或不完整时返回nullptr */
+    JsonNode::ptr finish();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
 JsonNode::ptr parse(const char *str);
 JsonNode::ptr parse(const std::string &str);
 
@@ -25,12 +191,25 @@ JsonNode::ptr parse_number(std::string_view &str);
 JsonNode::ptr parse_array(std::string_view &str);
 JsonNode::ptr parse_object(std::string_view &str);
 
+JsonNode::ptr parse(std::string_view str, const ParseOptions &opts);
+/* 只构建投影选中的部分：选中的值整个保留，通往它们的对象和数组只含选中的成员，什么都没选中的丢掉
+   其余的值只做引号和括号的快速扫描，不构建也不检查语法；根值是标量且没被选中时返回nullptr */
+JsonNode::ptr parse(std::string_view str, const Projection &projection, const ParseOptions &opts = ParseOptions());
+JsonNode::ptr parse_value(std::string_view &str, ParseContext &ctx);
+JsonNode::ptr parse_string(std::string_view &str, ParseContext &ctx);
+JsonNode::ptr parse_number(std::string_view &str, ParseContext &ctx);
+JsonNode::ptr parse_array(std::string_view &str, ParseContext &ctx);
+JsonNode::ptr parse_object(std::string_view &str, ParseContext &ctx);
+
 JsonNode::ptr fromString(const char* str);
 JsonNode::ptr fromString(const std::string &str);
 
 JsonNode::ptr fromFile(const char* filePath);
 JsonNode::ptr fromFile(const std::string &filePath);
 
+JsonNode::ptr fromFile(const char* filePath, const ParseOptions &opts);
+JsonNode::ptr fromFile(const std::string &filePath, const ParseOptions &opts);
+
 void toFile(JsonNode::ptr, const char* filePath, 
             const PrintFormatter &fmter = {});
 void toFile(JsonNode::ptr, const std::string &filePath, 
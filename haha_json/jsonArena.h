@@ -0,0 +1,75 @@
+#ifndef __HAHA_JSON_JSONARENA_H__
+#define __HAHA_JSON_JSONARENA_H__
+
+#include <memory>
+#include <memory_resource>
+#include <stddef.h>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 文档级内存池：只分配不释放，析构时整块归还
+   Document里只有节点、字符串和输入从这里分配，容器的成员表不在其中，照样逐个释放 */
+class JsonArena {
+public:
+    static constexpr size_t initial_size = 64 * 1024;
+
+    explicit JsonArena(size_t initial = initial_size):res_(initial){}
+    JsonArena(const JsonArena &) = delete;
+    JsonArena &operator=(const JsonArena &) = delete;
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)){
+        used_ += bytes;
+        return res_.allocate(bytes, align);
+    }
+
+    /* 归还所有内存重新使用，之前分配出去的都失效 */
+    void reset(){
+        res_.release();
+        used_ = 0;
+    }
+
+    /* 已经分配出去的字节数 */
+    size_t used() const { return used_; }
+
+private:
+    std::pmr::monotonic_buffer_resource res_;
+    size_t used_ = 0;
+};
+
+
+/* 从JsonArena分配的分配器，供allocate_shared使用
+   只存裸指针，不增加引用计数，由使用者保证内存池比节点活得久 */
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(JsonArena *arena):arena_(arena){}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other):arena_(other.arena()){}
+
+    T* allocate(size_t n){
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *, size_t) {}
+
+    JsonArena* arena() const { return arena_; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &rhs) const { return arena_ == rhs.arena(); }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &rhs) const { return arena_ != rhs.arena(); }
+
+private:
+    JsonArena *arena_;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
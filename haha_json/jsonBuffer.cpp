@@ -0,0 +1,117 @@
+#include "jsonBuffer.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace haha
+{
+
+namespace json
+{
+
+bool JsonBuffer::readFile(const char *filePath){
+    int fd = ::open(filePath, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return false;
+    }
+    release();
+
+    struct stat st;
+    bool ok;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+        // 映射失败(比如某些特殊文件系统)时退回read
+        ok = mapFile(fd, (size_t)st.st_size) || readAll(fd);
+    }
+    else{
+        // 管道、字符设备、/proc下大小为0的文件等
+        ok = readAll(fd);
+    }
+    ::close(fd);
+    __ptr = npos;
+    return ok;
+}
+
+
+bool JsonBuffer::mapFile(int fd, size_t size){
+    // 私有可写映射：不会改动文件，借用模式可以在缓冲区上原地反转义
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED){
+        return false;
+    }
+    // 都是顺序扫描，让内核多预读；能用大页就用，不支持时忽略错误
+    madvise(p, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+    sbuffer_ = static_cast<char*>(p);
+    __len = size;
+    map_len_ = size;
+    anonymous_ = false;
+    return true;
+}
+
+
+bool JsonBuffer::readAll(int fd){
+    // 匿名映射按块增长，mremap扩容时不用拷贝
+    size_t cap = read_block_size * 4;
+    void *p = mmap(nullptr, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED){
+        return false;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(p, cap, MADV_HUGEPAGE);
+#endif
+    char *buf = static_cast<char*>(p);
+    size_t len = 0;
+    while(true){
+        if(cap - len < read_block_size){
+            void *q = mremap(buf, cap, cap * 2, MREMAP_MAYMOVE);
+            if(q == MAP_FAILED){
+                munmap(buf, cap);
+                return false;
+            }
+            buf = static_cast<char*>(q);
+            cap *= 2;
+        }
+        ssize_t n = ::read(fd, buf + len, cap - len);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            munmap(buf, cap);
+            return false;
+        }
+        if(n == 0){
+            break;
+        }
+        len += n;
+    }
+    sbuffer_ = buf;
+    __len = len;
+    map_len_ = cap;
+    anonymous_ = true;
+    return true;
+}
+
+
+void JsonBuffer::release(){
+    if(sbuffer_){
+        if(map_len_){
+            munmap(sbuffer_, map_len_);
+        }
+        else{
+            delete[] sbuffer_;
+        }
+    }
+    sbuffer_ = nullptr;
+    __len = 0;
+    __ptr = npos;
+    map_len_ = 0;
+    anonymous_ = false;
+}
+
+} // namespace json
+
+} // namespace haha
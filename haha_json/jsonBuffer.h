@@ -3,8 +3,10 @@
 
 #include <string>
 #include <cstring>
+#include <memory>
+#include <vector>
+#include <algorithm>
 #include <fstream>
-#include <filesystem>
 #include "jsonError.h"
 
 namespace haha
@@ -13,9 +15,11 @@ namespace haha
 namespace json
 {
 
+/* 输入缓冲区：普通文件只读映射进内存，管道等不能映射的输入分块read进来 */
 class JsonBuffer {
 public:
-    static const int max_size = 4 * 1000 * 1000;
+    /* read()每次读的块大小 */
+    static constexpr size_t read_block_size = 1 << 20;
 
     JsonBuffer(const JsonBuffer &) = delete;
     JsonBuffer(JsonBuffer &&) = delete;
@@ -25,42 +29,16 @@ public:
     JsonBuffer() {}
     JsonBuffer(const std::string str) { readString(str); }
 
-    ~JsonBuffer() {
-        if (sbuffer_){
-            delete[] sbuffer_;
-        }
-    }
-
-    bool readFile(const char *filePath){
-        bool exists = std::filesystem::exists(filePath);
-        if(!exists){
-            return false;
-        }
-        int fsz = std::filesystem::file_size(filePath);
-        if(fsz > max_size){
-            throw HAHA_JSON_ERROR("unsupport file size bigger than 4M !!!");
-        }
+    ~JsonBuffer() { release(); }
 
-        if (sbuffer_) {
-            delete[] sbuffer_;
-            sbuffer_ = nullptr;
-        }
-
-        std::ifstream ifs(filePath);
-        __len = fsz;
-        __ptr = -1;
-        sbuffer_ = new char[fsz+1]{0};
-        ifs.read(sbuffer_, fsz);
-        return true;
-    }
+    /* 文件打不开或读取出错时返回false
+       映射是私有的，原地修改缓冲区(借用模式下的反转义)不会写回文件 */
+    bool readFile(const char *filePath);
 
     void readString(const std::string &s) {
-        if (sbuffer_) {
-            delete[] sbuffer_;
-            sbuffer_ = nullptr;
-        }
+        release();
         __len = s.length();
-        __ptr = -1;
+        __ptr = npos;
         sbuffer_ = new char[__len]{0};
         memcpy(sbuffer_, s.data(), __len * sizeof(char));
     }
@@ -69,17 +47,17 @@ public:
         if(sbuffer_ == nullptr){
             return false;
         }
-        std::ofstream ofs(filePath);
-        ofs << sbuffer_;
+        std::ofstream ofs(filePath, std::ios::binary);
+        ofs.write(sbuffer_, __len);
         return true;
     }
 
     void writeString(std::string &s){
-        s = sbuffer_;
+        s.assign(sbuffer_, __len);
     }
 
     char cur() {
-        if (__ptr <= -1 || __ptr >= __len){
+        if (__ptr >= __len){
             return EOF;
         }
         return sbuffer_[__ptr];
@@ -91,7 +69,7 @@ public:
         return sbuffer_[__ptr];
     }
     char backc() {
-        if (__ptr - 1 < 0){
+        if (__ptr == 0 || __ptr - 1 >= __len){
             return EOF;
         }
         return sbuffer_[__ptr - 1];
@@ -115,19 +93,19 @@ public:
         return std::make_pair(false, c);
     }
 
-    std::string gets(int count) {
+    std::string gets(size_t count) {
         std::string s;
-        for (int i = 0; i < count; i++){
+        for (size_t i = 0; i < count; i++){
             s.append(1, get());
         }
         return s;
     }
 
-    int len() { return __len; }
-    int pos() { return __ptr; }
-    bool eof() { return __ptr > __len - 1; }
+    size_t len() { return __len; }
+    size_t pos() { return __ptr; }
+    bool eof() { return __ptr + 1 > __len; }
 
-    void reset() { __ptr = -1; }
+    void reset() { __ptr = npos; }
 
     void clear() {
         reset();
@@ -138,10 +116,55 @@ public:
         return std::string_view(sbuffer_, __len);
     }
 
+    char* data() { return sbuffer_; }
+
+    /* 内容是否直接映射自文件 */
+    bool isMapped() const { return map_len_ != 0 && !anonymous_; }
+
+private:
+    /* 读取位置的初值，第一次get()后变为0 */
+    static constexpr size_t npos = (size_t)-1;
+
+    bool mapFile(int fd, size_t size);
+    bool readAll(int fd);
+    void release();
+
 private:
     char* sbuffer_ = nullptr;
-    int __ptr = -1;
-    int __len = 0;
+    size_t __ptr = npos;
+    size_t __len = 0;
+    size_t map_len_ = 0;        // 不为0时sbuffer_来自mmap，需要munmap
+    bool anonymous_ = false;    // 匿名映射(read的结果)还是文件映射
+};
+
+
+/* 字符串池：按块分配且地址稳定，借用模式下存放反转义后的字符串 */
+class JsonStringPool {
+public:
+    static constexpr size_t block_size = 64 * 1024;
+
+    JsonStringPool() {}
+    JsonStringPool(const JsonStringPool &) = delete;
+    JsonStringPool &operator=(const JsonStringPool &) = delete;
+
+    std::string_view store(std::string_view s){
+        if(s.size() > left_){
+            size_t sz = std::max(block_size, s.size());
+            blocks_.emplace_back(new char[sz]);
+            cur_ = blocks_.back().get();
+            left_ = sz;
+        }
+        memcpy(cur_, s.data(), s.size());
+        std::string_view res(cur_, s.size());
+        cur_ += s.size();
+        left_ -= s.size();
+        return res;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* cur_ = nullptr;
+    size_t left_ = 0;
 };
 
 } // namespace json
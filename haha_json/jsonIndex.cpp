@@ -0,0 +1,424 @@
+#include "jsonIndex.h"
+#include "jsonUtil.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAHA_JSON_X86 1
+#endif
+
+namespace haha
+{
+
+namespace json
+{
+
+namespace
+{
+
+/* 一个64字节块里各类字符的位图，第i位对应块内第i个字节 */
+struct BlockMasks{
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t structural = 0;
+    uint64_t space = 0;
+};
+
+typedef void (*MaskKernel)(const char *block, BlockMasks &m);
+
+inline bool isStructural(char c){
+    return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+}
+
+void masks_scalar(const char *block, BlockMasks &m){
+    m = BlockMasks();
+    for(int i = 0; i < 64; ++i){
+        char c = block[i];
+        uint64_t bit = 1ull << i;
+        if(c == '"'){
+            m.quote |= bit;
+        }
+        else if(c == '\\'){
+            m.backslash |= bit;
+        }
+        else if(isStructural(c)){
+            m.structural |= bit;
+        }
+        else if(util::isCtrlAndSpace(c)){
+            m.space |= bit;
+        }
+    }
+}
+
+#ifdef HAHA_JSON_X86
+
+/* '{'和'['、'}'和']'只差0x20这一位，或上0x20后两次比较即可找出四种括号 */
+__attribute__((target("sse2")))
+uint32_t structural16(__m128i v){
+    __m128i low = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i r = _mm_or_si128(_mm_cmpeq_epi8(low, _mm_set1_epi8('{')),
+                             _mm_cmpeq_epi8(low, _mm_set1_epi8('}')));
+    r = _mm_or_si128(r, _mm_cmpeq_epi8(v, _mm_set1_epi8(':')));
+    r = _mm_or_si128(r, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+    return (uint32_t)_mm_movemask_epi8(r);
+}
+
+__attribute__((target("sse2")))
+void masks_sse2(const char *block, BlockMasks &m){
+    m = BlockMasks();
+    for(int i = 0; i < 4; ++i){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+        int shift = i * 16;
+        m.quote |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << shift;
+        m.backslash |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << shift;
+        m.structural |= (uint64_t)structural16(v) << shift;
+        // 有符号比较，与isCtrlAndSpace(c <= 32)一致
+        uint32_t not_space = (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(v, _mm_set1_epi8(32)));
+        m.space |= (uint64_t)(~not_space & 0xFFFFu) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+uint64_t structural32(__m256i v){
+    __m256i low = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i r = _mm256_or_si256(_mm256_cmpeq_epi8(low, _mm256_set1_epi8('{')),
+                                _mm256_cmpeq_epi8(low, _mm256_set1_epi8('}')));
+    r = _mm256_or_si256(r, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')));
+    r = _mm256_or_si256(r, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+    return (uint32_t)_mm256_movemask_epi8(r);
+}
+
+__attribute__((target("avx2")))
+void masks_avx2(const char *block, BlockMasks &m){
+    m = BlockMasks();
+    for(int i = 0; i < 2; ++i){
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32));
+        int shift = i * 32;
+        m.quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << shift;
+        m.backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << shift;
+        m.structural |= structural32(v) << shift;
+        uint32_t not_space = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(32)));
+        m.space |= (uint64_t)(uint32_t)~not_space << shift;
+    }
+}
+
+#endif
+
+struct Kernel{
+    MaskKernel fn;
+    const char *name;
+};
+
+Kernel pickKernel(){
+#ifdef HAHA_JSON_X86
+    if(util::cpuHasAvx2()){
+        return {masks_avx2, "avx2"};
+    }
+    if(__builtin_cpu_supports("sse2")){
+        return {masks_sse2, "sse2"};
+    }
+#endif
+    return {masks_scalar, "scalar"};
+}
+
+const Kernel& kernel(){
+    static const Kernel k = pickKernel();
+    return k;
+}
+
+/* 第i位变成第0到第i位的异或，用于由引号位图得到字符串内部的位图 */
+inline uint64_t prefix_xor(uint64_t x){
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/* 跨块跟踪字符串：每块给出未被转义的引号，以及字符串内部的位图 */
+struct QuoteTracker{
+    uint64_t prev_in_string = 0;    // 上一块结束时是否在字符串内，全1或全0
+    bool prev_escaped = false;      // 本块第一个字节是否被上一块末尾的转义符转义
+
+    /* in_string包含开始引号，不包含结束引号 */
+    void next(const BlockMasks &m, uint64_t &quote, uint64_t &in_string){
+        // 找出被转义的字符，转义符很少见，逐个处理
+        uint64_t escaped = 0;
+        uint64_t bs = m.backslash;
+        if(prev_escaped){
+            escaped |= 1;
+            bs &= ~1ull;
+        }
+        prev_escaped = false;
+        while(bs){
+            int i = __builtin_ctzll(bs);
+            bs &= bs - 1;
+            if(i == 63){
+                prev_escaped = true;
+            }
+            else{
+                escaped |= 1ull << (i + 1);
+                bs &= ~(1ull << (i + 1));
+            }
+        }
+
+        quote = m.quote & ~escaped;
+        in_string = prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+    }
+
+    bool inString() const { return prev_in_string != 0; }
+};
+
+/* 按64字节一块遍历输入，最后不足64字节的部分用空格补齐 */
+template<typename Fn>
+void for_each_block(std::string_view input, Fn &&fn){
+    const char *data = input.data();
+    size_t n = input.size();
+    char tail[64];
+    for(size_t off = 0; off < n; off += 64){
+        const char *block = data + off;
+        if(n - off < 64){
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, n - off);
+            block = tail;
+        }
+        fn(off, block);
+    }
+}
+
+
+/* 从i开始找第一个引号或转义符，找不到返回n */
+size_t find_quote(const char *p, size_t i, size_t n){
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for(; i + 16 <= n; i += 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                                 _mm_cmpeq_epi8(v, backslash)));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    while(i < n && p[i] != '"' && p[i] != '\\'){
+        ++i;
+    }
+    return i;
+}
+
+/* 从i开始找第一个引号或括号，找不到返回n */
+size_t find_bracket(const char *p, size_t i, size_t n){
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    for(; i + 16 <= n; i += 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        // 同structural16，或上0x20后'['变'{'、']'变'}'
+        __m128i low = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i r = _mm_or_si128(_mm_cmpeq_epi8(low, _mm_set1_epi8('{')),
+                                 _mm_cmpeq_epi8(low, _mm_set1_epi8('}')));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(r, _mm_cmpeq_epi8(v, quote)));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    while(i < n && p[i] != '"' && (p[i] | 0x20) != '{' && (p[i] | 0x20) != '}'){
+        ++i;
+    }
+    return i;
+}
+
+} // namespace
+
+
+const char* StructuralIndex::kernelName(){
+    return kernel().name;
+}
+
+
+bool StructuralIndex::build(std::string_view input){
+    positions_.clear();
+    if(input.size() > max_input){
+        return false;
+    }
+    positions_.reserve(input.size() / 8 + 16);
+
+    MaskKernel masks = kernel().fn;
+    QuoteTracker quotes;
+    uint64_t prev_other = 0;        // 上一块最后一个字节是否属于标量
+    bool pending_backslash = false; // 当前未闭合的字符串里是否出现过转义符
+
+    for_each_block(input, [&](size_t off, const char *block){
+        BlockMasks m;
+        masks(block, m);
+        uint64_t quote, in_string;
+        quotes.next(m, quote, in_string);
+
+        uint64_t structural = m.structural & ~in_string;
+        uint64_t other = ~(m.space | m.structural | m.quote) & ~in_string;
+        uint64_t scalar_start = other & ~((other << 1) | prev_other);
+        prev_other = other >> 63;
+
+        uint64_t backslash_in_string = m.backslash & in_string;
+        uint64_t consumed = 0;
+        uint64_t bits = structural | quote | scalar_start;
+        while(bits){
+            int i = __builtin_ctzll(bits);
+            bits &= bits - 1;
+            uint64_t bit = 1ull << i;
+            uint32_t pos = (uint32_t)(off + i);
+            if((quote & bit) && !(in_string & bit)){
+                // 结束引号：标记这个字符串里有没有转义符
+                uint64_t below = bit - 1;
+                if(pending_backslash || (backslash_in_string & below & ~consumed)){
+                    pos |= escape_flag;
+                }
+                pending_backslash = false;
+                consumed = below | bit;
+            }
+            positions_.push_back(pos);
+        }
+        if(backslash_in_string & ~consumed){
+            pending_backslash = true;
+        }
+    });
+
+    // 字符串没有闭合
+    return !quotes.inString();
+}
+
+
+bool scan_spans(std::string_view input, size_t min_bytes, size_t chunk_bytes, std::vector<ContainerSpan> &spans){
+    spans.clear();
+    MaskKernel masks = kernel().fn;
+    QuoteTracker quotes;
+
+    struct Open{
+        size_t pos;
+        size_t last;        // 上一个切分处，开始时为括号的位置
+        size_t cuts;        // 这一层的切分处在pending中的起始下标
+    };
+    std::vector<Open> stack;
+    std::vector<size_t> pending;    // 还没闭合的各层的切分处，内层的在后
+    bool ok = true;
+
+    for_each_block(input, [&](size_t off, const char *block){
+        if(!ok){
+            return;
+        }
+        BlockMasks m;
+        masks(block, m);
+        uint64_t quote, in_string;
+        quotes.next(m, quote, in_string);
+
+        uint64_t bits = m.structural & ~in_string;
+        while(bits){
+            int i = __builtin_ctzll(bits);
+            bits &= bits - 1;
+            size_t pos = off + i;
+            switch (block[i])
+            {
+            case '{':
+            case '[':
+                stack.push_back({pos, pos, pending.size()});
+                break;
+            case ',':
+                if(!stack.empty() && pos - stack.back().last >= chunk_bytes){
+                    pending.push_back(pos);
+                    stack.back().last = pos;
+                }
+                break;
+            case '}':
+            case ']':
+            {
+                if(stack.empty()){
+                    ok = false;
+                    return;
+                }
+                Open top = stack.back();
+                stack.pop_back();
+                if(pos - top.pos >= min_bytes && pending.size() > top.cuts){
+                    spans.push_back({top.pos, pos, std::vector<size_t>(pending.begin() + top.cuts, pending.end())});
+                }
+                pending.resize(top.cuts);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    });
+
+    // 外层的容器后闭合，按开始位置重新排序
+    std::sort(spans.begin(), spans.end(), [](const ContainerSpan &a, const ContainerSpan &b){
+        return a.open < b.open;
+    });
+    return ok && stack.empty() && !quotes.inString();
+}
+
+
+size_t skip_string(std::string_view input, size_t pos){
+    const char *p = input.data();
+    size_t n = input.size();
+    size_t i = pos + 1;
+    while(true){
+        i = find_quote(p, i, n);
+        if(i >= n){
+            return skip_npos;
+        }
+        if(p[i] == '"'){
+            return i + 1;
+        }
+        i += 2;
+    }
+}
+
+
+size_t skip_value(std::string_view input, size_t pos){
+    const char *p = input.data();
+    size_t n = input.size();
+    if(pos >= n){
+        return skip_npos;
+    }
+    char c = p[pos];
+    if(c == '"'){
+        return skip_string(input, pos);
+    }
+    if(c == '{' || c == '['){
+        size_t depth = 1;
+        size_t i = pos + 1;
+        while(true){
+            i = find_bracket(p, i, n);
+            if(i >= n){
+                return skip_npos;
+            }
+            if(p[i] == '"'){
+                i = skip_string(input, i);
+                if(i == skip_npos){
+                    return skip_npos;
+                }
+                continue;
+            }
+            depth = (p[i] | 0x20) == '{' ? depth + 1 : depth - 1;
+            ++i;
+            if(depth == 0){
+                return i;
+            }
+        }
+    }
+    // 标量到分隔符为止
+    size_t i = pos;
+    while(i < n && !util::isCtrlAndSpace(p[i]) && p[i] != ',' && p[i] != '}' && p[i] != ']' && p[i] != ':'){
+        ++i;
+    }
+    return i;
+}
+
+} // namespace json
+
+} // namespace haha
@@ -0,0 +1,61 @@
+#ifndef __HAHA_JSON_JSONINDEX_H__
+#define __HAHA_JSON_JSONINDEX_H__
+
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 结构索引：两阶段解析的第一阶段
+   记录字符串外的结构字符{}[]:,、每个字符串的开始和结束引号、以及每个标量(数字/true/false/null)的起始位置 */
+class StructuralIndex{
+public:
+    /* 结束引号的位置带上这一位，表示该字符串含有转义符 */
+    static constexpr uint32_t escape_flag = 0x80000000u;
+    static constexpr uint32_t pos_mask = ~escape_flag;
+    /* 位置用31位存，更大的输入不走索引 */
+    static constexpr size_t max_input = pos_mask;
+
+    /* 构建索引，输入过大或字符串没有闭合时返回false */
+    bool build(std::string_view input);
+
+    const std::vector<uint32_t>& positions() const { return positions_; }
+    size_t size() const { return positions_.size(); }
+    uint32_t operator[](size_t i) const { return positions_[i]; }
+
+    /* 当前cpu上实际使用的实现：avx2、sse2或scalar */
+    static const char* kernelName();
+
+private:
+    std::vector<uint32_t> positions_;
+};
+
+
+/* 容器及其切分处：把容器的元素按大约chunk_bytes字节切成几段，切分处是这一层的逗号 */
+struct ContainerSpan{
+    size_t open;                // '['或'{'的位置
+    size_t close;               // 对应的']'或'}'的位置
+    std::vector<size_t> cuts;   // 切分处的逗号，递增
+};
+
+/* 并行解析的预扫描：找出不小于min_bytes且能切成多段的数组和对象，按开始位置排序
+   只看字符串外的括号和逗号，不检查其他语法；括号不配对或字符串没有闭合时返回false */
+bool scan_spans(std::string_view input, size_t min_bytes, size_t chunk_bytes, std::vector<ContainerSpan> &spans);
+
+/* 跳过从pos开始的一个值，返回值之后的位置，输入不完整时返回npos
+   只认引号、转义符和括号，不检查其余语法，也不区分括号的种类，用于不需要构建的子树 */
+constexpr size_t skip_npos = (size_t)-1;
+size_t skip_value(std::string_view input, size_t pos);
+/* pos处是开始引号，返回结束引号之后的位置 */
+size_t skip_string(std::string_view input, size_t pos);
+
+} // namespace json
+
+} // namespace haha
+
+#endif
@@ -0,0 +1,158 @@
+#include "jsonKeyPool.h"
+#include <string.h>
+#include <mutex>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 每个分片一张开放寻址表，键的内容放在分片自己的内存池里
+   计数器也按分片放，避免多个线程抢同一个缓存行 */
+struct alignas(64) KeyPool::Shard{
+    mutable std::shared_mutex mtx;
+    std::vector<const InternedKey*> slots;
+    size_t count = 0;
+    JsonArena arena{4096};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+};
+
+
+KeyPool::KeyPool():shards_(new Shard[shard_count]){}
+
+
+KeyPool::~KeyPool(){
+    delete[] shards_;
+}
+
+
+KeyPool::Shard& KeyPool::shardOf(size_t h) const{
+    // 表内用低位定位，分片用高位
+    return shards_[(h >> 56) % shard_count];
+}
+
+
+const InternedKey* KeyPool::lookup(const Shard &shard, std::string_view key, size_t h){
+    if(shard.slots.empty()){
+        return nullptr;
+    }
+    size_t mask = shard.slots.size() - 1;
+    for(size_t s = h & mask; ; s = (s + 1) & mask){
+        const InternedKey *k = shard.slots[s];
+        if(k == nullptr){
+            return nullptr;
+        }
+        if(k->hash == h && k->view() == key){
+            return k;
+        }
+    }
+}
+
+
+void KeyPool::place(Shard &shard, const InternedKey *key){
+    size_t mask = shard.slots.size() - 1;
+    size_t s = key->hash & mask;
+    while(shard.slots[s] != nullptr){
+        s = (s + 1) & mask;
+    }
+    shard.slots[s] = key;
+}
+
+
+const InternedKey* KeyPool::find(std::string_view key) const{
+    size_t h = hashKey(key);
+    Shard &shard = shardOf(h);
+    std::shared_lock<std::shared_mutex> lock(shard.mtx);
+    return lookup(shard, key, h);
+}
+
+
+const InternedKey* KeyPool::intern(std::string_view key){
+    size_t h = hashKey(key);
+    Shard &shard = shardOf(h);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        if(auto res = lookup(shard, key, h)){
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return res;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(shard.mtx);
+    // 释放读锁期间可能已经被别的线程加进来了
+    if(auto res = lookup(shard, key, h)){
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        return res;
+    }
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+
+    void *mem = shard.arena.allocate(sizeof(InternedKey) + key.size(), alignof(InternedKey));
+    InternedKey *res = new (mem) InternedKey{this, h, (uint32_t)key.size()};
+    memcpy(const_cast<char*>(res->data()), key.data(), key.size());
+
+    // 装载率不超过一半
+    if((shard.count + 1) * 2 > shard.slots.size()){
+        std::vector<const InternedKey*> old(std::max<size_t>(64, shard.slots.size() * 2), nullptr);
+        old.swap(shard.slots);
+        for(auto k : old){
+            if(k){
+                place(shard, k);
+            }
+        }
+    }
+    place(shard, res);
+    ++shard.count;
+    return res;
+}
+
+
+uint64_t KeyPool::hits() const{
+    uint64_t n = 0;
+    for(size_t i = 0; i < shard_count; ++i){
+        n += shards_[i].hits.load(std::memory_order_relaxed);
+    }
+    return n;
+}
+
+
+uint64_t KeyPool::misses() const{
+    uint64_t n = 0;
+    for(size_t i = 0; i < shard_count; ++i){
+        n += shards_[i].misses.load(std::memory_order_relaxed);
+    }
+    return n;
+}
+
+
+void KeyPool::resetStats(){
+    for(size_t i = 0; i < shard_count; ++i){
+        shards_[i].hits.store(0, std::memory_order_relaxed);
+        shards_[i].misses.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+size_t KeyPool::size() const{
+    size_t n = 0;
+    for(size_t i = 0; i < shard_count; ++i){
+        std::shared_lock<std::shared_mutex> lock(shards_[i].mtx);
+        n += shards_[i].count;
+    }
+    return n;
+}
+
+
+size_t KeyPool::memoryBytes() const{
+    size_t n = 0;
+    for(size_t i = 0; i < shard_count; ++i){
+        std::shared_lock<std::shared_mutex> lock(shards_[i].mtx);
+        n += shards_[i].arena.used() + shards_[i].slots.capacity() * sizeof(const InternedKey*);
+    }
+    return n;
+}
+
+} // namespace json
+
+} // namespace haha
@@ -0,0 +1,60 @@
+#ifndef __HAHA_JSON_JSONKEYPOOL_H__
+#define __HAHA_JSON_JSONKEYPOOL_H__
+
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <shared_mutex>
+#include <stdint.h>
+#include "jsonObjectMap.h"
+#include "jsonArena.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 对象键的驻留池：相同的键只存一份，解析出的对象只持有指向它的指针
+   可以被多个线程、多次解析同时使用；池要比用到它的所有节点活得久 */
+class KeyPool{
+public:
+    /* 分片数，不同分片的键互不争锁 */
+    static constexpr size_t shard_count = 16;
+
+    KeyPool();
+    ~KeyPool();
+    KeyPool(const KeyPool &) = delete;
+    KeyPool &operator=(const KeyPool &) = delete;
+
+    /* 返回键在池中唯一的一份，没有时加入 */
+    const InternedKey* intern(std::string_view key);
+    /* 只查不加，没有时返回nullptr */
+    const InternedKey* find(std::string_view key) const;
+
+    /* intern命中已有键和新加入键的次数 */
+    uint64_t hits() const;
+    uint64_t misses() const;
+    void resetStats();
+
+    /* 池中键的个数 */
+    size_t size() const;
+    /* 池占用的内存，包括键的内容和哈希表 */
+    size_t memoryBytes() const;
+
+private:
+    struct Shard;
+
+    Shard& shardOf(size_t h) const;
+    static const InternedKey* lookup(const Shard &shard, std::string_view key, size_t h);
+    static void place(Shard &shard, const InternedKey *key);
+
+private:
+    Shard *shards_;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
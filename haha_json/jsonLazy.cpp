@@ -0,0 +1,372 @@
+#include "json.h"
+#include <charconv>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* ---------------------------------------------document--------------------------------------------- */
+
+bool LazyDocument::parse(std::string_view str){
+    index_.clear();
+    strings_.clear();
+    input_ = util::skip_utf8_bom(str);
+    root_ = skipSpace(0);
+    if(root_ >= input_.size()){
+        input_ = std::string_view();
+        return false;
+    }
+    return true;
+}
+
+
+bool LazyDocument::parseFile(const char *filePath){
+    auto buffer = std::make_shared<JsonBuffer>();
+    if(!buffer->readFile(filePath)){
+        return false;
+    }
+    buffer_ = std::move(buffer);
+    return parse(buffer_->to_stringview());
+}
+
+
+size_t LazyDocument::indexedMembers() const{
+    size_t n = 0;
+    for(auto &kv : index_){
+        n += kv.second.list.size();
+    }
+    return n;
+}
+
+
+size_t LazyDocument::skipSpace(size_t pos) const{
+    if(pos >= input_.size()){
+        return input_.size();
+    }
+    return pos + util::count_CtrlAndSpace(input_.data() + pos, input_.size() - pos);
+}
+
+
+LazyDocument::Members& LazyDocument::members(size_t container) const{
+    auto res = index_.try_emplace(container);
+    if(res.second){
+        res.first->second.resume = container + 1;
+    }
+    return res.first->second;
+}
+
+
+/* 逐个经过容器的成员，语法同parse_value(包括末尾可以多一个逗号)，成员的值用skip_value跳过 */
+bool LazyDocument::reach(size_t container, size_t i) const{
+    Members &ms = members(container);
+    bool object = input_[container] == '{';
+    char close = object ? '}' : ']';
+    while(ms.list.size() <= i){
+        if(ms.complete){
+            return false;
+        }
+        size_t pos = skipSpace(ms.resume);
+        if(pos >= input_.size()){
+            throw HAHA_JSON_ERROR("unexpected end of input");
+        }
+        if(!ms.list.empty()){
+            if(input_[pos] == ','){
+                pos = skipSpace(pos + 1);
+            }
+            else if(input_[pos] != close){
+                throw HAHA_JSON_ERROR("expect ',' or '" + std::string(1, close) + "'");
+            }
+        }
+        if(pos < input_.size() && input_[pos] == close){
+            ms.complete = true;
+            return false;
+        }
+
+        Member m{std::string_view(), 0};
+        if(object){
+            if(pos >= input_.size() || input_[pos] != '"'){
+                throw HAHA_JSON_ERROR("expect object key");
+            }
+            size_t end = skip_string(input_, pos);
+            if(end == skip_npos){
+                throw HAHA_JSON_ERROR("unterminated string");
+            }
+            m.key = string(pos, end);
+            pos = skipSpace(end);
+            if(pos >= input_.size() || input_[pos] != ':'){
+                throw HAHA_JSON_ERROR("expect ':'");
+            }
+            pos = skipSpace(pos + 1);
+        }
+        size_t end = skip_value(input_, pos);
+        if(end == skip_npos || end == pos){
+            throw HAHA_JSON_ERROR("invalid value");
+        }
+        m.value = pos;
+        ms.list.push_back(m);
+        ms.resume = end;
+    }
+    return true;
+}
+
+
+std::string_view LazyDocument::string(size_t pos, size_t end) const{
+    auto value = input_.substr(pos + 1, end - pos - 2);
+    if(value.find('\\') == std::string_view::npos){
+        return value;
+    }
+    auto it = strings_.find(pos);
+    if(it != strings_.end()){
+        return it->second;
+    }
+    // 把结束引号也带上，parse_escaped在它前面停下
+    auto rest = input_.substr(pos + 1, end - pos - 1);
+    std::string out;
+    if(!parse_escaped(rest, out)){
+        throw HAHA_JSON_ERROR("invalid escape in string");
+    }
+    return strings_.emplace(pos, std::move(out)).first->second;
+}
+
+/* ---------------------------------------------value--------------------------------------------- */
+
+char LazyValue::first() const{
+    return doc_ ? doc_->input_[pos_] : '\0';
+}
+
+
+std::string_view LazyValue::raw() const{
+    if(doc_ == nullptr){
+        return std::string_view();
+    }
+    size_t end = skip_value(doc_->input_, pos_);
+    if(end == skip_npos){
+        throw HAHA_JSON_ERROR("invalid value");
+    }
+    return doc_->input_.substr(pos_, end - pos_);
+}
+
+
+JsonType LazyValue::getType() const{
+    switch (first())
+    {
+    case '\0':
+        return JsonType::UNKOWN;
+    case '{':
+        return JsonType::Object;
+    case '[':
+        return JsonType::Array;
+    case '"':
+        return JsonType::String;
+    case 't':
+    case 'f':
+        return JsonType::Boolean;
+    case 'n':
+        return JsonType::Null;
+    default:
+        break;
+    }
+    NumberToken tok;
+    if(!scan_number(doc_->input_.substr(pos_), tok)){
+        return JsonType::UNKOWN;
+    }
+    return number_type(tok);
+}
+
+
+bool LazyValue::isNumber() const{
+    auto t = getType();
+    return t == JsonType::Integer || t == JsonType::Int64 || t == JsonType::UInt64 || t == JsonType::Double;
+}
+
+
+bool LazyValue::getBool() const{
+    auto text = doc_ ? doc_->input_.substr(pos_, 5) : std::string_view();
+    if(text.substr(0, 4) == "true"){
+        return true;
+    }
+    if(text == "false"){
+        return false;
+    }
+    throw HAHA_JSON_ERROR("lazy value is not a boolean");
+}
+
+
+int LazyValue::getInt() const{
+    if(!isInteger()){
+        throw HAHA_JSON_ERROR("lazy value is not an int");
+    }
+    return (int)getInt64();
+}
+
+
+int64_t LazyValue::getInt64() const{
+    auto t = getType();
+    if(t != JsonType::Integer && t != JsonType::Int64){
+        throw HAHA_JSON_ERROR("lazy value is not an int64");
+    }
+    NumberToken tok;
+    scan_number(doc_->input_.substr(pos_), tok);
+    return tok.negative ? (int64_t)(0 - tok.magnitude) : (int64_t)tok.magnitude;
+}
+
+
+uint64_t LazyValue::getUInt64() const{
+    auto t = getType();
+    if(t == JsonType::UInt64){
+        NumberToken tok;
+        scan_number(doc_->input_.substr(pos_), tok);
+        return tok.magnitude;
+    }
+    if((t == JsonType::Integer || t == JsonType::Int64) && getInt64() >= 0){
+        return (uint64_t)getInt64();
+    }
+    throw HAHA_JSON_ERROR("lazy value is not an uint64");
+}
+
+
+double LazyValue::getDouble() const{
+    if(!isNumber()){
+        throw HAHA_JSON_ERROR("lazy value is not a number");
+    }
+    NumberToken tok;
+    auto text = doc_->input_.substr(pos_);
+    scan_number(text, tok);
+    double d = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + tok.len, d);
+    if(ec != std::errc() || ptr != text.data() + tok.len){
+        throw HAHA_JSON_ERROR("number out of range");
+    }
+    return d;
+}
+
+
+std::string_view LazyValue::getString() const{
+    if(!isString()){
+        throw HAHA_JSON_ERROR("lazy value is not a string");
+    }
+    auto &input = doc_->input_;
+    size_t end = skip_string(input, pos_);
+    if(end == skip_npos){
+        throw HAHA_JSON_ERROR("unterminated string");
+    }
+    return doc_->string(pos_, end);
+}
+
+
+size_t LazyValue::size() const{
+    if(!isIterable()){
+        return 0;
+    }
+    // 扫描到末尾，顺带把所有成员的位置记下
+    doc_->reach(pos_, (size_t)-2);
+    return doc_->members(pos_).list.size();
+}
+
+
+LazyValue LazyValue::operator[](size_t i) const{
+    if(!isArray()){
+        throw HAHA_JSON_ERROR("do not support operator[]");
+    }
+    if(!doc_->reach(pos_, i)){
+        throw HAHA_JSON_ERROR("array index out of range");
+    }
+    return LazyValue(doc_, doc_->members(pos_).list[i].value);
+}
+
+
+LazyValue LazyValue::find(std::string_view key) const{
+    if(!isObject()){
+        return LazyValue();
+    }
+    // 先在已经经过的成员里找，找不到再往后扫描
+    auto &list = doc_->members(pos_).list;
+    for(size_t i = 0; i < list.size() || doc_->reach(pos_, i); ++i){
+        if(list[i].key == key){
+            return LazyValue(doc_, list[i].value);
+        }
+    }
+    return LazyValue();
+}
+
+
+LazyValue LazyValue::operator[](std::string_view key) const{
+    if(!isObject()){
+        throw HAHA_JSON_ERROR("do not support operator[]");
+    }
+    auto res = find(key);
+    if(!res.valid()){
+        throw HAHA_JSON_ERROR("key not found: " + std::string(key));
+    }
+    return res;
+}
+
+
+LazyValue::iterator LazyValue::begin() const{
+    if(!isIterable()){
+        return end();
+    }
+    return iterator(doc_, pos_, 0);
+}
+
+
+LazyValue::iterator LazyValue::end() const{
+    return iterator(nullptr, 0, 0);
+}
+
+
+JsonNode::ptr LazyValue::toNode() const{
+    if(doc_ == nullptr){
+        return nullptr;
+    }
+    auto text = raw();
+    return parse_value(text);
+}
+
+
+std::string LazyValue::toString(const PrintFormatter &format) const{
+    auto node = toNode();
+    if(node == nullptr){
+        throw HAHA_JSON_ERROR("invalid value");
+    }
+    return node->toString(format);
+}
+
+/* ---------------------------------------------iterator--------------------------------------------- */
+
+LazyValue::iterator::iterator(const LazyDocument *doc, size_t container, size_t i)
+    :doc_(doc),container_(container),i_(i){
+    check();
+}
+
+
+void LazyValue::iterator::check(){
+    if(doc_ && !doc_->reach(container_, i_)){
+        doc_ = nullptr;
+        container_ = 0;
+        i_ = 0;
+    }
+}
+
+
+LazyValue LazyValue::iterator::operator*() const{
+    return LazyValue(doc_, doc_->members(container_).list[i_].value);
+}
+
+
+std::string_view LazyValue::iterator::key() const{
+    return doc_->members(container_).list[i_].key;
+}
+
+
+LazyValue::iterator& LazyValue::iterator::operator++(){
+    ++i_;
+    check();
+    return *this;
+}
+
+} // namespace json
+
+} // namespace haha
@@ -0,0 +1,159 @@
+#ifndef __HAHA_JSON_JSONLAZY_H__
+#define __HAHA_JSON_JSONLAZY_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "jsonValue.h"
+#include "jsonBuffer.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+class LazyDocument;
+
+/* 按需解析的文档中某个值的视图，不持有文档，接口与JsonTapeRef对应
+   访问到哪里才解析到哪里，经过的容器成员记下位置，再次访问时不必重新扫描 */
+class LazyValue{
+public:
+    class iterator;
+
+    LazyValue() {}
+    LazyValue(const LazyDocument *doc, size_t pos):doc_(doc),pos_(pos){}
+
+    /* 默认构造的和find没找到时返回的视图无效 */
+    bool valid() const { return doc_ != nullptr; }
+
+    /* 只看第一个字符，数字要扫描一遍才知道具体类型 */
+    JsonType getType() const;
+    bool isIterable() const { return isObject() || isArray(); }
+    bool isString() const { return first() == '"'; }
+    bool isNumber() const;
+    bool isInteger() const { return getType() == JsonType::Integer; }
+    bool isInt64() const { return getType() == JsonType::Int64; }
+    bool isUInt64() const { return getType() == JsonType::UInt64; }
+    bool isDouble() const { return getType() == JsonType::Double; }
+    bool isBoolean() const { return first() == 't' || first() == 'f'; }
+    bool isNull() const { return first() == 'n'; }
+    bool isArray() const { return first() == '['; }
+    bool isObject() const { return first() == '{'; }
+
+    /* 类型不符或值不合法时抛出异常；整数可以按更宽的类型读，任何数字都可以按double读 */
+    bool getBool() const;
+    int getInt() const;
+    int64_t getInt64() const;
+    uint64_t getUInt64() const;
+    double getDouble() const;
+    /* 不含转义时直接引用输入，否则反转义到文档里 */
+    std::string_view getString() const;
+
+    /* 数组的元素个数或对象的键值对数，其余类型为0；需要扫描到容器末尾 */
+    size_t size() const;
+
+    /* 越界、键不存在或类型不符时抛出异常 */
+    LazyValue operator[](size_t i) const;
+    LazyValue operator[](std::string_view key) const;
+    /* 对象中查找键，找不到返回无效视图；重复的键取第一个 */
+    LazyValue find(std::string_view key) const;
+
+    /* 遍历数组元素或对象的值，对象的键用iterator::key()取得 */
+    iterator begin() const;
+    iterator end() const;
+
+    /* 这个值在输入中的原文 */
+    std::string_view raw() const;
+    /* 完整解析成普通的JsonNode树，语法错误时返回nullptr */
+    JsonNode::ptr toNode() const;
+    std::string toString(const PrintFormatter &format = PrintFormatter()) const;
+
+    size_t offset() const { return pos_; }
+
+private:
+    char first() const;
+
+private:
+    const LazyDocument *doc_ = nullptr;
+    size_t pos_ = 0;
+};
+
+
+class LazyValue::iterator{
+public:
+    /* i为成员序号，文档为空表示end */
+    iterator(const LazyDocument *doc, size_t container, size_t i);
+
+    /* 当前的值 */
+    LazyValue operator*() const;
+    /* 当前的键，只对对象有效 */
+    std::string_view key() const;
+
+    iterator& operator++();
+    bool operator==(const iterator &rhs) const { return doc_ == rhs.doc_ && i_ == rhs.i_; }
+    bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+private:
+    void check();
+
+private:
+    const LazyDocument *doc_;
+    size_t container_;
+    size_t i_;
+};
+
+
+/* 按需解析的文档：parse时只找到根值，其余部分在访问时才解析
+   没有访问到的子树只做引号和括号的快速扫描，不构建节点，也不检查语法
+   访问时遇到语法错误抛出异常。记录位置的缓存不是线程安全的，一个文档只在一个线程里用 */
+class LazyDocument{
+public:
+    /* 输入要比文档活得久；输入为空时返回false */
+    bool parse(std::string_view str);
+    /* 文件缓冲区由文档持有 */
+    bool parseFile(const char *filePath);
+
+    LazyValue root() const { return input_.empty() ? LazyValue() : LazyValue(this, root_); }
+
+    std::string_view input() const { return input_; }
+    /* 已经记下位置的容器成员数 */
+    size_t indexedMembers() const;
+
+private:
+    friend class LazyValue;
+    friend class LazyValue::iterator;
+
+    /* 容器里已经经过的成员 */
+    struct Member{
+        std::string_view key;   // 键，含转义时指向反转义的结果，数组中不用
+        size_t value;           // 值的位置
+    };
+    struct Members{
+        std::vector<Member> list;
+        size_t resume;      // 从这里继续扫描下一个成员
+        bool complete = false;
+    };
+
+    Members& members(size_t container) const;
+    /* 确保第i个成员已经扫描过，不存在时返回false */
+    bool reach(size_t container, size_t i) const;
+    /* pos处字符串的内容，含转义时反转义一次后缓存下来 */
+    std::string_view string(size_t pos, size_t end) const;
+    size_t skipSpace(size_t pos) const;
+
+private:
+    std::string_view input_;
+    size_t root_ = 0;
+    std::shared_ptr<JsonBuffer> buffer_;
+    mutable std::unordered_map<size_t, Members> index_;
+    mutable std::unordered_map<size_t, std::string> strings_;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
@@ -0,0 +1,254 @@
+#include "json.h"
+#include <string.h>
+#include <mutex>
+#include <condition_variable>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* ---------------------------------------------按行解析--------------------------------------------- */
+
+namespace
+{
+
+/* 一批连续的行，由一个线程解析 */
+struct LineBatch{
+    size_t begin;               // 在输入中的范围，end处是换行符之后或输入末尾
+    size_t end;
+    size_t first_line;          // 第一行的行号
+    JsonArena *arena = nullptr;
+    std::vector<LineResult> results;
+    bool done = false;
+};
+
+class LinesRunner{
+public:
+    LinesRunner(std::string_view input, const ParseOptions &parse, const LinesOptions &opts)
+        :input_(input), parse_(parse), opts_(opts){
+        parse_.structural_index = false;
+    }
+
+    /* 可写的输入，借用模式下原地反转义，owner让输入活着 */
+    void setWritable(char *begin, std::shared_ptr<const void> owner){
+        wbegin_ = begin;
+        owner_ = std::move(owner);
+    }
+
+    LinesStats run(const LineHandler &handler){
+        LinesStats stats;
+        stats.bytes = input_.size();
+        if(input_.size() >= 3 && input_.compare(0, 3, "\xEF\xBB\xBF") == 0){
+            cursor_ = 3;
+        }
+
+        std::unique_ptr<ThreadPool> own;
+        ThreadPool *pool = opts_.pool;
+        if(!pool){
+            // 按cpu核数时用共用的线程池；指定了别的线程数，或者本身就在共用池的线程里(等交付时会占着它)才临时创建
+            ThreadPool &shared = ThreadPool::shared();
+            if((opts_.threads == 0 || opts_.threads == shared.size()) && !shared.inWorker()){
+                pool = &shared;
+            }
+            else{
+                own = std::make_unique<ThreadPool>(opts_.threads);
+                pool = own.get();
+            }
+        }
+        else if(pool->inWorker()){
+            // 在调用者给的线程池的线程里调用时，等交付会占着这个线程，只有一个线程的池就会死锁，换成同样大小的临时线程池
+            own = std::make_unique<ThreadPool>(pool->size());
+            pool = own.get();
+        }
+        // 在途的批数有上限，交付跟不上时不再继续切分，内存不随输入增长
+        size_t window = (size_t)pool->size() * 4;
+
+        // 批要比任务活得久，TaskGroup析构时等待所有任务
+        TaskGroup group(*pool);
+
+        auto submit = [&]{
+            auto batch = std::make_unique<LineBatch>();
+            batch->begin = cursor_;
+            batch->end = split(cursor_);
+            batch->first_line = line_;
+            line_ += count_lines(batch->begin, batch->end);
+            cursor_ = batch->end;
+            if(opts_.arena){
+                if(free_arenas_.empty()){
+                    arenas_.emplace_back(std::make_unique<JsonArena>());
+                    free_arenas_.push_back(arenas_.back().get());
+                }
+                batch->arena = free_arenas_.back();
+                free_arenas_.pop_back();
+            }
+            LineBatch *b = batch.get();
+            size_t id = batches_.size();
+            batches_.push_back(std::move(batch));
+            group.run([this, b, id](unsigned){ parseBatch(*b, id); });
+        };
+
+        size_t inflight = 0;
+        size_t delivered = 0;
+        size_t next = 0;
+        while(true){
+            while(inflight < window && cursor_ < input_.size()){
+                submit();
+                ++inflight;
+            }
+            if(delivered == batches_.size()){
+                break;
+            }
+            size_t id;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if(opts_.ordered){
+                    cv_.wait(lock, [&]{ return batches_[next]->done; });
+                    id = next++;
+                }
+                else{
+                    cv_.wait(lock, [&]{ return !completed_.empty(); });
+                    id = completed_.front();
+                    completed_.pop_front();
+                }
+            }
+            LineBatch &b = *batches_[id];
+            for(auto &res : b.results){
+                ++stats.lines;
+                if(!res.value){
+                    ++stats.errors;
+                }
+                handler(res);
+            }
+            // 节点先于内存池释放，内存池清空后给后面的批用
+            b.results.clear();
+            if(b.arena){
+                b.arena->reset();
+                free_arenas_.push_back(b.arena);
+            }
+            batches_[id].reset();
+            ++delivered;
+            --inflight;
+        }
+        return stats;
+    }
+
+private:
+    /* 从begin起取大约batch_bytes字节，延伸到下一个换行符之后 */
+    size_t split(size_t begin) const {
+        size_t size = input_.size();
+        size_t end = begin + std::max<size_t>(opts_.batch_bytes, 1);
+        if(end >= size){
+            return size;
+        }
+        auto p = (const char*)memchr(input_.data() + end, '\n', size - end);
+        return p ? (size_t)(p - input_.data()) + 1 : size;
+    }
+
+    size_t count_lines(size_t begin, size_t end) const {
+        size_t n = 0;
+        const char *p = input_.data() + begin;
+        const char *e = input_.data() + end;
+        while((p = (const char*)memchr(p, '\n', e - p))){
+            ++n;
+            ++p;
+        }
+        return n;
+    }
+
+    void parseBatch(LineBatch &b, size_t id){
+        // 每批一个上下文，反转义的字符串池不会在整个输入上越积越大
+        ParseContext ctx(parse_);
+        if(wbegin_){
+            ctx.setWritable(wbegin_, wbegin_ + input_.size(), owner_);
+        }
+        ctx.setArena(b.arena);
+        size_t line = b.first_line;
+        size_t pos = b.begin;
+        while(pos < b.end){
+            auto nl = (const char*)memchr(input_.data() + pos, '\n', b.end - pos);
+            size_t stop = nl ? (size_t)(nl - input_.data()) : b.end;
+            auto text = input_.substr(pos, stop - pos);
+            if(!text.empty() && text.back() == '\r'){
+                text.remove_suffix(1);
+            }
+            auto view = util::skip_CtrlAndSpace(text);
+            if(!view.empty()){
+                // 一行只能有一个值，值之后只能是空白
+                auto value = parse_value(view, ctx);
+                if(value && !util::skip_CtrlAndSpace(view).empty()){
+                    value = nullptr;
+                }
+                b.results.push_back(LineResult{line, pos, text, std::move(value)});
+            }
+            ++line;
+            pos = stop + 1;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        b.done = true;
+        if(!opts_.ordered){
+            completed_.push_back(id);
+        }
+        cv_.notify_all();
+    }
+
+private:
+    std::string_view input_;
+    ParseOptions parse_;
+    const LinesOptions &opts_;
+    char *wbegin_ = nullptr;
+    std::shared_ptr<const void> owner_;
+
+    // 只有调用线程访问
+    size_t cursor_ = 0;
+    size_t line_ = 1;
+    // 批里的节点可能在内存池里，批要先于内存池析构
+    std::vector<std::unique_ptr<JsonArena>> arenas_;
+    std::vector<JsonArena*> free_arenas_;
+    std::vector<std::unique_ptr<LineBatch>> batches_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<size_t> completed_;
+};
+
+} // namespace
+
+
+LinesStats parseLines(std::string_view input, const LineHandler &handler,
+                      const ParseOptions &parse, const LinesOptions &opts){
+    return LinesRunner(input, parse, opts).run(handler);
+}
+
+
+LinesStats parseLines(std::string_view input, const LineHandler &handler){
+    return parseLines(input, handler, ParseOptions());
+}
+
+
+LinesStats parseLinesFile(const char *filePath, const LineHandler &handler,
+                          const ParseOptions &parse, const LinesOptions &opts){
+    auto buffer = std::make_shared<JsonBuffer>();
+    if(!buffer->readFile(filePath)){
+        LinesStats stats;
+        stats.ok = false;
+        return stats;
+    }
+    LinesRunner runner(buffer->to_stringview(), parse, opts);
+    if(parse.borrowed || parse.lazy_numbers){
+        // 同fromFile，节点持有缓冲区
+        runner.setWritable(buffer->data(), buffer);
+    }
+    return runner.run(handler);
+}
+
+
+LinesStats parseLinesFile(const char *filePath, const LineHandler &handler){
+    return parseLinesFile(filePath, handler, ParseOptions());
+}
+
+} // namespace json
+
+} // namespace haha
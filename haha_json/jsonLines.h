@@ -0,0 +1,63 @@
+#ifndef __HAHA_JSON_JSONLINES_H__
+#define __HAHA_JSON_JSONLINES_H__
+
+#include <string_view>
+#include <functional>
+#include "jsonValue.h"
+#include "jsonThreadPool.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+struct ParseOptions;
+
+/* 按行解析(NDJSON / JSON Lines)的选项 */
+struct LinesOptions{
+    /* 线程数，0表示按cpu核数，这时用ThreadPool::shared()；其他值每次调用临时创建线程池
+       pool不为空时用它，忽略threads；在pool自己的线程里调用时改用同样大小的临时线程池 */
+    unsigned threads = 0;
+    ThreadPool *pool = nullptr;
+    /* 每批的大致字节数，一批由一个线程解析，批的边界总在换行处 */
+    size_t batch_bytes = 1 << 20;
+    /* true时按行的顺序交付结果，false时哪批先解析完先交付哪批(批内仍按顺序) */
+    bool ordered = true;
+    /* 每批的节点从内存池分配，整批交付完内存池就回收再用，这时节点只在回调里有效 */
+    bool arena = false;
+};
+
+/* 一行的解析结果 */
+struct LineResult{
+    size_t line;            // 行号，从1开始
+    size_t offset;          // 行首在输入中的偏移
+    std::string_view text;  // 这一行的内容，不含换行符
+    JsonNode::ptr value;    // 解析失败时为nullptr
+};
+
+struct LinesStats{
+    bool ok = true;         // 输入读取失败时为false
+    size_t lines = 0;       // 非空行数，空行和只有空白的行跳过
+    size_t errors = 0;      // 解析失败的行数，出错的行不影响其他行
+    size_t bytes = 0;
+};
+
+/* 结果都在调用parseLines的线程上交付 */
+using LineHandler = std::function<void(LineResult &)>;
+
+/* 多线程解析每行一个值的输入，每行的值之后只能是空白
+   parse的选项同parse()，structural_index和threads不起作用 */
+LinesStats parseLines(std::string_view input, const LineHandler &handler,
+                      const ParseOptions &parse, const LinesOptions &opts = LinesOptions());
+LinesStats parseLines(std::string_view input, const LineHandler &handler);
+/* 文件映射进内存后解析，借用模式和延迟数字下节点持有映射 */
+LinesStats parseLinesFile(const char *filePath, const LineHandler &handler,
+                          const ParseOptions &parse, const LinesOptions &opts = LinesOptions());
+LinesStats parseLinesFile(const char *filePath, const LineHandler &handler);
+
+} // namespace json
+
+} // namespace haha
+
+#endif
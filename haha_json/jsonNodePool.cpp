@@ -0,0 +1,301 @@
+#include "jsonNodePool.h"
+#include <string.h>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+namespace haha
+{
+
+namespace json
+{
+
+namespace
+{
+
+inline size_t combine(size_t h, size_t v){
+    return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+inline size_t hash_ptr(const JsonNode::ptr &p){
+    return std::hash<const void*>()(p.get());
+}
+
+template<typename N>
+size_t hash_number(const JsonNode &node){
+    auto &num = static_cast<const N&>(node);
+    if(!num.raw().empty()){
+        return combine(1, hashKey(num.raw()));
+    }
+    auto value = num.getValue();
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(value));
+    return combine(2, std::hash<uint64_t>()(bits));
+}
+
+/* 只看节点本身，子节点按指针算 */
+size_t shallow_hash(const JsonNode &node){
+    size_t h = (size_t)node.getType();
+    switch (node.getType())
+    {
+    case JsonType::String:
+        return combine(h, hashKey(static_cast<const JsonString&>(node).view()));
+    case JsonType::Boolean:
+        return combine(h, static_cast<const JsonBoolean&>(node).getValue());
+    case JsonType::Integer:
+        return combine(h, hash_number<JsonInteger>(node));
+    case JsonType::Int64:
+        return combine(h, hash_number<JsonInt64>(node));
+    case JsonType::UInt64:
+        return combine(h, hash_number<JsonUInt64>(node));
+    case JsonType::Double:
+        return combine(h, hash_number<JsonDouble>(node));
+    case JsonType::Array:
+        for(auto &v : static_cast<const JsonArray&>(node).getValue()){
+            h = combine(h, hash_ptr(v));
+        }
+        return h;
+    case JsonType::Object:
+        for(auto &[k, v] : static_cast<const JsonObject&>(node).getValue()){
+            h = combine(combine(h, k.hash()), hash_ptr(v));
+        }
+        return h;
+    default:
+        return h;
+    }
+}
+
+/* 有原文的数字只比原文，都没有时按位比较数值(区分0.0与-0.0)，一个有一个没有时不合并 */
+template<typename N>
+bool same_number(const JsonNode &a, const JsonNode &b){
+    auto &x = static_cast<const N&>(a);
+    auto &y = static_cast<const N&>(b);
+    if(!x.raw().empty() || !y.raw().empty()){
+        return x.raw() == y.raw();
+    }
+    auto vx = x.getValue(), vy = y.getValue();
+    return memcmp(&vx, &vy, sizeof(vx)) == 0;
+}
+
+bool shallow_equal(const JsonNode &a, const JsonNode &b){
+    if(a.getType() != b.getType()){
+        return false;
+    }
+    switch (a.getType())
+    {
+    case JsonType::String:
+        return static_cast<const JsonString&>(a).view() == static_cast<const JsonString&>(b).view();
+    case JsonType::Boolean:
+        return static_cast<const JsonBoolean&>(a).getValue() == static_cast<const JsonBoolean&>(b).getValue();
+    case JsonType::Integer:
+        return same_number<JsonInteger>(a, b);
+    case JsonType::Int64:
+        return same_number<JsonInt64>(a, b);
+    case JsonType::UInt64:
+        return same_number<JsonUInt64>(a, b);
+    case JsonType::Double:
+        return same_number<JsonDouble>(a, b);
+    case JsonType::Array:
+        return static_cast<const JsonArray&>(a).getValue() == static_cast<const JsonArray&>(b).getValue();
+    case JsonType::Object:{
+        auto &x = static_cast<const JsonObject&>(a).getValue();
+        auto &y = static_cast<const JsonObject&>(b).getValue();
+        if(x.size() != y.size()){
+            return false;
+        }
+        for(auto i = x.begin(), j = y.begin(); i != x.end(); ++i, ++j){
+            if(i->second != j->second || i->first != j->first){
+                return false;
+            }
+        }
+        return true;
+    }
+    default:
+        return true;
+    }
+}
+
+/* 节点自身估计占用的内存：make_shared的控制块、节点，以及字符串和容器在堆上的部分 */
+size_t node_bytes(const JsonNode &node){
+    const size_t control = 16;
+    switch (node.getType())
+    {
+    case JsonType::String:{
+        auto &str = static_cast<const JsonString&>(node);
+        size_t n = control + sizeof(JsonString);
+        if(!str.isBorrowed() && str.getValue().capacity() > 15){
+            n += str.getValue().capacity() + 1;
+        }
+        return n;
+    }
+    case JsonType::Array:{
+        auto &list = static_cast<const JsonArray&>(node).getValue();
+        return control + sizeof(JsonArray) + list.capacity() * sizeof(JsonNode::ptr);
+    }
+    case JsonType::Object:{
+        auto &map = static_cast<const JsonObject&>(node).getValue();
+        size_t n = control + sizeof(JsonObject) + map.size() * sizeof(JsonObject::kv_pair);
+        for(auto &kv : map){
+            if(!kv.first.isInterned() && kv.first.size() > ObjectKey::inline_capacity){
+                n += kv.first.size();
+            }
+        }
+        return n;
+    }
+    case JsonType::Integer:
+        return control + sizeof(JsonInteger);
+    case JsonType::Int64:
+        return control + sizeof(JsonInt64);
+    case JsonType::UInt64:
+        return control + sizeof(JsonUInt64);
+    case JsonType::Double:
+        return control + sizeof(JsonDouble);
+    case JsonType::Boolean:
+        return control + sizeof(JsonBoolean);
+    default:
+        return control + sizeof(JsonNull);
+    }
+}
+
+} // namespace
+
+
+/* 每个分片一张以浅哈希为键的表，计数器也按分片放 */
+struct alignas(64) NodePool::Shard{
+    std::mutex mtx;
+    std::unordered_multimap<size_t, JsonNode::ptr> nodes;
+    std::atomic<uint64_t> seen{0};
+    std::atomic<uint64_t> merged{0};
+    std::atomic<uint64_t> saved{0};
+};
+
+
+NodePool::NodePool(bool share_containers)
+    :shards_(new Shard[shard_count]),
+    share_containers_(share_containers)
+{
+}
+
+
+NodePool::~NodePool(){
+    delete[] shards_;
+}
+
+
+JsonNode::ptr NodePool::intern(JsonNode::ptr node){
+    if(node == nullptr || (!share_containers_ && node->isIterable())){
+        return node;
+    }
+    size_t h = shallow_hash(*node);
+    Shard &shard = shards_[(h >> 7) % shard_count];
+    shard.seen.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto range = shard.nodes.equal_range(h);
+    for(auto it = range.first; it != range.second; ++it){
+        if(it->second == node){
+            return node;
+        }
+        if(shallow_equal(*it->second, *node)){
+            shard.merged.fetch_add(1, std::memory_order_relaxed);
+            // 别处还引用着它时并不会释放
+            if(node.use_count() == 1){
+                shard.saved.fetch_add(node_bytes(*node), std::memory_order_relaxed);
+            }
+            return it->second;
+        }
+    }
+    // 之后各处共享它，不能再改
+    node->setReadOnly();
+    shard.nodes.emplace(h, node);
+    return node;
+}
+
+
+JsonNode::ptr NodePool::dedupNode(JsonNode::ptr node){
+    // 先合并子节点，容器就地改成指向池里的那一份；只读的容器已经合并过
+    if(node->readOnly()){
+        return intern(std::move(node));
+    }
+    if(node->getType() == JsonType::Array){
+        for(auto &v : static_cast<JsonArray&>(*node).getValue()){
+            v = dedupNode(std::move(v));
+        }
+    }
+    else if(node->getType() == JsonType::Object){
+        for(auto &kv : static_cast<JsonObject&>(*node).getValue()){
+            kv.second = dedupNode(std::move(kv.second));
+        }
+    }
+    return intern(std::move(node));
+}
+
+
+JsonNode::ptr NodePool::dedup(JsonNode::ptr root){
+    return root ? dedupNode(std::move(root)) : root;
+}
+
+
+DedupStats NodePool::stats() const{
+    DedupStats res;
+    for(size_t i = 0; i < shard_count; ++i){
+        res.nodes += shards_[i].seen.load(std::memory_order_relaxed);
+        res.merged += shards_[i].merged.load(std::memory_order_relaxed);
+        res.bytes_saved += shards_[i].saved.load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
+
+void NodePool::resetStats(){
+    for(size_t i = 0; i < shard_count; ++i){
+        shards_[i].seen.store(0, std::memory_order_relaxed);
+        shards_[i].merged.store(0, std::memory_order_relaxed);
+        shards_[i].saved.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+size_t NodePool::size() const{
+    size_t n = 0;
+    for(size_t i = 0; i < shard_count; ++i){
+        std::lock_guard<std::mutex> lock(shards_[i].mtx);
+        n += shards_[i].nodes.size();
+    }
+    return n;
+}
+
+
+size_t NodePool::memoryBytes() const{
+    // 表中每个节点：next指针、键、shared_ptr，另有桶数组
+    const size_t entry = sizeof(void*) + sizeof(size_t) + sizeof(JsonNode::ptr);
+    size_t n = sizeof(Shard) * shard_count;
+    for(size_t i = 0; i < shard_count; ++i){
+        std::lock_guard<std::mutex> lock(shards_[i].mtx);
+        n += shards_[i].nodes.size() * entry + shards_[i].nodes.bucket_count() * sizeof(void*);
+    }
+    return n;
+}
+
+
+void NodePool::clear(){
+    for(size_t i = 0; i < shard_count; ++i){
+        // 换出来在锁外释放
+        std::unordered_multimap<size_t, JsonNode::ptr> nodes;
+        std::lock_guard<std::mutex> lock(shards_[i].mtx);
+        nodes.swap(shards_[i].nodes);
+    }
+}
+
+
+JsonNode::ptr dedup(JsonNode::ptr root, DedupStats *stats, bool share_containers){
+    NodePool pool(share_containers);
+    auto res = pool.dedup(std::move(root));
+    if(stats){
+        *stats = pool.stats();
+    }
+    return res;
+}
+
+} // namespace json
+
+} // namespace haha
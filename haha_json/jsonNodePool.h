@@ -0,0 +1,72 @@
+#ifndef __HAHA_JSON_JSONNODEPOOL_H__
+#define __HAHA_JSON_JSONNODEPOOL_H__
+
+#include <stdint.h>
+#include "jsonValue.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 去重的统计 */
+struct DedupStats{
+    uint64_t nodes = 0;         // 参与合并的节点数(不共享容器时不含容器)
+    uint64_t merged = 0;        // 换成池里已有那一份的节点数
+    uint64_t bytes_saved = 0;   // 因此释放的节点估计占用的内存
+};
+
+/* 节点池(hash consing)：相同的字符串和数字、bool、null只留一份，各处共享
+   "相同"比operator==严格：类型和延迟数字的原文都要一样，合并后序列化的结果不变
+   加入池的节点都设为只读(见JsonNode::readOnly)，非const的getValue、赋值等抛出JsonError，改一处不会改到共享它的地方，也不会弄乱池里的表
+   默认不合并数组和对象，树里的容器仍然各是各的，可以照常增删成员；合并的标量要改时换掉整个节点
+   share_containers为true时结构完全相同的子树也只留一份(自下而上合并，比较容器时只比子节点指针)，整棵树都是只读的，
+   要修改时交给JsonSnapshot(复制路径上共享或只读的节点)
+   池持有加入的节点，池存活期间它们不会释放；线程安全，多次解析、多个线程可以共用一个池 */
+class NodePool{
+public:
+    /* 分片数，不同分片的节点互不争锁 */
+    static constexpr size_t shard_count = 16;
+
+    explicit NodePool(bool share_containers = false);
+    ~NodePool();
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
+
+    /* 对整棵树去重，返回合并后的根；树里的容器会被就地改成指向池里的节点 */
+    JsonNode::ptr dedup(JsonNode::ptr root);
+    /* 只合并node本身，容器的子节点要已经来自这个池；解析时每建好一个节点调用一次
+       没有share_containers时容器原样返回 */
+    JsonNode::ptr intern(JsonNode::ptr node);
+
+    bool sharesContainers() const { return share_containers_; }
+
+    DedupStats stats() const;
+    void resetStats();
+
+    /* 池中的节点数 */
+    size_t size() const;
+    /* 池自身的哈希表占用的内存，不含节点 */
+    size_t memoryBytes() const;
+    /* 放掉池持有的所有节点 */
+    void clear();
+
+private:
+    struct Shard;
+
+    JsonNode::ptr dedupNode(JsonNode::ptr node);
+
+private:
+    Shard *shards_;
+    bool share_containers_;
+};
+
+/* 不保留池的一次性去重，stats不为空时填入统计；share_containers同NodePool */
+JsonNode::ptr dedup(JsonNode::ptr root, DedupStats *stats = nullptr, bool share_containers = false);
+
+} // namespace json
+
+} // namespace haha
+
+#endif
@@ -0,0 +1,429 @@
+#ifndef __HAHA_JSON_JSONOBJECTMAP_H__
+#define __HAHA_JSON_JSONOBJECTMAP_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <functional>
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 对象成员的查找方式
+   Auto：成员不多时线性查找，超过hash_threshold后建哈希索引
+   Linear：始终线性查找，适合都很小的对象
+   Hash：始终维护哈希索引 */
+enum class ObjectIndexPolicy : uint8_t { Auto, Linear, Hash };
+
+
+/* 对象的键用的哈希函数，JsonKey和ObjectMap的索引共用 */
+inline size_t hashKey(std::string_view key){
+    return std::hash<std::string_view>()(key);
+}
+
+
+/* KeyPool中的一个键：头部之后紧跟着键的内容，地址在池的生命周期内不变 */
+struct InternedKey{
+    const void *pool;   // 所属的池，同一个池里相同的键只有一份
+    size_t hash;
+    uint32_t size;
+
+    const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+    std::string_view view() const { return std::string_view(data(), size); }
+};
+
+
+/* 对象成员的键：不超过inline_capacity的就地存放，更长的单独分配，来自KeyPool的只存指针
+   两个键来自同一个池时，相等比较只比指针 */
+class ObjectKey{
+public:
+    static constexpr size_t inline_capacity = 16;
+
+    ObjectKey() {}
+    ObjectKey(std::string_view key){ assign(key); }
+    ObjectKey(const std::string &key){ assign(key); }
+    ObjectKey(const char *key){ assign(key); }
+    /* 池里的键，池要比这个键活得久 */
+    explicit ObjectKey(const InternedKey *key):interned_(key),size_(key->size),kind_(Kind::Interned){}
+
+    ObjectKey(const ObjectKey &other){ copy(other); }
+    ObjectKey(ObjectKey &&other) noexcept { steal(other); }
+    ObjectKey &operator=(const ObjectKey &other){
+        if(this != &other){
+            destroy();
+            copy(other);
+        }
+        return *this;
+    }
+    ObjectKey &operator=(ObjectKey &&other) noexcept {
+        if(this != &other){
+            destroy();
+            steal(other);
+        }
+        return *this;
+    }
+    ~ObjectKey(){ destroy(); }
+
+    const char* data() const {
+        switch (kind_)
+        {
+        case Kind::Inline:
+            return inline_;
+        case Kind::Heap:
+            return heap_;
+        default:
+            return interned_->data();
+        }
+    }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    char back() const { return data()[size_ - 1]; }
+    std::string_view view() const { return std::string_view(data(), size_); }
+    operator std::string_view() const { return view(); }
+    std::string str() const { return std::string(view()); }
+
+    bool isInterned() const { return kind_ == Kind::Interned; }
+    const InternedKey* interned() const { return isInterned() ? interned_ : nullptr; }
+
+    /* 池里的键直接用算好的哈希 */
+    size_t hash() const { return isInterned() ? interned_->hash : hashKey(view()); }
+
+    friend bool operator==(const ObjectKey &a, const ObjectKey &b){
+        if(a.isInterned() && b.isInterned() && a.interned_->pool == b.interned_->pool){
+            return a.interned_ == b.interned_;
+        }
+        return a.view() == b.view();
+    }
+    friend bool operator!=(const ObjectKey &a, const ObjectKey &b){ return !(a == b); }
+    friend bool operator==(const ObjectKey &a, std::string_view b){ return a.view() == b; }
+    friend bool operator!=(const ObjectKey &a, std::string_view b){ return a.view() != b; }
+    friend bool operator<(const ObjectKey &a, const ObjectKey &b){ return a.view() < b.view(); }
+
+private:
+    enum class Kind : uint8_t { Inline, Heap, Interned };
+
+    void assign(std::string_view key){
+        size_ = (uint32_t)key.size();
+        if(key.size() <= inline_capacity){
+            kind_ = Kind::Inline;
+            memcpy(inline_, key.data(), key.size());
+        }
+        else{
+            kind_ = Kind::Heap;
+            heap_ = new char[key.size()];
+            memcpy(heap_, key.data(), key.size());
+        }
+    }
+    void copy(const ObjectKey &other){
+        if(other.kind_ == Kind::Heap){
+            assign(other.view());
+        }
+        else{
+            memcpy(inline_, other.inline_, inline_capacity);
+            size_ = other.size_;
+            kind_ = other.kind_;
+        }
+    }
+    void steal(ObjectKey &other){
+        memcpy(inline_, other.inline_, inline_capacity);
+        size_ = other.size_;
+        kind_ = other.kind_;
+        other.size_ = 0;
+        other.kind_ = Kind::Inline;
+    }
+    void destroy(){
+        if(kind_ == Kind::Heap){
+            delete[] heap_;
+        }
+    }
+
+private:
+    union{
+        char inline_[inline_capacity] = {};
+        char *heap_;
+        const InternedKey *interned_;
+    };
+    uint32_t size_ = 0;
+    Kind kind_ = Kind::Inline;
+};
+
+
+/* 预先算好哈希的键：同样结构的大量对象反复按同一批键取值时，只在构造时算一次
+   另外记住上次命中的位置，同结构的下一个对象先看这个位置，多数时候一次比较就找到
+   自己持有键的内容，与被查找的对象无关；可以在多个线程间共用 */
+class JsonKey{
+public:
+    explicit JsonKey(std::string_view key):key_(key),hash_(hashKey(key)){}
+    JsonKey(const JsonKey &other):key_(other.key_),hash_(other.hash_),hint_(other.hint()){}
+    JsonKey &operator=(const JsonKey &other){
+        key_ = other.key_;
+        hash_ = other.hash_;
+        setHint(other.hint());
+        return *this;
+    }
+
+    std::string_view view() const { return key_; }
+    size_t hash() const { return hash_; }
+    operator std::string_view() const { return key_; }
+
+    /* 上次命中的成员下标，只是提示，用前要核对 */
+    uint32_t hint() const { return hint_.load(std::memory_order_relaxed); }
+    void setHint(uint32_t i) const { hint_.store(i, std::memory_order_relaxed); }
+
+private:
+    std::string key_;
+    size_t hash_;
+    mutable std::atomic<uint32_t> hint_{0};
+};
+
+
+/* 保持插入顺序的对象存储：成员连续地放在vector里，需要时另建开放寻址的哈希索引
+   插入可能使迭代器失效；不要通过迭代器修改键 */
+template<typename V>
+class ObjectMap{
+public:
+    using key_type = ObjectKey;
+    using mapped_type = V;
+    using value_type = std::pair<ObjectKey, V>;
+    using Storage = std::vector<value_type>;
+    using iterator = typename Storage::iterator;
+    using const_iterator = typename Storage::const_iterator;
+
+    static constexpr size_t hash_threshold = 16;
+
+    ObjectMap() {}
+    explicit ObjectMap(ObjectIndexPolicy policy):policy_(policy){ rebuild(); }
+
+    ObjectIndexPolicy policy() const { return policy_; }
+    void setPolicy(ObjectIndexPolicy policy){
+        policy_ = policy;
+        rebuild();
+    }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    void reserve(size_t n) { entries_.reserve(n); }
+    void clear(){
+        entries_.clear();
+        slots_.clear();
+        rebuild();
+    }
+
+    iterator begin() { return entries_.begin(); }
+    iterator end() { return entries_.end(); }
+    const_iterator begin() const { return entries_.begin(); }
+    const_iterator end() const { return entries_.end(); }
+
+    iterator find(std::string_view key){
+        size_t i = lookup(key);
+        return i == npos ? end() : begin() + i;
+    }
+    const_iterator find(std::string_view key) const{
+        size_t i = lookup(key);
+        return i == npos ? end() : begin() + i;
+    }
+    iterator find(const JsonKey &key){
+        size_t i = lookup(key);
+        return i == npos ? end() : begin() + i;
+    }
+    const_iterator find(const JsonKey &key) const{
+        size_t i = lookup(key);
+        return i == npos ? end() : begin() + i;
+    }
+    size_t count(std::string_view key) const { return find(key) == end() ? 0 : 1; }
+
+    /* 键不存在时抛出std::out_of_range，同std::map::at */
+    template<typename K>
+    V& at(const K &key){
+        auto it = find(key);
+        if(it == end()){
+            throw std::out_of_range("ObjectMap::at");
+        }
+        return it->second;
+    }
+    template<typename K>
+    const V& at(const K &key) const{
+        auto it = find(key);
+        if(it == end()){
+            throw std::out_of_range("ObjectMap::at");
+        }
+        return it->second;
+    }
+
+    /* 键已存在时不覆盖，返回已有的成员，同std::map::emplace */
+    template<typename K>
+    std::pair<iterator, bool> emplace(K &&key, V val){
+        size_t i;
+        if constexpr (std::is_same_v<std::decay_t<K>, ObjectKey>){
+            i = lookup(key);
+        }
+        else{
+            i = lookup(std::string_view(key));
+        }
+        if(i != npos){
+            return {begin() + i, false};
+        }
+        entries_.emplace_back(std::forward<K>(key), std::move(val));
+        if(indexed()){
+            if(entries_.size() * 2 > slots_.size()){
+                rebuild();
+            }
+            else{
+                place(entries_.size() - 1, entries_.back().first.hash());
+            }
+        }
+        else if(wantIndex()){
+            rebuild();
+        }
+        return {end() - 1, true};
+    }
+    std::pair<iterator, bool> insert(value_type kv){
+        return emplace(std::move(kv.first), std::move(kv.second));
+    }
+
+    /* 删除后其余成员保持原来的顺序 */
+    template<typename K>
+    size_t erase(const K &key){
+        auto it = find(key);
+        if(it == end()){
+            return 0;
+        }
+        size_t i = it - begin();
+        entries_.erase(begin() + i);
+        rebuild();
+        return 1;
+    }
+
+private:
+    static constexpr size_t npos = (size_t)-1;
+
+    /* 哈希索引的槽：pos为成员下标加1，0表示空槽；tag由哈希值折叠而来，先比它再比键 */
+    struct Slot{
+        uint32_t pos = 0;
+        uint32_t tag = 0;
+    };
+
+    static uint32_t tagOf(size_t h) { return (uint32_t)((uint64_t)h >> 32) ^ (uint32_t)h; }
+
+    bool indexed() const { return !slots_.empty(); }
+    bool wantIndex() const {
+        return policy_ == ObjectIndexPolicy::Hash
+            || (policy_ == ObjectIndexPolicy::Auto && entries_.size() > hash_threshold);
+    }
+
+    /* 没有索引时不算哈希 */
+    size_t lookup(std::string_view key) const{
+        return indexed() ? lookup(key, hashKey(key)) : scan(key);
+    }
+
+    size_t scan(std::string_view key) const{
+        // 先比长度和最后一个字节，同前缀的键(field_1、field_2)也能很快排除
+        for(size_t i = 0; i < entries_.size(); ++i){
+            const auto &k = entries_[i].first;
+            if(k.size() == key.size() && (key.empty() || k.back() == key.back()) && k == key){
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    /* 两边都来自同一个池的键只比指针 */
+    size_t lookup(const ObjectKey &key) const{
+        if(!indexed()){
+            for(size_t i = 0; i < entries_.size(); ++i){
+                if(entries_[i].first == key){
+                    return i;
+                }
+            }
+            return npos;
+        }
+        size_t h = key.hash();
+        size_t mask = slots_.size() - 1;
+        uint32_t tag = tagOf(h);
+        for(size_t s = h & mask; ; s = (s + 1) & mask){
+            const Slot &slot = slots_[s];
+            if(slot.pos == 0){
+                return npos;
+            }
+            if(slot.tag == tag && entries_[slot.pos - 1].first == key){
+                return slot.pos - 1;
+            }
+        }
+    }
+
+    size_t lookup(const JsonKey &key) const{
+        size_t i = key.hint();
+        if(i < entries_.size() && entries_[i].first == key.view()){
+            return i;
+        }
+        i = lookup(key.view(), key.hash());
+        if(i != npos){
+            key.setHint((uint32_t)i);
+        }
+        return i;
+    }
+
+    /* h为预先算好的哈希 */
+    size_t lookup(std::string_view key, size_t h) const{
+        if(!indexed()){
+            return scan(key);
+        }
+        size_t mask = slots_.size() - 1;
+        uint32_t tag = tagOf(h);
+        for(size_t s = h & mask; ; s = (s + 1) & mask){
+            const Slot &slot = slots_[s];
+            if(slot.pos == 0){
+                return npos;
+            }
+            if(slot.tag == tag && entries_[slot.pos - 1].first == key){
+                return slot.pos - 1;
+            }
+        }
+    }
+
+    void place(size_t i, size_t h){
+        size_t mask = slots_.size() - 1;
+        size_t s = h & mask;
+        while(slots_[s].pos != 0){
+            s = (s + 1) & mask;
+        }
+        slots_[s].pos = (uint32_t)(i + 1);
+        slots_[s].tag = tagOf(h);
+    }
+
+    /* 按当前成员数重建索引，装载率不超过一半 */
+    void rebuild(){
+        slots_.clear();
+        if(!wantIndex()){
+            return;
+        }
+        size_t cap = 32;
+        while(cap < entries_.size() * 4){
+            cap <<= 1;
+        }
+        slots_.resize(cap);
+        for(size_t i = 0; i < entries_.size(); ++i){
+            place(i, entries_[i].first.hash());
+        }
+    }
+
+private:
+    Storage entries_;
+    std::vector<Slot> slots_;
+    ObjectIndexPolicy policy_ = ObjectIndexPolicy::Auto;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
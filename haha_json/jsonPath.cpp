@@ -0,0 +1,519 @@
+#include "json.h"
+#include <charconv>
+#include <cstring>
+#include <cctype>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* ---------------------------------------------compile--------------------------------------------- */
+
+/* 把路径文本编译成步骤，出错时抛出异常 */
+class JsonPathParser{
+public:
+    using Step = JsonPath::Step;
+    using Kind = JsonPath::Step::Kind;
+    using Op = JsonPath::Op;
+
+    JsonPathParser(std::string_view text, JsonPath &path):text_(text),path_(path){}
+
+    void pointer(){
+        if(text_.empty()){
+            return;
+        }
+        if(text_[0] != '/'){
+            fail("json pointer must start with '/'");
+        }
+        size_t pos = 1;
+        while(true){
+            size_t end = text_.find('/', pos);
+            if(end == std::string_view::npos){
+                end = text_.size();
+            }
+            Step step{Kind::Key};
+            step.key = JsonKey(unescape(text_.substr(pos, end - pos)));
+            step.index = arrayIndex(step.key.view());
+            path_.steps_.push_back(std::move(step));
+            if(end == text_.size()){
+                break;
+            }
+            pos = end + 1;
+        }
+    }
+
+    void jsonpath(){
+        if(text_.empty() || text_[0] != '$'){
+            fail("jsonpath must start with '$'");
+        }
+        pos_ = 1;
+        while(pos_ < text_.size()){
+            char c = text_[pos_];
+            if(c == '.'){
+                ++pos_;
+                if(pos_ < text_.size() && text_[pos_] == '.'){
+                    ++pos_;
+                    path_.steps_.push_back(Step{Kind::Descend});
+                    if(pos_ < text_.size() && text_[pos_] == '['){
+                        continue;
+                    }
+                }
+                std::string_view name = this->name();
+                if(name == "*"){
+                    path_.steps_.push_back(Step{Kind::Wildcard});
+                }
+                else{
+                    Step step{Kind::Key};
+                    step.key = JsonKey(name);
+                    path_.steps_.push_back(std::move(step));
+                }
+            }
+            else if(c == '['){
+                ++pos_;
+                bracket();
+            }
+            else{
+                fail("unexpected character");
+            }
+        }
+    }
+
+private:
+    [[noreturn]] void fail(const char *msg) const{
+        throw HAHA_JSON_ERROR(std::string(msg) + " in path: " + std::string(text_));
+    }
+
+    /* ~1表示'/'，~0表示'~' */
+    std::string unescape(std::string_view token) const{
+        std::string out;
+        for(size_t i = 0; i < token.size(); ++i){
+            if(token[i] != '~'){
+                out.push_back(token[i]);
+                continue;
+            }
+            if(i + 1 >= token.size() || (token[i + 1] != '0' && token[i + 1] != '1')){
+                fail("invalid '~' escape");
+            }
+            out.push_back(token[++i] == '0' ? '~' : '/');
+        }
+        return out;
+    }
+
+    /* JSON Pointer中不带前导0的非负整数可以作为数组下标，否则为-1 */
+    static long arrayIndex(std::string_view token){
+        if(token.empty() || (token.size() > 1 && token[0] == '0')){
+            return -1;
+        }
+        long value = 0;
+        auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+        if(ec != std::errc() || ptr != token.data() + token.size() || value < 0){
+            return -1;
+        }
+        return value;
+    }
+
+    void skipSpace(){
+        while(pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t')){
+            ++pos_;
+        }
+    }
+
+    void expect(char c){
+        skipSpace();
+        if(pos_ >= text_.size() || text_[pos_] != c){
+            fail((std::string("expect '") + c + "'").c_str());
+        }
+        ++pos_;
+    }
+
+    /* .之后的名字，到下一个'.'、'['或']'为止 */
+    std::string_view name(){
+        size_t begin = pos_;
+        while(pos_ < text_.size() && text_[pos_] != '.' && text_[pos_] != '[' && text_[pos_] != ']'){
+            ++pos_;
+        }
+        if(pos_ == begin){
+            fail("expect name");
+        }
+        return text_.substr(begin, pos_ - begin);
+    }
+
+    /* 单引号或双引号括起的名字，'\\'转义下一个字符 */
+    std::string quoted(){
+        char quote = text_[pos_++];
+        std::string out;
+        while(pos_ < text_.size() && text_[pos_] != quote){
+            if(text_[pos_] == '\\' && pos_ + 1 < text_.size()){
+                ++pos_;
+            }
+            out.push_back(text_[pos_++]);
+        }
+        if(pos_ >= text_.size()){
+            fail("unterminated string");
+        }
+        ++pos_;
+        return out;
+    }
+
+    long integer(){
+        size_t begin = pos_;
+        if(pos_ < text_.size() && text_[pos_] == '-'){
+            ++pos_;
+        }
+        while(pos_ < text_.size() && text_[pos_] >= '0' && text_[pos_] <= '9'){
+            ++pos_;
+        }
+        long value = 0;
+        auto [ptr, ec] = std::from_chars(text_.data() + begin, text_.data() + pos_, value);
+        if(ec != std::errc() || ptr != text_.data() + pos_){
+            fail("invalid index");
+        }
+        return value;
+    }
+
+    /* [之后的部分：*、'name'、n、?(...) */
+    void bracket(){
+        skipSpace();
+        if(pos_ >= text_.size()){
+            fail("unterminated '['");
+        }
+        char c = text_[pos_];
+        if(c == '*'){
+            ++pos_;
+            path_.steps_.push_back(Step{Kind::Wildcard});
+        }
+        else if(c == '\'' || c == '"'){
+            Step step{Kind::Key};
+            step.key = JsonKey(quoted());
+            path_.steps_.push_back(std::move(step));
+        }
+        else if(c == '?'){
+            ++pos_;
+            filter();
+        }
+        else{
+            Step step{Kind::Index};
+            step.index = integer();
+            path_.steps_.push_back(std::move(step));
+        }
+        expect(']');
+    }
+
+    /* ?(@.a.b op 字面量)或?(@.a) */
+    void filter(){
+        Step step{Kind::Filter};
+        expect('(');
+        expect('@');
+        while(pos_ < text_.size()){
+            if(text_[pos_] == '.'){
+                ++pos_;
+                size_t begin = pos_;
+                while(pos_ < text_.size() && (isalnum((unsigned char)text_[pos_]) || text_[pos_] == '_' || text_[pos_] == '-' || (unsigned char)text_[pos_] >= 0x80)){
+                    ++pos_;
+                }
+                if(pos_ == begin){
+                    fail("expect name");
+                }
+                step.path.emplace_back(text_.substr(begin, pos_ - begin));
+            }
+            else if(text_[pos_] == '[' && pos_ + 1 < text_.size() && (text_[pos_ + 1] == '\'' || text_[pos_ + 1] == '"')){
+                ++pos_;
+                step.path.emplace_back(quoted());
+                expect(']');
+            }
+            else{
+                break;
+            }
+        }
+        skipSpace();
+        step.op = op();
+        if(step.op != Op::Exists){
+            skipSpace();
+            literal(step.literal);
+            if(step.literal.type == JsonType::Boolean || step.literal.type == JsonType::Null){
+                if(step.op != Op::Eq && step.op != Op::Ne){
+                    fail("only == and != apply to true, false and null");
+                }
+            }
+        }
+        expect(')');
+        path_.steps_.push_back(std::move(step));
+    }
+
+    Op op(){
+        auto rest = text_.substr(pos_);
+        static const std::pair<std::string_view, Op> ops[] = {
+            {"==", Op::Eq}, {"!=", Op::Ne}, {"<=", Op::Le}, {">=", Op::Ge}, {"<", Op::Lt}, {">", Op::Gt},
+        };
+        for(auto &kv : ops){
+            if(rest.substr(0, kv.first.size()) == kv.first){
+                pos_ += kv.first.size();
+                return kv.second;
+            }
+        }
+        return Op::Exists;
+    }
+
+    void literal(JsonPath::Literal &lit){
+        if(pos_ >= text_.size()){
+            fail("expect literal");
+        }
+        char c = text_[pos_];
+        if(c == '\'' || c == '"'){
+            lit.type = JsonType::String;
+            lit.str = quoted();
+            return;
+        }
+        auto rest = text_.substr(pos_);
+        if(rest.substr(0, 4) == "true" || rest.substr(0, 5) == "false"){
+            lit.type = JsonType::Boolean;
+            lit.boolean = c == 't';
+            pos_ += lit.boolean ? 4 : 5;
+            return;
+        }
+        if(rest.substr(0, 4) == "null"){
+            lit.type = JsonType::Null;
+            pos_ += 4;
+            return;
+        }
+        size_t begin = pos_;
+        while(pos_ < text_.size() && strchr("+-.eE0123456789", text_[pos_])){
+            ++pos_;
+        }
+        const char *first = text_.data() + begin, *last = text_.data() + pos_;
+        auto res = std::from_chars(first, last, lit.int_value);
+        lit.integer = res.ec == std::errc() && res.ptr == last;
+        auto [ptr, ec] = std::from_chars(first, last, lit.number);
+        if(first == last || ec != std::errc() || ptr != last){
+            fail("invalid literal");
+        }
+        lit.type = JsonType::Double;
+    }
+
+private:
+    std::string_view text_;
+    JsonPath &path_;
+    size_t pos_ = 0;
+};
+
+
+JsonPath JsonPath::fromPointer(std::string_view pointer){
+    JsonPath path;
+    path.text_ = pointer;
+    JsonPathParser(pointer, path).pointer();
+    return path;
+}
+
+
+JsonPath JsonPath::compile(std::string_view text){
+    JsonPath path;
+    path.text_ = text;
+    JsonPathParser(text, path).jsonpath();
+    if(!path.steps_.empty() && path.steps_.back().kind == Step::Kind::Descend){
+        throw HAHA_JSON_ERROR("'..' must be followed by a selector in path: " + std::string(text));
+    }
+    return path;
+}
+
+/* ---------------------------------------------evaluate--------------------------------------------- */
+
+namespace
+{
+
+/* 数字节点的值：能放进int64的整数给出整数，其余只给double */
+bool number_of(const JsonNode &node, double &d, int64_t &i, bool &integer){
+    switch (node.getType())
+    {
+    case JsonType::Integer:
+        i = static_cast<const JsonInteger&>(node).getValue();
+        integer = true;
+        break;
+    case JsonType::Int64:
+        i = static_cast<const JsonInt64&>(node).getValue();
+        integer = true;
+        break;
+    case JsonType::UInt64:{
+        uint64_t u = static_cast<const JsonUInt64&>(node).getValue();
+        integer = u <= (uint64_t)INT64_MAX;
+        i = (int64_t)u;
+        d = (double)u;
+        return true;
+    }
+    case JsonType::Double:
+        d = static_cast<const JsonDouble&>(node).getValue();
+        integer = false;
+        return true;
+    default:
+        return false;
+    }
+    d = (double)i;
+    return true;
+}
+
+template<typename T>
+int compare(const T &a, const T &b){
+    return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+} // namespace
+
+
+bool JsonPath::test(const JsonNode &node, const Step &step){
+    const JsonNode *cur = &node;
+    for(auto &key : step.path){
+        if(cur->getType() != JsonType::Object){
+            return false;
+        }
+        auto &map = static_cast<const JsonObject*>(cur)->getValue();
+        auto it = map.find(key);
+        if(it == map.end()){
+            return false;
+        }
+        cur = it->second.get();
+    }
+    auto &lit = step.literal;
+    if(step.op == Op::Exists){
+        return true;
+    }
+
+    // 类型不同时只有!=成立
+    bool comparable = false;
+    int cmp = 0;
+    switch (lit.type)
+    {
+    case JsonType::String:
+        if(cur->getType() == JsonType::String){
+            comparable = true;
+            cmp = static_cast<const JsonString*>(cur)->view().compare(lit.str);
+            cmp = cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+        }
+        break;
+    case JsonType::Boolean:
+        if(cur->getType() == JsonType::Boolean){
+            comparable = true;
+            cmp = compare(static_cast<const JsonBoolean*>(cur)->getValue(), lit.boolean);
+        }
+        break;
+    case JsonType::Null:
+        comparable = cur->getType() == JsonType::Null;
+        break;
+    default:{
+        double d = 0;
+        int64_t i = 0;
+        bool integer = false;
+        if(number_of(*cur, d, i, integer)){
+            comparable = true;
+            cmp = integer && lit.integer ? compare(i, lit.int_value) : compare(d, lit.number);
+        }
+        break;
+    }
+    }
+
+    switch (step.op)
+    {
+    case Op::Eq:
+        return comparable && cmp == 0;
+    case Op::Ne:
+        return !comparable || cmp != 0;
+    case Op::Lt:
+        return comparable && cmp < 0;
+    case Op::Le:
+        return comparable && cmp <= 0;
+    case Op::Gt:
+        return comparable && cmp > 0;
+    case Op::Ge:
+        return comparable && cmp >= 0;
+    default:
+        return false;
+    }
+}
+
+
+bool JsonPath::eval(const JsonNode &node, size_t i, Visit visit, void *ctx) const{
+    if(i == steps_.size()){
+        return visit(ctx, node);
+    }
+    const Step &step = steps_[i];
+    JsonType type = node.getType();
+    switch (step.kind)
+    {
+    case Step::Kind::Key:
+        if(type == JsonType::Object){
+            auto &map = static_cast<const JsonObject&>(node).getValue();
+            auto it = map.find(step.key);
+            return it == map.end() || eval(*it->second, i + 1, visit, ctx);
+        }
+        if(type == JsonType::Array && step.index >= 0){
+            auto &list = static_cast<const JsonArray&>(node).getValue();
+            return (size_t)step.index >= list.size() || eval(*list[step.index], i + 1, visit, ctx);
+        }
+        return true;
+    case Step::Kind::Index:{
+        if(type != JsonType::Array){
+            return true;
+        }
+        auto &list = static_cast<const JsonArray&>(node).getValue();
+        long n = (long)list.size();
+        long index = step.index < 0 ? step.index + n : step.index;
+        return index < 0 || index >= n || eval(*list[index], i + 1, visit, ctx);
+    }
+    case Step::Kind::Descend:
+        // 先是自身，再按文档顺序是每个子孙
+        if(!eval(node, i + 1, visit, ctx)){
+            return false;
+        }
+        [[fallthrough]];
+    case Step::Kind::Wildcard:
+    case Step::Kind::Filter:{
+        // 递归下降时子节点还停在这一步
+        size_t next = step.kind == Step::Kind::Descend ? i : i + 1;
+        auto child = [&](const JsonNode &c){
+            if(step.kind == Step::Kind::Filter && !test(c, step)){
+                return true;
+            }
+            return eval(c, next, visit, ctx);
+        };
+        if(type == JsonType::Object){
+            for(auto &kv : static_cast<const JsonObject&>(node).getValue()){
+                if(!child(*kv.second)){
+                    return false;
+                }
+            }
+        }
+        else if(type == JsonType::Array){
+            for(auto &v : static_cast<const JsonArray&>(node).getValue()){
+                if(!child(*v)){
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    }
+    return true;
+}
+
+
+const JsonNode* JsonPath::first(const JsonNode &root) const{
+    const JsonNode *res = nullptr;
+    forEach(root, [&](const JsonNode &node){
+        res = &node;
+        return false;
+    });
+    return res;
+}
+
+
+size_t JsonPath::select(const JsonNode &root, std::vector<const JsonNode*> &out) const{
+    size_t before = out.size();
+    forEach(root, [&](const JsonNode &node){
+        out.push_back(&node);
+    });
+    return out.size() - before;
+}
+
+} // namespace json
+
+} // namespace haha
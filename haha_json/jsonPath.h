@@ -0,0 +1,89 @@
+#ifndef __HAHA_JSON_JSONPATH_H__
+#define __HAHA_JSON_JSONPATH_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <type_traits>
+#include "jsonValue.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 编译好的查询：JSON Pointer或JSONPath的一个子集，编译一次后可以反复用在不同的文档上，多个线程也可以共用
+   求值时不分配内存、不抛异常，结果是指向文档中节点的指针，不持有节点 */
+class JsonPath{
+public:
+    /* RFC 6901：空串表示整个文档；"/a/0"中的0对数组是下标，对对象是键；不合法时抛出异常 */
+    static JsonPath fromPointer(std::string_view pointer);
+    /* $开头，支持.name、['name']、[n](负数从末尾数)、.*、[*]、..(递归下降)
+       以及过滤[?(@.a.b op 字面量)]和[?(@.a)]，op为== != < <= > >=，字面量为数字、'字符串'、true、false、null
+       不合法时抛出异常 */
+    static JsonPath compile(std::string_view path);
+
+    /* 第一个匹配，没有时返回nullptr */
+    const JsonNode* first(const JsonNode &root) const;
+    /* 所有匹配追加到out，返回匹配数；out可以跨查询复用 */
+    size_t select(const JsonNode &root, std::vector<const JsonNode*> &out) const;
+    /* 按文档顺序把匹配依次交给fn(..先给节点自身的匹配，再依次给各个后代的)；fn返回bool时，返回false即停止 */
+    template<typename Fn>
+    void forEach(const JsonNode &root, Fn &&fn) const {
+        using F = std::remove_reference_t<Fn>;
+        eval(root, 0, [](void *ctx, const JsonNode &node){
+            F &f = *static_cast<F*>(ctx);
+            if constexpr (std::is_same_v<decltype(f(node)), bool>){
+                return f(node);
+            }
+            else{
+                f(node);
+                return true;
+            }
+        }, (void*)&fn);
+    }
+
+    const std::string& text() const { return text_; }
+
+private:
+    /* 比较的字面量 */
+    struct Literal{
+        JsonType type = JsonType::UNKOWN;   // UNKOWN表示只检查存在
+        double number = 0;
+        bool integer = false;
+        int64_t int_value = 0;
+        std::string str;
+        bool boolean = false;
+    };
+    enum class Op : uint8_t { Exists, Eq, Ne, Lt, Le, Gt, Ge };
+
+    struct Step{
+        enum class Kind : uint8_t { Key, Index, Wildcard, Descend, Filter };
+        Kind kind;
+        JsonKey key{std::string_view()};
+        long index = -1;            // Index的下标；Key来自JSON Pointer且是数字时也可以作为数组下标
+        std::vector<JsonKey> path;  // Filter中@之后的键
+        Op op = Op::Exists;
+        Literal literal;
+    };
+
+    using Visit = bool (*)(void *ctx, const JsonNode &node);
+
+    /* 从第i步起对node求值，visit返回false时停止并返回false */
+    bool eval(const JsonNode &node, size_t i, Visit visit, void *ctx) const;
+    static bool test(const JsonNode &node, const Step &step);
+
+    friend class JsonPathParser;
+    friend class JsonSnapshot;
+
+private:
+    std::string text_;
+    std::vector<Step> steps_;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
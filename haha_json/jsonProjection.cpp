@@ -0,0 +1,166 @@
+#include "jsonProjection.h"
+#include "jsonError.h"
+#include <map>
+#include <algorithm>
+#include <charconv>
+
+namespace haha
+{
+
+namespace json
+{
+
+Projection::Projection(std::initializer_list<std::string_view> paths){
+    for(auto p : paths){
+        add(p);
+    }
+}
+
+
+void Projection::add(std::string_view pointer){
+    if(!pointer.empty() && pointer[0] != '/'){
+        throw HAHA_JSON_ERROR("json pointer must start with '/': " + std::string(pointer));
+    }
+    uint32_t node = 0;
+    size_t pos = 0;
+    while(pos < pointer.size()){
+        size_t next = pointer.find('/', pos + 1);
+        if(next == std::string_view::npos){
+            next = pointer.size();
+        }
+        auto raw = pointer.substr(pos + 1, next - pos - 1);
+        pos = next;
+
+        uint32_t child = 0;
+        if(raw == "*"){
+            child = trie_[node].star;
+            if(child == 0){
+                child = (uint32_t)trie_.size();
+                trie_.emplace_back();
+                trie_[node].star = child;
+            }
+            node = child;
+            continue;
+        }
+        std::string seg;
+        for(size_t i = 0; i < raw.size(); ++i){
+            if(raw[i] != '~'){
+                seg += raw[i];
+                continue;
+            }
+            if(i + 1 < raw.size() && (raw[i + 1] == '0' || raw[i + 1] == '1')){
+                seg += raw[i + 1] == '0' ? '~' : '/';
+                ++i;
+                continue;
+            }
+            throw HAHA_JSON_ERROR("invalid escape in json pointer: " + std::string(pointer));
+        }
+        for(auto &kv : trie_[node].children){
+            if(kv.first == seg){
+                child = kv.second;
+                break;
+            }
+        }
+        if(child == 0){
+            child = (uint32_t)trie_.size();
+            trie_.emplace_back();
+            trie_[node].children.emplace_back(std::move(seg), child);
+        }
+        node = child;
+    }
+    trie_[node].accept = true;
+    paths_.emplace_back(pointer);
+    compile();
+}
+
+
+/* 子集构造：自动机的每个状态是前缀树上同时所在的一组节点 */
+void Projection::compile(){
+    using NodeSet = std::vector<uint32_t>;
+    std::map<NodeSet, uint32_t> ids;
+    std::vector<NodeSet> sets;
+    states_.assign(1, State());
+
+    auto id_of = [&](NodeSet set){
+        if(set.empty()){
+            return dead;
+        }
+        std::sort(set.begin(), set.end());
+        set.erase(std::unique(set.begin(), set.end()), set.end());
+        auto res = ids.emplace(set, (uint32_t)states_.size());
+        if(res.second){
+            states_.emplace_back();
+            sets.push_back(std::move(set));
+        }
+        return res.first->second;
+    };
+
+    sets.emplace_back();    // dead
+    id_of({0});
+    for(uint32_t id = 1; id < states_.size(); ++id){
+        NodeSet set = sets[id];
+        bool accept = false;
+        NodeSet other;
+        std::map<std::string, NodeSet> keys;
+        for(auto n : set){
+            accept |= trie_[n].accept;
+            if(trie_[n].star){
+                other.push_back(trie_[n].star);
+            }
+            for(auto &kv : trie_[n].children){
+                keys[kv.first].push_back(kv.second);
+            }
+        }
+        if(accept){
+            // 整个子树都保留，之后不必再走
+            states_[id].accept = true;
+            states_[id].other = id;
+            continue;
+        }
+        // 有名字的键也要走'*'那一支
+        std::vector<std::pair<std::string, uint32_t>> trans;
+        for(auto &kv : keys){
+            NodeSet target = kv.second;
+            target.insert(target.end(), other.begin(), other.end());
+            trans.emplace_back(kv.first, id_of(std::move(target)));
+        }
+        uint32_t other_id = id_of(std::move(other));
+        State &st = states_[id];
+        st.other = other_id;
+        for(auto &kv : trans){
+            auto &k = kv.first;
+            bool digits = !k.empty() && std::all_of(k.begin(), k.end(), [](char c){ return c >= '0' && c <= '9'; });
+            st.numeric |= digits && (k.size() == 1 || k[0] != '0');
+        }
+        st.keys = std::move(trans);
+    }
+}
+
+
+uint32_t Projection::step(uint32_t state, std::string_view key) const{
+    const State &st = states_[state];
+    if(!st.keys.empty()){
+        auto it = std::lower_bound(st.keys.begin(), st.keys.end(), key, [](const auto &kv, std::string_view key){
+            return std::string_view(kv.first) < key;
+        });
+        if(it != st.keys.end() && it->first == key){
+            return it->second;
+        }
+    }
+    return st.other;
+}
+
+
+uint32_t Projection::stepIndex(uint32_t state, size_t index) const{
+    const State &st = states_[state];
+    if(!st.numeric){
+        return st.other;
+    }
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), index);
+    return step(state, std::string_view(buf, res.ptr - buf));
+}
+
+} // namespace json
+
+} // namespace haha
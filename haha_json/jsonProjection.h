@@ -0,0 +1,67 @@
+#ifndef __HAHA_JSON_JSONPROJECTION_H__
+#define __HAHA_JSON_JSONPROJECTION_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <initializer_list>
+#include <stdint.h>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 投影：解析时只保留的路径
+   路径用JSON Pointer的写法("/user/id"，~1表示'/'，~0表示'~')，另外'*'这一段匹配数组的任意元素或对象的任意成员
+   每次add后所有路径重新编译成一个确定的自动机，解析时每个键/下标只走一步；编译好的投影可以在多个线程里共用 */
+class Projection{
+public:
+    /* 自动机的状态编号：dead表示这里往下不会再匹配 */
+    static constexpr uint32_t dead = 0;
+
+    /* 没有路径时什么都不保留 */
+    Projection() {}
+    /* 路径不合法时抛出异常 */
+    Projection(std::initializer_list<std::string_view> paths);
+    void add(std::string_view pointer);
+
+    const std::vector<std::string>& paths() const { return paths_; }
+
+    /* 根值的状态 */
+    uint32_t start() const { return 1; }
+    /* 对象的成员、数组的元素各走一步 */
+    uint32_t step(uint32_t state, std::string_view key) const;
+    uint32_t stepIndex(uint32_t state, size_t index) const;
+    /* 整个值都要保留 */
+    bool accepts(uint32_t state) const { return states_[state].accept; }
+
+private:
+    /* 路径前缀树的节点 */
+    struct Node{
+        std::vector<std::pair<std::string, uint32_t>> children;
+        uint32_t star = 0;      // '*'的子节点，0表示没有
+        bool accept = false;
+    };
+    /* 确定自动机的状态，对应前缀树上的一组节点 */
+    struct State{
+        std::vector<std::pair<std::string, uint32_t>> keys;     // 按键排序
+        uint32_t other = dead;  // 不在keys里的键和下标
+        bool accept = false;
+        bool numeric = false;   // keys里有数字，数组下标要按键查
+    };
+
+    void compile();
+
+private:
+    std::vector<std::string> paths_;
+    std::vector<Node> trie_{Node()};
+    std::vector<State> states_{State(), State()};
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
@@ -0,0 +1,353 @@
+#ifndef __HAHA_JSON_JSONPUSH_H__
+#define __HAHA_JSON_JSONPUSH_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "jsonSax.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 分块输入的事件解析：输入一块一块地feed进来，解析状态(容器栈、跨块的字符串/数字/转义)在块之间保留
+   只有被块边界截断的那个词法单元会暂存下来，其余部分就地解析，不会把整块拷贝进缓冲
+   截断的字符串和数字记下已扫描到的位置，下一块从那里接着扫，跨很多块的长字符串也只扫一遍
+   字符串要完整之后才反转义(一遍)，所以跨块的\uXXXX代理对也能正确处理
+   语法与SaxReader一致，事件的string_view只在事件内有效 */
+template<typename Handler>
+class SaxPushParser{
+public:
+    explicit SaxPushParser(Handler &handler):handler_(handler){}
+
+    /* 出错或处理器要求停止后返回false，之后的feed都被忽略 */
+    bool feed(const char *data, size_t len){
+        if(result_ != SaxResult::Ok){
+            return false;
+        }
+        // 上一块剩下的半个词法单元先用这一块的开头补全，每次多取一倍，不必拷贝整块
+        size_t p = 0;
+        size_t step = 64;
+        while(!carry_.empty() && p < len){
+            size_t add = std::min(len - p, step);
+            carry_.append(data + p, add);
+            p += add;
+            step *= 2;
+            size_t n = consume(carry_, false);
+            if(result_ != SaxResult::Ok){
+                return false;
+            }
+            carry_.erase(0, n);
+            // 剩下的都是这一块里的字节了，回到块上接着解析
+            if(carry_.size() <= p){
+                p -= carry_.size();
+                carry_.clear();
+            }
+        }
+        if(carry_.empty() && p < len){
+            size_t n = consume(std::string_view(data + p, len - p), false);
+            if(result_ != SaxResult::Ok){
+                return false;
+            }
+            carry_.assign(data + p + n, len - p - n);
+        }
+        return true;
+    }
+    bool feed(std::string_view chunk){ return feed(chunk.data(), chunk.size()); }
+
+    /* 输入结束：根值完整且其后只有空白时返回Ok */
+    SaxResult finish(){
+        if(result_ == SaxResult::Ok){
+            consume(carry_, true);
+            if(result_ == SaxResult::Ok && state_ != State::Done){
+                result_ = SaxResult::Error;
+            }
+        }
+        carry_.clear();
+        carry_.shrink_to_fit();
+        return result_;
+    }
+
+    SaxResult status() const { return result_; }
+    /* 根值是否已经完整 */
+    bool done() const { return state_ == State::Done; }
+    /* 暂存的未完成词法单元的字节数 */
+    size_t pending() const { return carry_.size(); }
+
+private:
+    /* Value：需要一个值；ValueOrClose：'['或数组中的','之后；KeyOrClose：'{'或对象中的','之后
+       Colon：键之后；CommaOrClose：容器中的值之后；Done：根值已完整 */
+    enum class State : uint8_t { Value, ValueOrClose, KeyOrClose, Colon, CommaOrClose, Done };
+
+    /* 词法单元完整时返回它之后的位置，被块尾截断时返回npos */
+    static constexpr size_t npos = (size_t)-1;
+
+    /* 被截断的字符串或数字已经扫描过的部分；截断的词法单元总在下一次consume的开头，从这里接着扫 */
+    struct Partial{
+        size_t len = 0;             // 从词法单元开头算起已扫描的字节数，0表示没有
+        bool has_escape = false;
+        unsigned char ctrl = 0;
+        unsigned char high = 0;
+    };
+
+    bool fail(){
+        result_ = SaxResult::Error;
+        return false;
+    }
+    bool put(SaxResult res){
+        if(res != SaxResult::Ok){
+            result_ = res;
+            return false;
+        }
+        return true;
+    }
+    bool emit(bool go_on){
+        return put(go_on ? SaxResult::Ok : SaxResult::Stopped);
+    }
+
+    /* 从i开始的词法单元到了输入末尾还没结束：还有输入时等下一块，否则是错误 */
+    size_t truncated(size_t i, bool last){
+        if(last){
+            fail();
+            return i;
+        }
+        return npos;
+    }
+
+    /* 一个值结束后的状态 */
+    void valueDone(){
+        if(stack_.empty()){
+            state_ = State::Done;
+        }
+        else{
+            ++counts_.back();
+            state_ = State::CommaOrClose;
+        }
+    }
+
+    bool open(char c){
+        stack_.push_back(c);
+        counts_.push_back(0);
+        if(c == '{'){
+            state_ = State::KeyOrClose;
+            return emit(handler_.onObjectStart());
+        }
+        state_ = State::ValueOrClose;
+        return emit(handler_.onArrayStart());
+    }
+
+    bool close(char c){
+        char top = stack_.back();
+        if((top == '{' && c != '}') || (top == '[' && c != ']')){
+            return fail();
+        }
+        size_t count = counts_.back();
+        stack_.pop_back();
+        counts_.pop_back();
+        bool go_on = top == '{' ? handler_.onObjectEnd(count) : handler_.onArrayEnd(count);
+        valueDone();
+        return emit(go_on);
+    }
+
+    /* 解析str，返回已消费的字节数，剩下的是被截断的词法单元；last表示后面没有输入了 */
+    size_t consume(std::string_view str, bool last){
+        size_t i = 0;
+        if(first_){
+            // 只有整个输入的开头可能有bom
+            std::string_view bom("\xEF\xBB\xBF");
+            if(str.size() < bom.size() && !last && bom.substr(0, str.size()) == str){
+                return 0;
+            }
+            if(str.substr(0, bom.size()) == bom){
+                i = bom.size();
+            }
+            first_ = false;
+        }
+        while(true){
+            i += util::count_CtrlAndSpace(str.data() + i, str.size() - i);
+            if(i == str.size()){
+                return i;
+            }
+            char c = str[i];
+            size_t next = i + 1;
+            switch (state_)
+            {
+            case State::Done:
+                fail();
+                return i;
+            case State::Colon:
+                if(c != ':'){
+                    fail();
+                    return i;
+                }
+                state_ = State::Value;
+                break;
+            case State::CommaOrClose:
+                if(c == ','){
+                    state_ = stack_.back() == '{' ? State::KeyOrClose : State::ValueOrClose;
+                }
+                else if(!close(c)){
+                    return i;
+                }
+                break;
+            case State::KeyOrClose:
+                if(c == '}'){
+                    if(!close(c))return i;
+                }
+                else if(c == '"'){
+                    next = string(str, i, last, true);
+                    if(next == npos || result_ != SaxResult::Ok)return i;
+                    state_ = State::Colon;
+                }
+                else{
+                    fail();
+                    return i;
+                }
+                break;
+            case State::ValueOrClose:
+                if(c == ']'){
+                    if(!close(c))return i;
+                    break;
+                }
+                [[fallthrough]];
+            case State::Value:
+                next = value(str, i, last);
+                if(next == npos || result_ != SaxResult::Ok)return i;
+                break;
+            }
+            if(result_ != SaxResult::Ok){
+                return i;
+            }
+            i = next;
+        }
+    }
+
+    size_t value(std::string_view str, size_t i, bool last){
+        switch (str[i])
+        {
+        case '{':
+        case '[':
+            open(str[i]);
+            return i + 1;
+        case '"':
+            return string(str, i, last, false);
+        case 'n':
+            return keyword(str, i, last, "null");
+        case 't':
+            return keyword(str, i, last, "true");
+        case 'f':
+            return keyword(str, i, last, "false");
+        default:
+            return number(str, i, last);
+        }
+    }
+
+    size_t keyword(std::string_view str, size_t i, bool last, std::string_view word){
+        auto rest = str.substr(i, word.size());
+        if(rest != word.substr(0, rest.size())){
+            fail();
+            return i;
+        }
+        if(rest.size() < word.size()){
+            return truncated(i, last);
+        }
+        bool go_on = word[0] == 'n' ? handler_.onNull() : handler_.onBool(word[0] == 't');
+        valueDone();
+        emit(go_on);
+        return i + word.size();
+    }
+
+    size_t number(std::string_view str, size_t i, bool last){
+        size_t j = i + std::exchange(partial_, Partial()).len;
+        while(j < str.size() && (util::isNumberComponent(str[j]) || str[j] == '+')){
+            ++j;
+        }
+        // 数字可能在下一块里继续
+        if(j == str.size() && !last){
+            partial_.len = j - i;
+            return npos;
+        }
+        NumberToken tok;
+        auto raw = str.substr(i, j - i);
+        if(!scan_number(raw, tok) || tok.len != raw.size()){
+            fail();
+            return i;
+        }
+        valueDone();
+        put(sax_number(handler_, raw, tok));
+        return j;
+    }
+
+    size_t string(std::string_view str, size_t i, bool last, bool is_key){
+        // 先找到结束引号，转义符连同它后面的一个字符一起跳过
+        Partial from = std::exchange(partial_, Partial());
+        size_t j = i + std::max<size_t>(from.len, 1);
+        bool has_escape = from.has_escape;
+        unsigned char ctrl = from.ctrl, high = from.high;
+        while(true){
+            while(j < str.size() && str[j] != '"' && str[j] != '\\'){
+                unsigned char c = str[j];
+                ctrl |= c < 0x20;
+                high |= c;
+                ++j;
+            }
+            if(j == str.size() || (str[j] == '\\' && j + 1 == str.size())){
+                // 停在转义符上时，下一块从转义符重新开始
+                partial_ = {j - i, has_escape, ctrl, high};
+                return truncated(i, last);
+            }
+            if(str[j] == '"'){
+                break;
+            }
+            has_escape = true;
+            j += 2;
+        }
+
+        std::string_view value = str.substr(i + 1, j - i - 1);
+        const char *escaped = nullptr;
+        EscapeHint hint = EscapeHint::Unknown;
+        if(has_escape){
+            escaped = value.data();
+            auto rest = str.substr(i + 1);
+            scratch_.clear();
+            if(!parse_escaped(rest, scratch_)){
+                fail();
+                return i;
+            }
+            value = scratch_;
+        }
+        else if(!ctrl){
+            hint = (high & 0x80) ? EscapeHint::Clean : EscapeHint::CleanAscii;
+        }
+
+        if(is_key){
+            emit(handler_.onKey(value));
+        }
+        else{
+            valueDone();
+            put(sax_string(handler_, value, escaped, hint));
+        }
+        return j + 1;
+    }
+
+private:
+    Handler &handler_;
+    State state_ = State::Value;
+    SaxResult result_ = SaxResult::Ok;
+    bool first_ = true;
+    std::string stack_;             // 未结束的容器，'{'或'['
+    std::vector<size_t> counts_;    // 各层已有的成员数
+    std::string carry_;             // 上一块末尾被截断的词法单元
+    Partial partial_;               // carry_开头那个词法单元已扫描的部分
+    std::string scratch_;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
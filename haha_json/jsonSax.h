@@ -0,0 +1,393 @@
+#ifndef __HAHA_JSON_JSONSAX_H__
+#define __HAHA_JSON_JSONSAX_H__
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <stdint.h>
+#include "jsonValue.h"
+#include "jsonUtil.h"
+#include "jsonIndex.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+/* ---------------------------------------------词法，各个解析器共用--------------------------------------------- */
+
+/* 扫描出的数字：len为在输入中的长度，整数时magnitude为绝对值，overflow表示超出uint64 */
+struct NumberToken{
+    size_t len = 0;
+    bool negative = false;
+    bool integer = true;
+    bool overflow = false;
+    uint64_t magnitude = 0;
+};
+
+/* 严格按json语法扫描数字：-?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+   不分配内存，整数部分顺带累加出数值 */
+bool scan_number(std::string_view str, NumberToken &tok);
+
+/* 整数按范围依次选int、int64、uint64，都放不下或者带小数、指数的用double */
+JsonType number_type(const NumberToken &tok);
+
+/* 处理从转义符开始的剩余部分，结果追加到output，成功时str停在结束引号之后 */
+bool parse_escaped(std::string_view &str, std::string &output);
+
+/* ---------------------------------------------事件解析--------------------------------------------- */
+
+/* Ok：解析完成；Stopped：处理器的某个事件返回了false；Error：语法错误 */
+enum class SaxResult : uint8_t { Ok, Stopped, Error };
+
+
+/* 事件处理器的默认实现，什么都不做；使用者继承它，只写关心的事件
+   事件返回false时解析立即停止。事件里的string_view只在事件内有效
+   处理器还可以提供下面两个事件，提供了就不再调用对应的普通事件：
+     bool onRawNumber(std::string_view raw, const NumberToken &tok)   数字的原文，代替onInt/onInt64/onUInt64/onDouble
+     bool onRawString(std::string_view value, const char *escaped, EscapeHint hint)
+         代替onString；含转义时escaped为输入中内容的起始位置，value为反转义后的结果，否则escaped为nullptr
+   SaxReader还会在每个数组和对象开始前询问处理器是否要整个接管它：
+     bool takeContainer(std::string_view &str, bool &ok)
+         返回true时处理器已经处理了str开头的容器，并把str移到容器之后，出错时ok置为false
+   以及在每个值之前询问是否跳过它，跳过的值不产生事件，也不检查语法：
+     bool skipValue(char first)     first为值的第一个字符 */
+struct SaxHandler{
+    bool onNull() { return true; }
+    bool onBool(bool) { return true; }
+    bool onInt(int) { return true; }
+    bool onInt64(int64_t) { return true; }
+    bool onUInt64(uint64_t) { return true; }
+    bool onDouble(double) { return true; }
+    bool onString(std::string_view) { return true; }
+    bool onKey(std::string_view) { return true; }
+    bool onObjectStart() { return true; }
+    /* count为成员个数 */
+    bool onObjectEnd(size_t) { return true; }
+    bool onArrayStart() { return true; }
+    /* count为元素个数 */
+    bool onArrayEnd(size_t) { return true; }
+};
+
+
+/* 把扫描出的数字交给处理器：有onRawNumber时给原文，否则按类型转换 */
+template<typename Handler>
+SaxResult sax_number(Handler &handler, std::string_view raw, const NumberToken &tok){
+    auto go_on = [](bool b){ return b ? SaxResult::Ok : SaxResult::Stopped; };
+    if constexpr (requires { handler.onRawNumber(raw, tok); }){
+        return go_on(handler.onRawNumber(raw, tok));
+    }
+    else{
+        uint64_t m = tok.magnitude;
+        switch (number_type(tok))
+        {
+        case JsonType::Integer:
+            return go_on(handler.onInt(tok.negative ? (int)(0 - m) : (int)m));
+        case JsonType::Int64:
+            return go_on(handler.onInt64(tok.negative ? (int64_t)(0 - m) : (int64_t)m));
+        case JsonType::UInt64:
+            return go_on(handler.onUInt64(m));
+        default:
+            break;
+        }
+        double d = 0;
+        auto [ptr, ec] = std::from_chars(raw.data(), raw.data() + raw.size(), d);
+        if(ec != std::errc() || ptr != raw.data() + raw.size()){
+            // 超出double范围
+            return SaxResult::Error;
+        }
+        return go_on(handler.onDouble(d));
+    }
+}
+
+
+/* 把字符串交给处理器：有onRawString时连同转义信息一起给，否则调用onString */
+template<typename Handler>
+SaxResult sax_string(Handler &handler, std::string_view value, const char *escaped, EscapeHint hint){
+    bool go_on;
+    if constexpr (requires { handler.onRawString(value, escaped, hint); }){
+        go_on = handler.onRawString(value, escaped, hint);
+    }
+    else{
+        go_on = handler.onString(value);
+    }
+    return go_on ? SaxResult::Ok : SaxResult::Stopped;
+}
+
+
+/* 语法与parse_value一致(包括容器末尾可以多一个逗号)，事件通过模板直接调用处理器，没有虚函数 */
+template<typename Handler>
+class SaxReader{
+public:
+    SaxReader(Handler &handler):handler_(handler){}
+
+    /* 解析str开头的一个值，成功时str停在值之后 */
+    SaxResult parseValue(std::string_view &str){
+        str_ = str;
+        result_ = SaxResult::Ok;
+        value();
+        if(result_ == SaxResult::Ok){
+            str = str_;
+        }
+        return result_;
+    }
+
+    /* 解析容器内部的一段：逗号分隔的若干元素(members为true时是键值对)，不含括号，之后只能是空白
+       用于把一个大容器切成几段分别解析。last为false时不能为空，末尾也不能有多余的逗号 */
+    SaxResult parseSequence(std::string_view str, bool members, bool last){
+        str_ = str;
+        result_ = SaxResult::Ok;
+        sequence(members, last);
+        return result_;
+    }
+
+    /* 解析整个输入：可以有utf8 bom，值前后只能是空白 */
+    SaxResult parse(std::string_view str){
+        str = util::skip_CtrlAndSpace(util::skip_utf8_bom(str));
+        auto res = parseValue(str);
+        if(res == SaxResult::Ok && !util::skip_CtrlAndSpace(str).empty()){
+            return SaxResult::Error;
+        }
+        return res;
+    }
+
+private:
+    bool fail(){
+        result_ = SaxResult::Error;
+        return false;
+    }
+    bool emit(bool go_on){
+        if(!go_on){
+            result_ = SaxResult::Stopped;
+        }
+        return go_on;
+    }
+    bool put(SaxResult res){
+        if(res != SaxResult::Ok){
+            result_ = res;
+            return false;
+        }
+        return true;
+    }
+    void skip(){
+        str_ = util::skip_CtrlAndSpace(str_);
+    }
+
+    bool value(){
+        if(str_.empty())return fail();
+        if constexpr (requires { handler_.skipValue(str_[0]); }){
+            if(handler_.skipValue(str_[0])){
+                size_t end = skip_value(str_, 0);
+                if(end == skip_npos || end == 0){
+                    return fail();
+                }
+                str_.remove_prefix(end);
+                return true;
+            }
+        }
+        switch (str_[0])
+        {
+        case '{':
+        case '[':
+            if constexpr (requires(std::string_view &s, bool &ok) { handler_.takeContainer(s, ok); }){
+                bool ok = true;
+                if(handler_.takeContainer(str_, ok)){
+                    return ok || fail();
+                }
+            }
+            return str_[0] == '{' ? object() : array();
+        case '"':
+            return string();
+        case 'n':
+            return keyword("null") && emit(handler_.onNull());
+        case 't':
+            return keyword("true") && emit(handler_.onBool(true));
+        case 'f':
+            return keyword("false") && emit(handler_.onBool(false));
+        default:
+            return number();
+        }
+    }
+
+    bool keyword(std::string_view word){
+        if(str_.compare(0, word.size(), word) != 0){
+            return fail();
+        }
+        str_.remove_prefix(word.size());
+        return true;
+    }
+
+    bool number(){
+        NumberToken tok;
+        if(!scan_number(str_, tok)){
+            return fail();
+        }
+        auto raw = str_.substr(0, tok.len);
+        str_.remove_prefix(tok.len);
+        return put(sax_number(handler_, raw, tok));
+    }
+
+    /* 引号之间的内容：没有转义时value直接指向输入，否则反转义到scratch_，escaped为内容在输入中的起始位置 */
+    bool quoted(std::string_view &value, const char *&escaped, EscapeHint &hint){
+        str_.remove_prefix(1);
+        // 先找结束引号或第一个转义符，顺便记下有没有控制字符和非ascii字节，序列化时用
+        size_t n = 0;
+        unsigned char ctrl = 0, high = 0;
+        while(n < str_.size() && str_[n] != '"' && str_[n] != '\\'){
+            unsigned char c = str_[n];
+            ctrl |= c < 0x20;
+            high |= c;
+            ++n;
+        }
+        if(n == str_.size())return fail();
+
+        if(str_[n] == '"'){
+            value = str_.substr(0, n);
+            escaped = nullptr;
+            hint = ctrl ? EscapeHint::Unknown
+                 : (high & 0x80) ? EscapeHint::Clean : EscapeHint::CleanAscii;
+            str_.remove_prefix(n + 1);
+            return true;
+        }
+        escaped = str_.data();
+        hint = EscapeHint::Unknown;
+        scratch_.assign(str_.data(), n);
+        str_.remove_prefix(n);
+        if(!parse_escaped(str_, scratch_)){
+            return fail();
+        }
+        value = scratch_;
+        return true;
+    }
+
+    bool string(){
+        std::string_view value;
+        const char *escaped;
+        EscapeHint hint;
+        if(!quoted(value, escaped, hint)){
+            return false;
+        }
+        return put(sax_string(handler_, value, escaped, hint));
+    }
+
+    bool key(){
+        if(str_.empty() || str_[0] != '"'){
+            return fail();
+        }
+        std::string_view value;
+        const char *escaped;
+        EscapeHint hint;
+        return quoted(value, escaped, hint) && emit(handler_.onKey(value));
+    }
+
+    /* 逗号之后紧跟(可隔着空白)结束符时也算结束 */
+    bool separator(char close, bool &done){
+        skip();
+        if(str_.empty())return fail();
+        if(str_[0] == close){
+            str_.remove_prefix(1);
+            done = true;
+            return true;
+        }
+        if(str_[0] != ',')return fail();
+        str_.remove_prefix(1);
+        skip();
+        if(!str_.empty() && str_[0] == close){
+            str_.remove_prefix(1);
+            done = true;
+        }
+        return true;
+    }
+
+    bool array(){
+        str_.remove_prefix(1);
+        if(!emit(handler_.onArrayStart()))return false;
+        size_t count = 0;
+        skip();
+        bool done = !str_.empty() && str_[0] == ']';
+        if(done){
+            str_.remove_prefix(1);
+        }
+        while(!done){
+            if(!value() || !separator(']', done)){
+                return false;
+            }
+            ++count;
+        }
+        return emit(handler_.onArrayEnd(count));
+    }
+
+    bool object(){
+        str_.remove_prefix(1);
+        if(!emit(handler_.onObjectStart()))return false;
+        size_t count = 0;
+        skip();
+        bool done = !str_.empty() && str_[0] == '}';
+        if(done){
+            str_.remove_prefix(1);
+        }
+        while(!done){
+            if(!key())return false;
+            skip();
+            if(str_.empty() || str_[0] != ':'){
+                return fail();
+            }
+            str_.remove_prefix(1);
+            skip();
+            if(!value() || !separator('}', done)){
+                return false;
+            }
+            ++count;
+        }
+        return emit(handler_.onObjectEnd(count));
+    }
+
+    bool sequence(bool members, bool last){
+        skip();
+        if(str_.empty()){
+            return last || fail();
+        }
+        while(true){
+            if(members){
+                if(!key())return false;
+                skip();
+                if(str_.empty() || str_[0] != ':'){
+                    return fail();
+                }
+                str_.remove_prefix(1);
+                skip();
+            }
+            if(!value())return false;
+            skip();
+            if(str_.empty()){
+                return true;
+            }
+            if(str_[0] != ',')return fail();
+            str_.remove_prefix(1);
+            skip();
+            if(str_.empty()){
+                return last || fail();
+            }
+        }
+    }
+
+private:
+    Handler &handler_;
+    std::string_view str_;
+    std::string scratch_;
+    SaxResult result_ = SaxResult::Ok;
+};
+
+
+/* 按事件解析整个输入，不构建树 */
+template<typename Handler>
+SaxResult parse_sax(std::string_view str, Handler &handler){
+    return SaxReader<Handler>(handler).parse(str);
+}
+
+} // namespace json
+
+} // namespace haha
+
+#endif
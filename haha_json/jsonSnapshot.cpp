@@ -0,0 +1,231 @@
+#include "json.h"
+#include <unordered_set>
+
+namespace haha
+{
+
+namespace json
+{
+
+namespace
+{
+
+/* 浅拷贝：容器只拷贝成员指针，子树仍然共享 */
+JsonNode::ptr shallow_copy(const JsonNode &src){
+    switch (src.getType())
+    {
+    case JsonType::Array:{
+        auto arr = std::make_shared<JsonArray>();
+        arr->getValue() = static_cast<const JsonArray&>(src).getValue();
+        return arr;
+    }
+    case JsonType::Object:{
+        auto obj = std::make_shared<JsonObject>();
+        obj->getValue() = static_cast<const JsonObject&>(src).getValue();
+        return obj;
+    }
+    #define CASE(name) \
+        case JsonType::name: \
+            return std::make_shared<Json##name>(static_cast<const Json##name&>(src));
+
+    CASE(String);
+    CASE(Integer);
+    CASE(Int64);
+    CASE(UInt64);
+    CASE(Double);
+    CASE(Boolean);
+    CASE(Null);
+    #undef CASE
+    default:
+        break;
+    }
+    throw HAHA_JSON_ERROR("unknown node type");
+}
+
+
+/* 子树的节点数 */
+size_t count_nodes(const JsonNode &node){
+    size_t n = 1;
+    if(node.getType() == JsonType::Object){
+        for(auto &kv : static_cast<const JsonObject&>(node).getValue()){
+            n += count_nodes(*kv.second);
+        }
+    }
+    else if(node.getType() == JsonType::Array){
+        for(auto &v : static_cast<const JsonArray&>(node).getValue()){
+            n += count_nodes(*v);
+        }
+    }
+    return n;
+}
+
+
+void collect_nodes(const JsonNode &node, std::unordered_set<const JsonNode*> &out){
+    out.insert(&node);
+    if(node.getType() == JsonType::Object){
+        for(auto &kv : static_cast<const JsonObject&>(node).getValue()){
+            collect_nodes(*kv.second, out);
+        }
+    }
+    else if(node.getType() == JsonType::Array){
+        for(auto &v : static_cast<const JsonArray&>(node).getValue()){
+            collect_nodes(*v, out);
+        }
+    }
+}
+
+
+/* 共享的节点整棵子树都是共享的，不必再往下找 */
+size_t count_shared(const JsonNode &node, const std::unordered_set<const JsonNode*> &other){
+    if(other.count(&node)){
+        return count_nodes(node);
+    }
+    size_t n = 0;
+    if(node.getType() == JsonType::Object){
+        for(auto &kv : static_cast<const JsonObject&>(node).getValue()){
+            n += count_shared(*kv.second, other);
+        }
+    }
+    else if(node.getType() == JsonType::Array){
+        for(auto &v : static_cast<const JsonArray&>(node).getValue()){
+            n += count_shared(*v, other);
+        }
+    }
+    return n;
+}
+
+} // namespace
+
+
+JsonNode& JsonSnapshot::own(JsonNode::ptr &slot){
+    // 只有这里引用着它时可以直接改，否则(或是只读的)先换成自己的一份
+    if(slot.use_count() != 1 || slot->readOnly()){
+        slot = shallow_copy(*slot);
+    }
+    return *slot;
+}
+
+
+JsonNode::ptr* JsonSnapshot::walk(const JsonPath &pointer, size_t n){
+    if(root_ == nullptr){
+        return nullptr;
+    }
+    JsonNode::ptr *slot = &root_;
+    for(size_t i = 0; i < n; ++i){
+        auto &step = pointer.steps_[i];
+        if(step.kind != JsonPath::Step::Kind::Key && step.kind != JsonPath::Step::Kind::Index){
+            throw HAHA_JSON_ERROR("snapshot only accepts json pointers: " + pointer.text());
+        }
+        JsonNode &node = own(*slot);
+        if(node.getType() == JsonType::Object && step.kind == JsonPath::Step::Kind::Key){
+            auto &map = static_cast<JsonObject&>(node).getValue();
+            auto it = map.find(step.key);
+            if(it == map.end()){
+                return nullptr;
+            }
+            slot = &it->second;
+        }
+        else if(node.getType() == JsonType::Array && step.index >= 0){
+            auto &list = static_cast<JsonArray&>(node).getValue();
+            if((size_t)step.index >= list.size()){
+                return nullptr;
+            }
+            slot = &list[step.index];
+        }
+        else{
+            return nullptr;
+        }
+    }
+    own(*slot);
+    return slot;
+}
+
+
+void JsonSnapshot::set(const JsonPath &pointer, JsonNode::ptr value){
+    auto &steps = pointer.steps_;
+    if(steps.empty()){
+        root_ = std::move(value);
+        return;
+    }
+    JsonNode::ptr *parent = walk(pointer, steps.size() - 1);
+    if(parent == nullptr){
+        throw HAHA_JSON_ERROR("parent not found: " + pointer.text());
+    }
+    auto &step = steps.back();
+    JsonNode &node = **parent;
+    if(node.getType() == JsonType::Object && step.kind == JsonPath::Step::Kind::Key){
+        auto &map = static_cast<JsonObject&>(node).getValue();
+        auto it = map.find(step.key);
+        if(it != map.end()){
+            it->second = std::move(value);
+        }
+        else{
+            map.emplace(step.key.view(), std::move(value));
+        }
+        return;
+    }
+    if(node.getType() == JsonType::Array){
+        auto &list = static_cast<JsonArray&>(node).getValue();
+        if(step.kind == JsonPath::Step::Kind::Key && step.key.view() == "-"){
+            list.emplace_back(std::move(value));
+            return;
+        }
+        if(step.index >= 0 && (size_t)step.index < list.size()){
+            list[step.index] = std::move(value);
+            return;
+        }
+        if(step.index >= 0 && (size_t)step.index == list.size()){
+            list.emplace_back(std::move(value));
+            return;
+        }
+        throw HAHA_JSON_ERROR("array index out of range: " + pointer.text());
+    }
+    throw HAHA_JSON_ERROR("parent is not a container: " + pointer.text());
+}
+
+
+bool JsonSnapshot::erase(const JsonPath &pointer){
+    auto &steps = pointer.steps_;
+    // 先只读地确认存在，不存在时不复制路径
+    if(steps.empty() || get(pointer) == nullptr){
+        return false;
+    }
+    JsonNode::ptr *parent = walk(pointer, steps.size() - 1);
+    if(parent == nullptr){
+        return false;
+    }
+    JsonNode &node = **parent;
+    auto &step = steps.back();
+    if(node.getType() == JsonType::Object){
+        return static_cast<JsonObject&>(node).getValue().erase(step.key) != 0;
+    }
+    auto &list = static_cast<JsonArray&>(node).getValue();
+    if(step.index < 0 || (size_t)step.index >= list.size()){
+        return false;
+    }
+    list.erase(list.begin() + step.index);
+    return true;
+}
+
+
+JsonNode& JsonSnapshot::edit(const JsonPath &pointer){
+    JsonNode::ptr *slot = walk(pointer, pointer.steps_.size());
+    if(slot == nullptr){
+        throw HAHA_JSON_ERROR("node not found: " + pointer.text());
+    }
+    return **slot;
+}
+
+
+size_t JsonSnapshot::sharedWith(const JsonSnapshot &other) const{
+    if(root_ == nullptr || other.root_ == nullptr){
+        return 0;
+    }
+    std::unordered_set<const JsonNode*> nodes;
+    collect_nodes(*other.root_, nodes);
+    return count_shared(*root_, nodes);
+}
+
+} // namespace json
+
+} // namespace haha
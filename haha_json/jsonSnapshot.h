@@ -0,0 +1,61 @@
+#ifndef __HAHA_JSON_JSONSNAPSHOT_H__
+#define __HAHA_JSON_JSONSNAPSHOT_H__
+
+#include <memory>
+#include <string_view>
+#include "jsonValue.h"
+#include "jsonPath.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 写时复制的文档版本：拷贝只是共享根节点，O(1)
+   修改时只复制从根到被改节点这条路径上的节点(容器只浅拷贝成员指针)，其余子树仍在各个版本之间共享
+   节点是否被别的版本共享看shared_ptr的引用计数；一个版本同一时间只在一个线程里用，不同版本可以在不同线程里
+   交给版本的树(包括set进来的值)之后不要再从外面直接修改 */
+class JsonSnapshot{
+public:
+    JsonSnapshot() {}
+    explicit JsonSnapshot(JsonNode::ptr root):root_(std::move(root)){}
+
+    /* 只读访问，不要通过const_cast修改 */
+    std::shared_ptr<const JsonNode> root() const { return root_; }
+    /* 没有匹配时返回nullptr */
+    const JsonNode* get(const JsonPath &path) const { return root_ ? path.first(*root_) : nullptr; }
+    const JsonNode* get(std::string_view pointer) const { return get(JsonPath::fromPointer(pointer)); }
+
+    /* 路径是JSON Pointer：对象中替换或新增成员；数组中替换元素，下标等于长度或为"-"时追加
+       上一级不存在或不是容器时抛出异常 */
+    void set(const JsonPath &pointer, JsonNode::ptr value);
+    void set(std::string_view pointer, JsonNode::ptr value) { set(JsonPath::fromPointer(pointer), std::move(value)); }
+    /* 删除成员或元素，不存在时返回false */
+    bool erase(const JsonPath &pointer);
+    bool erase(std::string_view pointer) { return erase(JsonPath::fromPointer(pointer)); }
+    /* 就地修改：复制路径后返回这个版本独占的节点，不存在时抛出异常
+       容器只是浅拷贝，它的成员仍然共享，要改更深的节点请用更长的路径 */
+    JsonNode& edit(const JsonPath &pointer);
+    JsonNode& edit(std::string_view pointer) { return edit(JsonPath::fromPointer(pointer)); }
+    template<typename T>
+    T& edit(std::string_view pointer) { return static_cast<T&>(edit(pointer)); }
+
+    /* 与other共享的节点数，可以用来看两个版本之间省下了多少拷贝 */
+    size_t sharedWith(const JsonSnapshot &other) const;
+
+private:
+    /* 让slot指向的节点只属于这个版本，必要时浅拷贝一份 */
+    static JsonNode& own(JsonNode::ptr &slot);
+    /* 复制从根到第n步的路径，返回第n步所在的节点，不存在时返回nullptr */
+    JsonNode::ptr* walk(const JsonPath &pointer, size_t n);
+
+private:
+    JsonNode::ptr root_;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
@@ -0,0 +1,474 @@
+#include "json.h"
+#include <string.h>
+#include <charconv>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* ---------------------------------------------build--------------------------------------------- */
+
+/* 递归下降地把文本写成tape，语法与parse_value一致(包括容器末尾可以多一个逗号) */
+class TapeBuilder{
+public:
+    TapeBuilder(JsonTape &tape):tape_(tape.tape_),strings_(tape.strings_){}
+
+    bool build(std::string_view str){
+        str_ = util::skip_CtrlAndSpace(str);
+        if(!value()){
+            return false;
+        }
+        // 根值之后只能是空白
+        return util::skip_CtrlAndSpace(str_).empty();
+    }
+
+private:
+    void push(TapeTag tag, uint64_t payload){
+        tape_.push_back(((uint64_t)tag << JsonTape::tag_shift) | (payload & JsonTape::payload_mask));
+    }
+
+    bool value(){
+        if(str_.empty())return false;
+        switch (str_[0])
+        {
+        case '{':
+            return object();
+        case '[':
+            return array();
+        case '"':
+            return string();
+        case 'n':
+            return keyword("null", TapeTag::Null);
+        case 't':
+            return keyword("true", TapeTag::True);
+        case 'f':
+            return keyword("false", TapeTag::False);
+        default:
+            return number();
+        }
+    }
+
+    bool keyword(std::string_view word, TapeTag tag){
+        if(str_.compare(0, word.size(), word) != 0){
+            return false;
+        }
+        str_.remove_prefix(word.size());
+        push(tag, 0);
+        return true;
+    }
+
+    bool number(){
+        NumberToken tok;
+        if(!scan_number(str_, tok)){
+            return false;
+        }
+        uint64_t m = tok.magnitude;
+        switch (number_type(tok))
+        {
+        case JsonType::Integer:
+            push(TapeTag::Integer, (uint32_t)(tok.negative ? (int)(0 - m) : (int)m));
+            break;
+        case JsonType::Int64:
+            push(TapeTag::Int64, 0);
+            tape_.push_back(tok.negative ? 0 - m : m);
+            break;
+        case JsonType::UInt64:
+            push(TapeTag::UInt64, 0);
+            tape_.push_back(m);
+            break;
+        default:
+            {
+                double d = 0;
+                auto [ptr, ec] = std::from_chars(str_.data(), str_.data() + tok.len, d);
+                if(ec != std::errc() || ptr != str_.data() + tok.len){
+                    return false;
+                }
+                uint64_t bits;
+                memcpy(&bits, &d, sizeof(bits));
+                push(TapeTag::Double, 0);
+                tape_.push_back(bits);
+            }
+            break;
+        }
+        str_.remove_prefix(tok.len);
+        return true;
+    }
+
+    bool string(){
+        str_.remove_prefix(1);
+        size_t n = 0;
+        while(n < str_.size() && str_[n] != '"' && str_[n] != '\\'){
+            ++n;
+        }
+        if(n == str_.size())return false;
+
+        std::string_view content;
+        if(str_[n] == '"'){
+            content = str_.substr(0, n);
+            str_.remove_prefix(n + 1);
+        }
+        else{
+            scratch_.assign(str_.data(), n);
+            str_.remove_prefix(n);
+            if(!parse_escaped(str_, scratch_)){
+                return false;
+            }
+            content = scratch_;
+        }
+
+        if(content.size() > JsonTape::max_string_length){
+            return false;
+        }
+        push(TapeTag::String, strings_.size());
+        uint32_t len = (uint32_t)content.size();
+        strings_.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        strings_.append(content);
+        return true;
+    }
+
+    /* 开始字先占位，结束时回填结束位置和元素个数；结束位置放不进32位时失败 */
+    bool close(size_t start, TapeTag end_tag, uint64_t count){
+        push(end_tag, start);
+        uint64_t next = tape_.size();
+        if(next > JsonTape::max_words){
+            return false;
+        }
+        tape_[start] |= next | (std::min(count, JsonTape::max_count) << 32);
+        return true;
+    }
+
+    bool array(){
+        str_.remove_prefix(1);
+        size_t start = tape_.size();
+        push(TapeTag::ArrayStart, 0);
+        uint64_t count = 0;
+
+        str_ = util::skip_CtrlAndSpace(str_);
+        while(!str_.empty() && str_[0] != ']'){
+            if(!value()){
+                return false;
+            }
+            ++count;
+            str_ = util::skip_CtrlAndSpace(str_);
+            if(!str_.empty() && str_[0] == ','){
+                str_.remove_prefix(1);
+                str_ = util::skip_CtrlAndSpace(str_);
+            }
+            else if(str_.empty() || str_[0] != ']'){
+                return false;
+            }
+        }
+        if(str_.empty())return false;
+        str_.remove_prefix(1);
+        return close(start, TapeTag::ArrayEnd, count);
+    }
+
+    bool object(){
+        str_.remove_prefix(1);
+        size_t start = tape_.size();
+        push(TapeTag::ObjectStart, 0);
+        uint64_t count = 0;
+
+        str_ = util::skip_CtrlAndSpace(str_);
+        while(!str_.empty() && str_[0] != '}'){
+            if(str_[0] != '"' || !string()){
+                return false;
+            }
+            str_ = util::skip_CtrlAndSpace(str_);
+            if(str_.empty() || str_[0] != ':'){
+                return false;
+            }
+            str_.remove_prefix(1);
+            str_ = util::skip_CtrlAndSpace(str_);
+            if(!value()){
+                return false;
+            }
+            ++count;
+            str_ = util::skip_CtrlAndSpace(str_);
+            if(!str_.empty() && str_[0] == ','){
+                str_.remove_prefix(1);
+                str_ = util::skip_CtrlAndSpace(str_);
+            }
+            else if(str_.empty() || str_[0] != '}'){
+                return false;
+            }
+        }
+        if(str_.empty())return false;
+        str_.remove_prefix(1);
+        return close(start, TapeTag::ObjectEnd, count);
+    }
+
+private:
+    std::vector<uint64_t> &tape_;
+    std::string &strings_;
+    std::string_view str_;
+    std::string scratch_;
+};
+
+
+bool JsonTape::parse(std::string_view str){
+    tape_.clear();
+    strings_.clear();
+    // 大致估计：平均每8个字节一个字
+    tape_.reserve(str.size() / 8 + 16);
+    strings_.reserve(str.size() / 2);
+    if(!TapeBuilder(*this).build(str)){
+        tape_.clear();
+        strings_.clear();
+        return false;
+    }
+    tape_.shrink_to_fit();
+    strings_.shrink_to_fit();
+    return true;
+}
+
+/* ---------------------------------------------ref--------------------------------------------- */
+
+TapeTag JsonTapeRef::tag() const{
+    if(tape_ == nullptr){
+        return TapeTag::Null;
+    }
+    return (TapeTag)(tape_->tape_[index_] >> JsonTape::tag_shift);
+}
+
+
+uint64_t JsonTapeRef::payload() const{
+    return tape_->tape_[index_] & JsonTape::payload_mask;
+}
+
+
+size_t JsonTapeRef::next() const{
+    switch (tag())
+    {
+    case TapeTag::ArrayStart:
+    case TapeTag::ObjectStart:
+        return payload() & 0xFFFFFFFFull;
+    case TapeTag::Int64:
+    case TapeTag::UInt64:
+    case TapeTag::Double:
+        return index_ + 2;
+    default:
+        return index_ + 1;
+    }
+}
+
+
+JsonType JsonTapeRef::getType() const{
+    if(tape_ == nullptr){
+        return JsonType::UNKOWN;
+    }
+    switch (tag())
+    {
+    case TapeTag::Null:
+        return JsonType::Null;
+    case TapeTag::True:
+    case TapeTag::False:
+        return JsonType::Boolean;
+    case TapeTag::Integer:
+        return JsonType::Integer;
+    case TapeTag::Int64:
+        return JsonType::Int64;
+    case TapeTag::UInt64:
+        return JsonType::UInt64;
+    case TapeTag::Double:
+        return JsonType::Double;
+    case TapeTag::String:
+        return JsonType::String;
+    case TapeTag::ArrayStart:
+        return JsonType::Array;
+    case TapeTag::ObjectStart:
+        return JsonType::Object;
+    default:
+        return JsonType::UNKOWN;
+    }
+}
+
+
+bool JsonTapeRef::getBool() const{
+    if(!isBoolean()){
+        throw HAHA_JSON_ERROR("tape value is not a boolean");
+    }
+    return tag() == TapeTag::True;
+}
+
+
+int JsonTapeRef::getInt() const{
+    if(!isInteger()){
+        throw HAHA_JSON_ERROR("tape value is not an int");
+    }
+    return (int)(uint32_t)payload();
+}
+
+
+int64_t JsonTapeRef::getInt64() const{
+    if(isInteger()){
+        return getInt();
+    }
+    if(!isInt64()){
+        throw HAHA_JSON_ERROR("tape value is not an int64");
+    }
+    return (int64_t)tape_->tape_[index_ + 1];
+}
+
+
+uint64_t JsonTapeRef::getUInt64() const{
+    if(isUInt64()){
+        return tape_->tape_[index_ + 1];
+    }
+    if((isInteger() || isInt64()) && getInt64() >= 0){
+        return (uint64_t)getInt64();
+    }
+    throw HAHA_JSON_ERROR("tape value is not an uint64");
+}
+
+
+double JsonTapeRef::getDouble() const{
+    switch (tag())
+    {
+    case TapeTag::Double:
+        {
+            double d;
+            memcpy(&d, &tape_->tape_[index_ + 1], sizeof(d));
+            return d;
+        }
+    case TapeTag::Integer:
+        return getInt();
+    case TapeTag::Int64:
+        return (double)getInt64();
+    case TapeTag::UInt64:
+        return (double)getUInt64();
+    default:
+        throw HAHA_JSON_ERROR("tape value is not a number");
+    }
+}
+
+
+std::string_view JsonTapeRef::getString() const{
+    if(!isString()){
+        throw HAHA_JSON_ERROR("tape value is not a string");
+    }
+    const char *p = tape_->strings_.data() + payload();
+    uint32_t len;
+    memcpy(&len, p, sizeof(len));
+    return std::string_view(p + sizeof(len), len);
+}
+
+
+size_t JsonTapeRef::size() const{
+    if(!isIterable()){
+        return 0;
+    }
+    uint64_t count = payload() >> 32;
+    if(count < JsonTape::max_count){
+        return count;
+    }
+    size_t n = 0;
+    for(auto it = begin(); it != end(); ++it){
+        ++n;
+    }
+    return n;
+}
+
+
+JsonTapeRef::iterator JsonTapeRef::begin() const{
+    if(!isIterable()){
+        return end();
+    }
+    return iterator(tape_, index_ + 1, isObject());
+}
+
+
+JsonTapeRef::iterator JsonTapeRef::end() const{
+    // 指向结束字
+    size_t stop = isIterable() ? next() - 1 : index_;
+    return iterator(tape_, stop, isObject());
+}
+
+
+JsonTapeRef JsonTapeRef::operator[](size_t i) const{
+    if(!isArray()){
+        throw HAHA_JSON_ERROR("do not support operator[]");
+    }
+    for(auto it = begin(); it != end(); ++it, --i){
+        if(i == 0){
+            return *it;
+        }
+    }
+    throw HAHA_JSON_ERROR("array index out of range");
+}
+
+
+JsonTapeRef JsonTapeRef::find(std::string_view key) const{
+    if(!isObject()){
+        return JsonTapeRef();
+    }
+    for(auto it = begin(); it != end(); ++it){
+        if(it.key() == key){
+            return *it;
+        }
+    }
+    return JsonTapeRef();
+}
+
+
+JsonTapeRef JsonTapeRef::operator[](std::string_view key) const{
+    if(!isObject()){
+        throw HAHA_JSON_ERROR("do not support operator[]");
+    }
+    auto res = find(key);
+    if(!res.valid()){
+        throw HAHA_JSON_ERROR("key not found: " + std::string(key));
+    }
+    return res;
+}
+
+
+JsonNode::ptr JsonTapeRef::toNode() const{
+    switch (getType())
+    {
+    case JsonType::Null:
+        return std::make_shared<JsonNull>();
+    case JsonType::Boolean:
+        return std::make_shared<JsonBoolean>(getBool());
+    case JsonType::Integer:
+        return std::make_shared<JsonInteger>(getInt());
+    case JsonType::Int64:
+        return std::make_shared<JsonInt64>(getInt64());
+    case JsonType::UInt64:
+        return std::make_shared<JsonUInt64>(getUInt64());
+    case JsonType::Double:
+        return std::make_shared<JsonDouble>(getDouble());
+    case JsonType::String:
+        return std::make_shared<JsonString>(std::string(getString()));
+    case JsonType::Array:
+        {
+            auto arr = std::make_shared<JsonArray>();
+            for(auto v : *this){
+                arr->add(v.toNode());
+            }
+            return arr;
+        }
+    case JsonType::Object:
+        {
+            auto obj = std::make_shared<JsonObject>();
+            for(auto it = begin(); it != end(); ++it){
+                obj->add(std::string(it.key()), (*it).toNode());
+            }
+            return obj;
+        }
+    default:
+        return nullptr;
+    }
+}
+
+
+std::string JsonTapeRef::toString(const PrintFormatter &format) const{
+    auto node = toNode();
+    return node ? node->toString(format) : "";
+}
+
+} // namespace json
+
+} // namespace haha
@@ -0,0 +1,154 @@
+#ifndef __HAHA_JSON_JSONTAPE_H__
+#define __HAHA_JSON_JSONTAPE_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+#include "jsonValue.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+/* tape上每个字的高8位标记类型，低56位是负载 */
+enum class TapeTag : uint8_t {
+    Null = 'n',
+    True = 't',
+    False = 'f',
+    Integer = 'i',      // 负载的低32位就是值
+    Int64 = 'l',        // 值在下一个字
+    UInt64 = 'u',       // 值在下一个字
+    Double = 'd',       // 值的位模式在下一个字
+    String = '"',       // 负载为字符串区中的偏移，那里先存32位长度再存内容
+    ArrayStart = '[',   // 负载低32位为结束字的下一个位置，32~55位为元素个数
+    ArrayEnd = ']',     // 负载为开始字的位置
+    ObjectStart = '{',  // 同ArrayStart，个数为键值对数
+    ObjectEnd = '}',
+};
+
+class JsonTape;
+
+/* tape上某个值的只读视图，不持有tape，接口与JsonNode对应 */
+class JsonTapeRef{
+public:
+    class iterator;
+
+    JsonTapeRef() {}
+    JsonTapeRef(const JsonTape *tape, size_t index):tape_(tape),index_(index){}
+
+    /* 默认构造的和find没找到时返回的视图无效 */
+    bool valid() const { return tape_ != nullptr; }
+
+    JsonType getType() const;
+    bool isIterable() const { return isObject() || isArray(); }
+    bool isString() const { return tag() == TapeTag::String; }
+    bool isNumber() const { return isInteger() || isInt64() || isUInt64() || isDouble(); }
+    bool isInteger() const { return tag() == TapeTag::Integer; }
+    bool isInt64() const { return tag() == TapeTag::Int64; }
+    bool isUInt64() const { return tag() == TapeTag::UInt64; }
+    bool isDouble() const { return tag() == TapeTag::Double; }
+    bool isBoolean() const { return tag() == TapeTag::True || tag() == TapeTag::False; }
+    bool isNull() const { return tag() == TapeTag::Null; }
+    bool isArray() const { return tag() == TapeTag::ArrayStart; }
+    bool isObject() const { return tag() == TapeTag::ObjectStart; }
+
+    /* 类型不符时抛出异常；整数可以按更宽的类型读，任何数字都可以按double读 */
+    bool getBool() const;
+    int getInt() const;
+    int64_t getInt64() const;
+    uint64_t getUInt64() const;
+    double getDouble() const;
+    std::string_view getString() const;
+
+    /* 数组的元素个数或对象的键值对数，其余类型为0 */
+    size_t size() const;
+
+    /* 越界、键不存在或类型不符时抛出异常 */
+    JsonTapeRef operator[](size_t i) const;
+    JsonTapeRef operator[](std::string_view key) const;
+    /* 对象中查找键，找不到返回无效视图 */
+    JsonTapeRef find(std::string_view key) const;
+
+    /* 遍历数组元素或对象的值，对象的键用iterator::key()取得 */
+    iterator begin() const;
+    iterator end() const;
+
+    /* 转成普通的JsonNode树 */
+    JsonNode::ptr toNode() const;
+    std::string toString(const PrintFormatter &format = PrintFormatter()) const;
+
+    size_t index() const { return index_; }
+
+private:
+    TapeTag tag() const;
+    uint64_t payload() const;
+    /* 下一个兄弟值的位置 */
+    size_t next() const;
+
+private:
+    const JsonTape *tape_ = nullptr;
+    size_t index_ = 0;
+};
+
+
+class JsonTapeRef::iterator{
+public:
+    iterator(const JsonTape *tape, size_t index, bool object):tape_(tape),index_(index),object_(object){}
+
+    /* 当前的值 */
+    JsonTapeRef operator*() const { return JsonTapeRef(tape_, object_ ? index_ + 1 : index_); }
+    /* 当前的键，只对对象有效 */
+    std::string_view key() const { return JsonTapeRef(tape_, index_).getString(); }
+
+    iterator& operator++(){
+        index_ = JsonTapeRef(tape_, object_ ? index_ + 1 : index_).next();
+        return *this;
+    }
+    bool operator==(const iterator &rhs) const { return index_ == rhs.index_; }
+    bool operator!=(const iterator &rhs) const { return index_ != rhs.index_; }
+
+private:
+    const JsonTape *tape_;
+    size_t index_;
+    bool object_;
+};
+
+
+/* 面向只读场景的紧凑表示：整篇文档是一串连续的64位字，字符串集中放在另一块缓冲区
+   容器的开始字记着结束位置，跳过整个子树是O(1)的 */
+class JsonTape{
+public:
+    /* 解析失败(包括超出max_words、max_string_length)时返回false，tape清空 */
+    bool parse(std::string_view str);
+
+    /* 根节点，tape为空时返回无效视图 */
+    JsonTapeRef root() const { return tape_.empty() ? JsonTapeRef() : JsonTapeRef(this, 0); }
+
+    const std::vector<uint64_t>& words() const { return tape_; }
+    /* tape和字符串区占用的内存 */
+    size_t memoryBytes() const { return tape_.capacity() * sizeof(uint64_t) + strings_.capacity(); }
+
+    static constexpr int tag_shift = 56;
+    static constexpr uint64_t payload_mask = (1ull << tag_shift) - 1;
+    /* 容器元素个数的饱和值，超过时size()改为逐个数 */
+    static constexpr uint64_t max_count = 0xFFFFFF;
+    /* 开始字只有32位记结束位置，字符串长度也只存32位：tape超过max_words个字或字符串不短于4GB时解析失败 */
+    static constexpr uint64_t max_words = 0xFFFFFFFF;
+    static constexpr uint64_t max_string_length = 0xFFFFFFFF;
+
+private:
+    friend class JsonTapeRef;
+    friend class TapeBuilder;
+
+    std::vector<uint64_t> tape_;
+    std::string strings_;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
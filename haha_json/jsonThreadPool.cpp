@@ -0,0 +1,165 @@
+#include "jsonThreadPool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 当前线程在哪个线程池里、编号多少，外部线程为nullptr */
+static thread_local const ThreadPool *tls_pool = nullptr;
+static thread_local unsigned tls_worker = 0;
+
+
+ThreadPool::ThreadPool(unsigned threads){
+    if(threads == 0){
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for(unsigned i = 0; i < threads; ++i){
+        queues_.emplace_back(std::make_unique<Queue>());
+    }
+    for(unsigned i = 0; i < threads; ++i){
+        threads_.emplace_back([this, i]{ run(i); });
+    }
+}
+
+
+ThreadPool& ThreadPool::shared(){
+    static ThreadPool pool;
+    return pool;
+}
+
+
+bool ThreadPool::inWorker() const{
+    return tls_pool == this;
+}
+
+
+ThreadPool::~ThreadPool(){
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for(auto &t : threads_){
+        t.join();
+    }
+}
+
+
+void ThreadPool::submit(Task task){
+    unsigned q = tls_pool == this ? tls_worker : next_++ % size();
+    pending_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues_[q]->mtx);
+        queues_[q]->tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+    {
+        // 与run里的检查同在mtx_下，不会错过唤醒
+        std::lock_guard<std::mutex> lock(mtx_);
+    }
+    work_cv_.notify_one();
+}
+
+
+bool ThreadPool::take(unsigned worker, Task &task){
+    if(queued_.load() == 0){
+        return false;
+    }
+    {
+        Queue &own = *queues_[worker];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if(!own.tasks.empty()){
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    for(unsigned k = 1; k < size(); ++k){
+        Queue &other = *queues_[(worker + k) % size()];
+        std::lock_guard<std::mutex> lock(other.mtx);
+        if(!other.tasks.empty()){
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void ThreadPool::execute(unsigned worker, Task &task){
+    task(worker);
+    task = nullptr;
+    if(pending_.fetch_sub(1) == 1){
+        std::lock_guard<std::mutex> lock(mtx_);
+        idle_cv_.notify_all();
+    }
+}
+
+
+void ThreadPool::run(unsigned worker){
+    tls_pool = this;
+    tls_worker = worker;
+    Task task;
+    while(true){
+        if(take(worker, task)){
+            execute(worker, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mtx_);
+        work_cv_.wait(lock, [this]{ return stop_ || queued_.load() != 0; });
+        if(stop_ && queued_.load() == 0){
+            return;
+        }
+    }
+}
+
+
+void ThreadPool::wait(){
+    std::unique_lock<std::mutex> lock(mtx_);
+    idle_cv_.wait(lock, [this]{ return pending_.load() == 0; });
+}
+
+
+void TaskGroup::run(ThreadPool::Task task){
+    pending_.fetch_add(1);
+    pool_.submit([this, task = std::move(task)](unsigned worker){
+        task(worker);
+        // 在锁里减，等待的一方拿到锁之后这里就不会再碰这个对象了
+        std::lock_guard<std::mutex> lock(mtx_);
+        if(pending_.fetch_sub(1) == 1){
+            cv_.notify_all();
+        }
+    });
+}
+
+
+void TaskGroup::wait(){
+    if(tls_pool == &pool_){
+        ThreadPool::Task task;
+        while(pending_.load() != 0){
+            if(pool_.take(tls_worker, task)){
+                pool_.execute(tls_worker, task);
+                continue;
+            }
+            // 没有可帮的任务时睡在cv_上，这组任务完成时被叫醒；隔一会儿醒来看看有没有新提交的任务
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait_for(lock, std::chrono::microseconds(500), [this]{ return pending_.load() == 0; });
+        }
+        std::lock_guard<std::mutex> lock(mtx_);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [this]{ return pending_.load() == 0; });
+}
+
+} // namespace json
+
+} // namespace haha
@@ -0,0 +1,91 @@
+#ifndef __HAHA_JSON_JSONTHREADPOOL_H__
+#define __HAHA_JSON_JSONTHREADPOOL_H__
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 工作窃取线程池：每个线程有自己的任务队列，从队尾取自己的任务，空了就从别的线程队头偷
+   在线程池的线程里提交的任务进它自己的队列，递归拆分的任务大多留在本线程 */
+class ThreadPool{
+public:
+    /* 参数为任务的执行线程编号，在[0, size())之间，可以用来索引线程自己的缓存 */
+    using Task = std::function<void(unsigned worker)>;
+
+    /* threads为0时按cpu核数 */
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return (unsigned)queues_.size(); }
+    /* 当前线程是否是这个线程池的工作线程 */
+    bool inWorker() const;
+
+    /* 进程内共用的线程池，线程数按cpu核数，第一次用到时创建
+       没有指定线程池的并行解析默认用它，不必每次调用都创建、销毁一批线程 */
+    static ThreadPool& shared();
+
+    void submit(Task task);
+
+    /* 等到所有已提交的任务都完成，不要在线程池的线程里调用，那里用TaskGroup */
+    void wait();
+
+private:
+    friend class TaskGroup;
+    struct Queue{
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    void run(unsigned worker);
+    /* 先取自己队列的队尾，再从其他队列的队头偷 */
+    bool take(unsigned worker, Task &task);
+    void execute(unsigned worker, Task &task);
+
+private:
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex mtx_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+    std::atomic<size_t> pending_{0};    // 已提交还没执行完的任务数
+    std::atomic<size_t> queued_{0};     // 还在队列里的任务数
+    std::atomic<unsigned> next_{0};     // 外部提交时轮流放进各个队列
+    bool stop_ = false;
+};
+
+/* 一组任务，可以只等这一组完成；在线程池的线程里等待时一边等一边帮着执行任务，不会占着线程空等 */
+class TaskGroup{
+public:
+    explicit TaskGroup(ThreadPool &pool):pool_(pool){}
+    ~TaskGroup(){ wait(); }
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void run(ThreadPool::Task task);
+    void wait();
+
+private:
+    ThreadPool &pool_;
+    std::atomic<size_t> pending_{0};
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
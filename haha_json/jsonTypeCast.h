@@ -11,6 +11,8 @@ namespace json
 template<typename V> struct Value2JClassMap;
 template<> struct Value2JClassMap<std::string> { using T = JsonString; };
 template<> struct Value2JClassMap<int> { using T = JsonInteger; };
+template<> struct Value2JClassMap<int64_t> { using T = JsonInt64; };
+template<> struct Value2JClassMap<uint64_t> { using T = JsonUInt64; };
 template<> struct Value2JClassMap<double> { using T = JsonDouble; };
 template<> struct Value2JClassMap<bool> { using T = JsonBoolean; };
 template<> struct Value2JClassMap<decltype(nullptr)> { using T = JsonNull; };
@@ -21,6 +23,8 @@ template<> struct Value2JClassMap<JsonObject::ValueType> { using T = JsonObject;
 template<JsonType jtype> struct JType2JClassMap;
 template<> struct JType2JClassMap<JsonType::String> { using T = JsonString; };
 template<> struct JType2JClassMap<JsonType::Integer> { using T = JsonInteger; };
+template<> struct JType2JClassMap<JsonType::Int64> { using T = JsonInt64; };
+template<> struct JType2JClassMap<JsonType::UInt64> { using T = JsonUInt64; };
 template<> struct JType2JClassMap<JsonType::Double> { using T = JsonDouble; };
 template<> struct JType2JClassMap<JsonType::Boolean> { using T = JsonBoolean; };
 template<> struct JType2JClassMap<JsonType::Null> { using T = JsonNull; };
@@ -31,6 +35,8 @@ template<> struct JType2JClassMap<JsonType::Object> { using T = JsonObject; };
 template<JsonType jtype> struct JType2ValueMap;
 template<> struct JType2ValueMap<JsonType::String> { using T = std::string; };
 template<> struct JType2ValueMap<JsonType::Integer> { using T = int; };
+template<> struct JType2ValueMap<JsonType::Int64> { using T = int64_t; };
+template<> struct JType2ValueMap<JsonType::UInt64> { using T = uint64_t; };
 template<> struct JType2ValueMap<JsonType::Double> { using T = double; };
 template<> struct JType2ValueMap<JsonType::Boolean> { using T = bool; };
 template<> struct JType2ValueMap<JsonType::Null> { using T = decltype(nullptr); };
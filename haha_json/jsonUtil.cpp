@@ -1,8 +1,190 @@
 #include <assert.h>
+#include <algorithm>
+#include <stdint.h>
 #include "jsonUtil.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 using namespace haha::json;
 
+bool util::cpuHasAvx2(){
+#if defined(__x86_64__) || defined(__i386__)
+    // 可能在静态初始化阶段被调用，先初始化cpu信息
+    __builtin_cpu_init();
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#else
+    return false;
+#endif
+}
+
+namespace
+{
+
+typedef size_t (*SkipKernel)(const char *str, size_t length);
+
+size_t skip_scalar(const char *str, size_t length){
+    size_t i = 0;
+    while(i < length && util::isCtrlAndSpace(str[i])){
+        ++i;
+    }
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* 有符号比较，大于32的才不是空白，与isCtrlAndSpace一致 */
+__attribute__((target("sse2")))
+size_t skip_sse2(const char *str, size_t length){
+    size_t i = 0;
+    const __m128i space = _mm_set1_epi8(32);
+    for(; i + 16 <= length; i += 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(v, space));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + skip_scalar(str + i, length - i);
+}
+
+__attribute__((target("avx2")))
+size_t skip_avx2(const char *str, size_t length){
+    size_t i = 0;
+    const __m256i space = _mm256_set1_epi8(32);
+    for(; i + 32 <= length; i += 32){
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, space));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + skip_sse2(str + i, length - i);
+}
+
+#endif
+
+SkipKernel pickSkipKernel(){
+#if defined(__x86_64__) || defined(__i386__)
+    if(util::cpuHasAvx2()){
+        return skip_avx2;
+    }
+    if(__builtin_cpu_supports("sse2")){
+        return skip_sse2;
+    }
+#endif
+    return skip_scalar;
+}
+
+const SkipKernel skip_kernel = pickSkipKernel();
+
+typedef size_t (*EscapeKernel)(const char *str, size_t length, bool ascii);
+
+inline bool needEscape(unsigned char c, bool ascii){
+    return c < 0x20 || c == '"' || c == '\\' || (ascii && c >= 0x80);
+}
+
+size_t escape_scalar(const char *str, size_t length, bool ascii){
+    size_t i = 0;
+    while(i < length && !needEscape(str[i], ascii)){
+        ++i;
+    }
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* 无符号比较：max(v, 0x1F) == 0x1F即v < 0x20；非ascii字节直接取最高位 */
+__attribute__((target("sse2")))
+size_t escape_sse2(const char *str, size_t length, bool ascii){
+    size_t i = 0;
+    const __m128i ctrl = _mm_set1_epi8(0x1F);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for(; i + 16 <= length; i += 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+        __m128i r = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(r);
+        if(ascii){
+            mask |= (unsigned)_mm_movemask_epi8(v);
+        }
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + escape_scalar(str + i, length - i, ascii);
+}
+
+__attribute__((target("avx2")))
+size_t escape_avx2(const char *str, size_t length, bool ascii){
+    size_t i = 0;
+    const __m256i ctrl = _mm256_set1_epi8(0x1F);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    for(; i + 32 <= length; i += 32){
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+        __m256i r = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrl), ctrl),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(r);
+        if(ascii){
+            mask |= (unsigned)_mm256_movemask_epi8(v);
+        }
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + escape_sse2(str + i, length - i, ascii);
+}
+
+#endif
+
+EscapeKernel pickEscapeKernel(){
+#if defined(__x86_64__) || defined(__i386__)
+    if(util::cpuHasAvx2()){
+        return escape_avx2;
+    }
+    if(__builtin_cpu_supports("sse2")){
+        return escape_sse2;
+    }
+#endif
+    return escape_scalar;
+}
+
+const EscapeKernel escape_kernel = pickEscapeKernel();
+
+/* 8个字节是否都等于c */
+inline bool all_eq8(const char *str, char c){
+    uint64_t word;
+    memcpy(&word, str, 8);
+    return word == 0x0101010101010101ull * (unsigned char)c;
+}
+
+} // namespace
+
+
+size_t util::count_CtrlAndSpaceRun(const char *str, size_t length){
+    // 缩进：换行后跟着若干个同样的\t或空格，每次比较8个
+    if(str[0] == '\n' && (str[1] == '\t' || str[1] == ' ')){
+        char c = str[1];
+        size_t i = 1;
+        while(i + 8 <= length && all_eq8(str + i, c)){
+            i += 8;
+        }
+        while(i < length && str[i] == c){
+            ++i;
+        }
+        if(i == length || !isCtrlAndSpace(str[i])){
+            return i;
+        }
+        return i + skip_kernel(str + i, length - i);
+    }
+
+    return skip_kernel(str, length);
+}
+
 const char* util::skip_CtrlAndSpace(const char* str, size_t length, size_t offset){
     if(str == nullptr || length <= offset){
         return nullptr;
@@ -10,23 +192,9 @@ const char* util::skip_CtrlAndSpace(const char* str, size_t length, size_t offse
     str += offset;
     length -= offset;
     // ascll码32之前的为控制字符，32为空格符
-    while(length && isCtrlAndSpace(*str)){
-        --length;
-        ++str;
-    }
-    return str;
+    return str + count_CtrlAndSpace(str, length);
 }
 
-std::string_view util::skip_CtrlAndSpace(std::string_view str, size_t offset){
-    if(str.size() <= offset){
-        return "";
-    }
-    str.remove_prefix(offset);
-    while(!str.empty() && isCtrlAndSpace(str[0])){
-        str.remove_prefix(1);
-    }
-    return str;
-}
 
 const char * util::skip_utf8_bom(const char* str, size_t length, size_t offset){
     if(str == nullptr || length <= offset){
@@ -146,6 +314,10 @@ std::string util::utf16_literal_to_utf8(std::string_view &str)
     }
     unsigned int first_code = 0;
     std::string_view first_seq = str.substr(0, 4);
+    // parse_hex4遇到非法字符返回0，与\u0000无法区分，先检查
+    if(!std::all_of(first_seq.begin(), first_seq.end(), util::isHex)){
+        return "";
+    }
     first_code = util::parse_hex4(first_seq);
     if (((first_code >= 0xDC00) && (first_code <= 0xDFFF)))
     {
@@ -162,6 +334,9 @@ std::string util::utf16_literal_to_utf8(std::string_view &str)
         }
         str.remove_prefix(2);
         std::string_view second_seq = str.substr(0, 4);
+        if(!std::all_of(second_seq.begin(), second_seq.end(), util::isHex)){
+            return "";
+        }
         second_code = util::parse_hex4(second_seq);
         if ((second_code < 0xDC00) || (second_code > 0xDFFF))
         {
@@ -227,4 +402,53 @@ std::string util::utf16_literal_to_utf8(std::string_view &str)
     }
 
     return output;
-}
\ No newline at end of file
+}
+
+size_t util::find_escape(const char* str, size_t length, bool ascii){
+    return escape_kernel(str, length, ascii);
+}
+
+
+unsigned int util::decode_utf8(const unsigned char* str, size_t length, size_t &len){
+    len = 1;
+    unsigned char c = str[0];
+    unsigned int codepoint = 0;
+    size_t n = 0;
+    unsigned int min = 0;
+    if(c < 0x80){
+        return c;
+    }
+    else if((c & 0xE0) == 0xC0){
+        n = 2;
+        codepoint = c & 0x1F;
+        min = 0x80;
+    }
+    else if((c & 0xF0) == 0xE0){
+        n = 3;
+        codepoint = c & 0x0F;
+        min = 0x800;
+    }
+    else if((c & 0xF8) == 0xF0){
+        n = 4;
+        codepoint = c & 0x07;
+        min = 0x10000;
+    }
+    else{
+        return 0xFFFD;
+    }
+    if(n > length){
+        return 0xFFFD;
+    }
+    for(size_t i = 1; i < n; ++i){
+        if((str[i] & 0xC0) != 0x80){
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (str[i] & 0x3F);
+    }
+    // 过长编码、代理区和超出范围的码点都不合法
+    if(codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)){
+        return 0xFFFD;
+    }
+    len = n;
+    return codepoint;
+}
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <bitset>
 #include <locale>
+#include <string_view>
 
 namespace haha
 {
@@ -75,8 +76,34 @@ inline std::string repeat_char(size_t cnt, char c){
     return std::string(cnt, c);
 }
 
+/* 运行时检测cpu是否支持avx2，用于选择simd实现 */
+bool cpuHasAvx2();
+
+/* 开头至少有两个空白时调用：换行加缩进走快速路径，其余按cpu选择avx2/sse2/标量实现 */
+size_t count_CtrlAndSpaceRun(const char* str, size_t length);
+
+/* 开头连续的控制字符和空白的个数
+   大多数时候已经停在下一个记号上，或者只隔一个空格(", " ": ")，这两种情况内联处理 */
+inline size_t count_CtrlAndSpace(const char* str, size_t length){
+    if(length == 0 || !isCtrlAndSpace(str[0])){
+        return 0;
+    }
+    if(length == 1 || !isCtrlAndSpace(str[1])){
+        return 1;
+    }
+    return count_CtrlAndSpaceRun(str, length);
+}
+
 const char* skip_CtrlAndSpace(const char* str, size_t length, size_t offset=0);
-std::string_view skip_CtrlAndSpace(std::string_view str, size_t offset=0);
+
+inline std::string_view skip_CtrlAndSpace(std::string_view str, size_t offset=0){
+    if(str.size() <= offset){
+        return "";
+    }
+    str.remove_prefix(offset);
+    str.remove_prefix(count_CtrlAndSpace(str.data(), str.size()));
+    return str;
+}
 
 const char* skip_utf8_bom(const char* str, size_t length, size_t offset=0);
 std::string_view skip_utf8_bom(std::string_view str, size_t offset=0);
@@ -109,6 +136,14 @@ std::string utf16_literal_to_utf8(std::string_view &str);
 
 std::string utf8_to_unicode(std::string_view &str);
 
+/* 序列化时第一个需要转义的字节的位置：控制字符、'"'、'\\'，ascii为true时还包括>=0x80的字节
+   没有则返回length，按cpu选择avx2/sse2/标量实现 */
+size_t find_escape(const char* str, size_t length, bool ascii);
+
+/* 解码str开头的一个utf8字符，len为其字节数
+   非法或不完整的序列返回0xFFFD，len为1 */
+unsigned int decode_utf8(const unsigned char* str, size_t length, size_t &len);
+
 }
 
 }
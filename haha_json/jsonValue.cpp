@@ -1,4 +1,8 @@
 #include "jsonValue.h"
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
 
 using namespace haha::json;
 
@@ -25,6 +29,8 @@ JsonNode::ptr JsonNode::copyFrom(JsonNode::ptr src){
     {
         CASE(String);
         CASE(Integer);
+        CASE(Int64);
+        CASE(UInt64);
         CASE(Double);
         CASE(Boolean);
         CASE(Null);
@@ -39,80 +45,378 @@ JsonNode::ptr JsonNode::copyFrom(JsonNode::ptr src){
 }
 
 JsonNode::JsonNode(const JsonNode& jsvb){
-    if(jsvb.isScalar()){
-        val_ = jsvb.val_;
-    }
-    else{
-        if(jsvb.type_ == JsonType::Array){
-            val_ = std::vector<JsonNode::ptr>();
-            auto &arr = std::get<std::vector<JsonNode::ptr>>(val_);
-            auto &arr1 = std::get<std::vector<JsonNode::ptr>>(jsvb.val_);
-            arr.reserve(arr1.size());
-            for(auto p : arr1){
-                arr.emplace_back(copyFrom(p));
-            }
-        }
-        else if(jsvb.type_ == JsonType::Object){
-            val_ = std::map<JsonString, JsonNode::ptr>();
-            auto &obj = std::get<std::map<JsonString, JsonNode::ptr>>(val_);
-            auto &obj1 = std::get<std::map<JsonString, JsonNode::ptr>>(jsvb.val_);
-            for(auto [k, v] : obj1){
-                auto vp = copyFrom(v);
-                obj.insert({k, vp});
-            }
-        }
-    }
+    // 值由各个子类自己拷贝
     type_ = jsvb.type_;
 }
 
-JsonArray::JsonArray(const JsonArray &another){
-    val_ = std::vector<JsonNode::ptr>();
-    auto &arr = std::get<std::vector<JsonNode::ptr>>(val_);
-    auto &arr1 = std::get<std::vector<JsonNode::ptr>>(another.val_);
-    arr.reserve(arr1.size());
-    for(auto p : arr1){
-        arr.emplace_back(copyFrom(p));
+JsonString::JsonString(const JsonString& another)
+    :JsonValue(JsonType::String),
+    view_(another.view_),
+    owner_(another.owner_),
+    borrowed_(another.borrowed_),
+    hint_(another.hint_),
+    copied_(another.copied_),
+    version_(another.version_)
+{
+    // 借用的字符串还没拷贝完时val_可能正被别的线程写，不去读它
+    if(!borrowed_ || copied_.done()){
+        val_ = another.val_;
+    }
+}
+
+JsonString& JsonString::operator=(const JsonString& another){
+    if(this != &another){
+        touch();
+        ++version_;
+        view_ = another.view_;
+        owner_ = another.owner_;
+        borrowed_ = another.borrowed_;
+        hint_ = another.hint_;
+        copied_ = another.copied_;
+        val_ = !borrowed_ || copied_.done() ? another.val_ : std::string();
+    }
+    return *this;
+}
+
+JsonArray::JsonArray(const JsonArray &another)
+    :JsonValue(JsonType::Array),
+    hash_(another.hash_),
+    version_(another.version_)
+{
+    val_.reserve(another.val_.size());
+    for(auto p : another.val_){
+        val_.emplace_back(copyFrom(p));
     }
-    type_ = another.type_;
 }
 
 
 JsonArray& JsonArray::operator=(const JsonArray& another){
-    val_ = std::vector<JsonNode::ptr>(); // 这个过程会自动把原来的值析构掉
-    auto &arr = std::get<std::vector<JsonNode::ptr>>(val_);
-    auto &arr1 = std::get<std::vector<JsonNode::ptr>>(another.val_);
-    arr.reserve(arr1.size());
-    for(auto p : arr1){
+    touch();
+    ++version_;
+    Array arr;
+    arr.reserve(another.val_.size());
+    for(auto p : another.val_){
         arr.emplace_back(copyFrom(p));
     }
+    val_ = std::move(arr); // 原来的值随之析构
     type_ = another.type_;
     return *this;
 }
 
 
-JsonObject::JsonObject(const JsonObject& another){
-    val_ = std::map<JsonString, JsonNode::ptr>();
-    auto &obj = std::get<std::map<JsonString, JsonNode::ptr>>(val_);
-    auto &obj1 = std::get<std::map<JsonString, JsonNode::ptr>>(another.val_);
-    for(auto [k, v] : obj1){
-        auto vp = copyFrom(v);
-        obj.insert({k, vp});
+JsonObject::JsonObject(const JsonObject& another)
+    :JsonValue(JsonType::Object),
+    hash_(another.hash_),
+    version_(another.version_)
+{
+    val_.setPolicy(another.val_.policy());
+    for(auto &[k, v] : another.val_){
+        val_.emplace(k, copyFrom(v));
     }
-    type_ = another.type_;
 }
 
 JsonObject& JsonObject::operator=(const JsonObject& another){
-    val_ = std::map<JsonString, JsonNode::ptr>(); // 这个过程会自动把原来的值析构掉
-    auto &obj = std::get<std::map<JsonString, JsonNode::ptr>>(val_);
-    auto &obj1 = std::get<std::map<JsonString, JsonNode::ptr>>(another.val_);
-    for(auto [k, v] : obj1){
-        auto vp = copyFrom(v);
-        obj.insert({k, vp});
+    touch();
+    ++version_;
+    Map obj(another.val_.policy());
+    for(auto &[k, v] : another.val_){
+        obj.emplace(k, copyFrom(v));
     }
+    val_ = std::move(obj); // 原来的值随之析构
     type_ = another.type_;
     return *this;
 }
 
+/* ---------------------------------------------about hash--------------------------------------------- */
+
+std::atomic<uint64_t> HashCache::epoch_{1};
+
+namespace
+{
+
+constexpr uint64_t hash_seed = 0x9e3779b97f4a7c15ULL;
+
+/* splitmix64的混合函数 */
+inline uint64_t mix(uint64_t x){
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* 按小端读8个字节，保证不同字节序的机器上哈希相同 */
+inline uint64_t load64(const char *p){
+    uint64_t w;
+    memcpy(&w, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+uint64_t hash_bytes(std::string_view str, uint64_t seed){
+    const char *p = str.data();
+    size_t n = str.size();
+    uint64_t h = seed ^ (n * hash_seed);
+    for(; n >= 8; p += 8, n -= 8){
+        h = mix(h ^ load64(p));
+    }
+    uint64_t tail = 0;
+    for(size_t i = 0; i < n; ++i){
+        tail |= (uint64_t)(uint8_t)p[i] << (8 * i);
+    }
+    return mix(h ^ tail);
+}
+
+/* 数字的规范形式：能精确表示成int64的都是Int，其次是UInt，剩下的才是Double
+   这样1、1.0以及不同宽度的同一个整数比较和哈希的结果都一致 */
+struct CanonicalNumber{
+    enum Kind : uint8_t { Int, UInt, Double } kind;
+    uint64_t bits;
+
+    bool operator==(const CanonicalNumber &rhs) const { return kind == rhs.kind && bits == rhs.bits; }
+};
+
+CanonicalNumber canonical(double d){
+    if(d == std::floor(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0){
+        return {CanonicalNumber::Int, (uint64_t)(int64_t)d};
+    }
+    if(d == std::floor(d) && d >= 0 && d < 18446744073709551616.0){
+        return {CanonicalNumber::UInt, (uint64_t)d};
+    }
+    uint64_t bits;
+    memcpy(&bits, &d, 8);
+    return {CanonicalNumber::Double, bits};
+}
+
+CanonicalNumber canonical(const JsonNode &node){
+    switch (node.getType())
+    {
+    case JsonType::Integer:
+        return {CanonicalNumber::Int, (uint64_t)(int64_t)static_cast<const JsonInteger&>(node).getValue()};
+    case JsonType::Int64:
+        return {CanonicalNumber::Int, (uint64_t)static_cast<const JsonInt64&>(node).getValue()};
+    case JsonType::UInt64:{
+        uint64_t u = static_cast<const JsonUInt64&>(node).getValue();
+        return {u <= (uint64_t)INT64_MAX ? CanonicalNumber::Int : CanonicalNumber::UInt, u};
+    }
+    default:
+        return canonical(static_cast<const JsonDouble&>(node).getValue());
+    }
+}
+
+bool is_number(JsonType type){
+    return type == JsonType::Integer || type == JsonType::Int64 || type == JsonType::UInt64 || type == JsonType::Double;
+}
+
+/* 各类值的标记，混进哈希里区分类型 */
+enum HashTag : uint64_t { TagNull = 1, TagBoolean, TagNumber, TagString, TagArray, TagObject };
+
+/* 数字的摘要：修改计数，改过的数字再加上值，计数回绕时也不会误判 */
+template<typename N>
+uint64_t number_digest(const JsonNode &node){
+    auto &num = static_cast<const N&>(node);
+    uint64_t bits = 0;
+    if(num.raw().empty()){
+        auto val = num.getValue();
+        memcpy(&bits, &val, sizeof(val));
+    }
+    return mix(((uint64_t)num.version() << 32) ^ (TagNumber * hash_seed) ^ mix(bits));
+}
+
+} // namespace
+
+
+uint64_t JsonNode::refresh() const{
+    if(!observed_.load(std::memory_order_relaxed)){
+        observed_.store(true, std::memory_order_relaxed);
+    }
+    switch (type_)
+    {
+    case JsonType::Null:
+        return TagNull;
+    case JsonType::Boolean:
+        return TagBoolean * hash_seed + static_cast<const JsonBoolean*>(this)->getValue();
+    case JsonType::String:{
+        // 内容只能经非const的getValue或赋值改变，长度顺带防计数回绕
+        auto *str = static_cast<const JsonString*>(this);
+        return mix(((uint64_t)str->version() << 32) ^ (TagString * hash_seed) ^ str->view().size());
+    }
+    case JsonType::Integer:
+        return number_digest<JsonInteger>(*this);
+    case JsonType::Int64:
+        return number_digest<JsonInt64>(*this);
+    case JsonType::UInt64:
+        return number_digest<JsonUInt64>(*this);
+    case JsonType::Double:
+        return number_digest<JsonDouble>(*this);
+    case JsonType::Array:{
+        auto *arr = static_cast<const JsonArray*>(this);
+        uint64_t epoch = HashCache::epoch();
+        if(arr->hash_.current(epoch)){
+            return arr->hash_.digest();
+        }
+        uint64_t digest = mix((TagArray * hash_seed) ^ arr->version_);
+        for(auto &v : arr->val_){
+            digest = mix(digest ^ v->refresh());
+        }
+        digest |= 1;
+        if(arr->hash_.matches(digest)){
+            arr->hash_.set(epoch, digest, arr->hash_.hash());
+            return digest;
+        }
+        // 数组与元素的顺序有关，逐个串起来
+        uint64_t h = mix((TagArray * hash_seed) ^ arr->val_.size());
+        for(auto &v : arr->val_){
+            h = mix(h ^ v->freshHash());
+        }
+        arr->hash_.set(epoch, digest, h);
+        return digest;
+    }
+    case JsonType::Object:{
+        // 键只能经非const的访问改变，摘要里不必有键
+        auto *obj = static_cast<const JsonObject*>(this);
+        uint64_t epoch = HashCache::epoch();
+        if(obj->hash_.current(epoch)){
+            return obj->hash_.digest();
+        }
+        uint64_t digest = mix((TagObject * hash_seed) ^ obj->version_);
+        for(auto &kv : obj->val_){
+            digest = mix(digest ^ kv.second->refresh());
+        }
+        digest |= 1;
+        if(obj->hash_.matches(digest)){
+            obj->hash_.set(epoch, digest, obj->hash_.hash());
+            return digest;
+        }
+        // 对象与成员的顺序无关，各个成员的哈希相加
+        uint64_t sum = 0;
+        for(auto &[k, v] : obj->val_){
+            sum += mix(hash_bytes(k.view(), TagString * hash_seed) + hash_seed * v->freshHash());
+        }
+        uint64_t h = mix((TagObject * hash_seed) ^ obj->val_.size() ^ mix(sum));
+        obj->hash_.set(epoch, digest, h);
+        return digest;
+    }
+    default:
+        return 0;
+    }
+}
+
+
+uint64_t JsonNode::freshHash() const{
+    if(type_ == JsonType::Array){
+        return static_cast<const JsonArray*>(this)->hash_.hash();
+    }
+    if(type_ == JsonType::Object){
+        return static_cast<const JsonObject*>(this)->hash_.hash();
+    }
+    return hash();
+}
+
+
+uint64_t JsonNode::hash() const{
+    switch (type_)
+    {
+    case JsonType::Null:
+        return mix(TagNull * hash_seed);
+    case JsonType::Boolean:
+        return mix(TagBoolean * hash_seed + static_cast<const JsonBoolean*>(this)->getValue());
+    case JsonType::String:
+        return hash_bytes(static_cast<const JsonString*>(this)->view(), TagString * hash_seed);
+    case JsonType::Array:
+    case JsonType::Object:
+        refresh();
+        return freshHash();
+    default:
+        if(is_number(type_)){
+            auto num = canonical(*this);
+            return mix((TagNumber * hash_seed + num.kind) ^ mix(num.bits));
+        }
+        return 0;
+    }
+}
+
+
+namespace
+{
+
+/* 逐个节点比较，不看缓存的哈希 */
+bool equal(const JsonNode &a, const JsonNode &b){
+    if(&a == &b){
+        return true;
+    }
+    JsonType ta = a.getType(), tb = b.getType();
+    if(ta != tb){
+        return is_number(ta) && is_number(tb) && canonical(a) == canonical(b);
+    }
+    switch (ta)
+    {
+    case JsonType::Null:
+        return true;
+    case JsonType::Boolean:
+        return static_cast<const JsonBoolean&>(a).getValue() == static_cast<const JsonBoolean&>(b).getValue();
+    case JsonType::String:
+        return static_cast<const JsonString&>(a).view() == static_cast<const JsonString&>(b).view();
+    case JsonType::Array:{
+        auto &vx = static_cast<const JsonArray&>(a).getValue();
+        auto &vy = static_cast<const JsonArray&>(b).getValue();
+        if(vx.size() != vy.size()){
+            return false;
+        }
+        for(size_t i = 0; i < vx.size(); ++i){
+            if(!equal(*vx[i], *vy[i])){
+                return false;
+            }
+        }
+        return true;
+    }
+    case JsonType::Object:{
+        auto &mx = static_cast<const JsonObject&>(a).getValue();
+        auto &my = static_cast<const JsonObject&>(b).getValue();
+        if(mx.size() != my.size()){
+            return false;
+        }
+        for(auto &[k, v] : mx){
+            auto it = my.find(k.view());
+            if(it == my.end() || !equal(*v, *it->second)){
+                return false;
+            }
+        }
+        return true;
+    }
+    default:
+        return canonical(a) == canonical(b);
+    }
+}
+
+} // namespace
+
+
+bool operator==(const JsonNode &a, const JsonNode &b){
+    if(&a == &b){
+        return true;
+    }
+    // 校验缓存要走一遍子树，只在最外层比一次哈希
+    if(a.getType() == JsonType::Array && b.getType() == JsonType::Array){
+        auto &x = static_cast<const JsonArray&>(a);
+        auto &y = static_cast<const JsonArray&>(b);
+        if(x.size() == y.size() && x.hash_.cached() && y.hash_.cached() && a.hash() != b.hash()){
+            return false;
+        }
+    }
+    else if(a.getType() == JsonType::Object && b.getType() == JsonType::Object){
+        auto &x = static_cast<const JsonObject&>(a);
+        auto &y = static_cast<const JsonObject&>(b);
+        if(x.size() == y.size() && x.hash_.cached() && y.hash_.cached() && a.hash() != b.hash()){
+            return false;
+        }
+    }
+    return equal(a, b);
+}
+
 /* ---------------------------------------------type conversion--------------------------------------------- */
 
 std::string getJsonTypeName(JsonType json_type){
@@ -130,6 +434,12 @@ std::string getJsonTypeName(JsonType json_type){
     case JsonType::Integer:
         return "Integer";
         break;
+    case JsonType::Int64:
+        return "Int64";
+        break;
+    case JsonType::UInt64:
+        return "UInt64";
+        break;
     case JsonType::Double:
         return "Double";
         break;
@@ -146,63 +456,50 @@ std::string getJsonTypeName(JsonType json_type){
 }
 
 
-std::string JsonString::toString(const PrintFormatter &format, int depth) const{
-    std::string res;
-    res.reserve(getValue().size());
-    res += '"';
-
-    std::string_view view(getValue());
-    // char utf_str[6] = {0};
-
-    while(!view.empty()){
-        // 普通字符
-        if(view[0] > 31 && view[0] != '\"' && view[0] != '\\'){
-            res += view[0];
-        }
-        else{
-            res += '\\';
-            switch (view[0])
-            {
-            case '\\':
-                res += '\\';
-                break;
-            case '\"':
-                res += '"';
-                break;
-            case '\b':
-                res += 'b';
-                break;
-            case '\f':
-                res += 'f';
-                break;
-            case '\n':
-                res += 'n';
-                break;
-            case '\r':
-                res += 'r';
-                break;
-            case '\t':
-                res += 't';
-                break;
-            default:
-                // uxxxx
-                // if(format.ensureAscii()){
-                //     sprintf(utf_str, "u%04x", *(unsigned char *)view.data());
-                //     res += utf_str;
-                // }
-                // else{
-                //     res.pop_back();
-                //     res += view[0];
-                // }
-                res.pop_back();
-                res += view[0];
-                break;
-            }
+/* ---------------------------------------------number format--------------------------------------------- */
+
+char* formatNumber(char *buf, int val){
+    return std::to_chars(buf, buf + number_buffer_size, val).ptr;
+}
+
+char* formatNumber(char *buf, int64_t val){
+    return std::to_chars(buf, buf + number_buffer_size, val).ptr;
+}
+
+char* formatNumber(char *buf, uint64_t val){
+    return std::to_chars(buf, buf + number_buffer_size, val).ptr;
+}
+
+char* formatNumber(char *buf, double val, FloatFormat ff, int precision){
+    // json里没有nan和inf
+    if(!std::isfinite(val)){
+        memcpy(buf, "null", 4);
+        return buf + 4;
+    }
+
+    char *end = buf + number_buffer_size;
+    if(ff == FloatFormat::Shortest){
+        char *p = std::to_chars(buf, end, val).ptr;
+        if(std::find_if(buf, p, [](char c){ return c == '.' || c == 'e'; }) == p){
+            memcpy(p, ".0", 2);
+            p += 2;
         }
-        view.remove_prefix(1);
+        return p;
+    }
+
+    std::chars_format cf = ff == FloatFormat::Fixed ? std::chars_format::fixed
+                         : ff == FloatFormat::Scientific ? std::chars_format::scientific
+                         : std::chars_format::general;
+    if(precision < 0){
+        return std::to_chars(buf, end, val, cf).ptr;
     }
-    res += '"';
-    return res;
+    // 最长的定点表示是DBL_MAX的309位整数部分，精度限制在40以内保证放得下
+    return std::to_chars(buf, end, val, cf, std::min(precision, 40)).ptr;
+}
+
+
+std::string JsonString::toString(const PrintFormatter &format, int depth) const{
+    return serialize(*this, format, depth);
 }
 
 
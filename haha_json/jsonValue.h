@@ -3,10 +3,13 @@
 
 #include <memory>
 #include <vector>
-#include <variant>
-#include <map>
+#include <atomic>
+#include <string_view>
+#include <stdint.h>
+#include <charconv>
 #include "jsonUtil.h"
 #include "jsonError.h"
+#include "jsonObjectMap.h"
 
 
 namespace haha
@@ -15,7 +18,7 @@ namespace haha
 namespace json
 {
 
-enum class JsonType { UNKOWN, Object, Array, String, Integer, Double, Boolean, Null };
+enum class JsonType : uint8_t { UNKOWN, Object, Array, String, Integer, Int64, UInt64, Double, Boolean, Null };
 
 typedef decltype(nullptr) NullType;
 
@@ -23,25 +26,110 @@ std::string getJsonTypeName(JsonType json_type);
 
 enum class JsonFormatType { RAW, SPACE, NEWLINE };
 
+/* 浮点数输出方式：Shortest为能原样读回的最短表示，其余同std::chars_format */
+enum class FloatFormat { Shortest, Fixed, Scientific, General };
+
 class PrintFormatter{
 public:
     PrintFormatter(const JsonFormatType &fmt = JsonFormatType::RAW, 
-                    int indent = 0)
-                    // bool ensure_ascii = true)
+                    int indent = 0,
+                    bool ensure_ascii = false)
         :format_(fmt),
-        indent_(indent)
-        // ensure_ascii_(ensure_ascii)
+        indent_(indent),
+        ensure_ascii_(ensure_ascii)
     {
     }
     JsonFormatType formatType() const { return format_; }
-    // bool ensureAscii() const { return ensure_ascii_; }
+    /* 为true时非ascii字符输出为\uXXXX，码点超出BMP的输出为代理对 */
+    bool ensureAscii() const { return ensure_ascii_; }
+
+    /* 浮点数的记法和精度，precision小于0时取该记法下的最短表示 */
+    PrintFormatter& setFloatFormat(FloatFormat ff, int precision = -1){
+        float_format_ = ff;
+        precision_ = precision;
+        return *this;
+    }
+    FloatFormat floatFormat() const { return float_format_; }
+    int precision() const { return precision_; }
+
+    /* NEWLINE格式下每层缩进indent个indent_char，indent不大于0时按1个算 */
+    int indent() const { return indent_ > 0 ? indent_ : 1; }
+    PrintFormatter& setIndentChar(char c){
+        indent_char_ = c;
+        return *this;
+    }
+    char indentChar() const { return indent_char_; }
+
+    /* 对象的成员默认按插入顺序输出，设置后按键排序 */
+    PrintFormatter& setSortKeys(bool sort){
+        sort_keys_ = sort;
+        return *this;
+    }
+    bool sortKeys() const { return sort_keys_; }
 private:
     JsonFormatType format_ = JsonFormatType::RAW;
     int indent_ = 0;
-    // bool ensure_ascii_ = true;
+    bool ensure_ascii_ = false;
+    FloatFormat float_format_ = FloatFormat::Shortest;
+    int precision_ = -1;
+    char indent_char_ = '\t';
+    bool sort_keys_ = false;
 };
 
+/* 数字格式化：写入buf并返回写入的结尾，buf至少要number_buffer_size字节 */
+constexpr size_t number_buffer_size = 384;
+char* formatNumber(char *buf, int val);
+char* formatNumber(char *buf, int64_t val);
+char* formatNumber(char *buf, uint64_t val);
+/* 非有限值输出null；Shortest记法下结果像整数时补上".0"，保证读回来仍是浮点数 */
+char* formatNumber(char *buf, double val, FloatFormat ff = FloatFormat::Shortest, int precision = -1);
+
 class JsonString;
+class JsonNode;
+
+/* 容器缓存的哈希
+   是否有效只看子树状态的摘要：由子树里各节点的修改计数(每次非const访问加一)和bool、数字的值算出，摘要不变时缓存仍然有效
+   修改只动被修改节点自己的计数，不影响别的树；但校验摘要要走一遍子树，所以另有一个纪元做快速判断：
+   算哈希时给走过的节点做标记，带标记的节点被修改时才换新纪元并去掉标记，纪元没变时缓存直接可用
+   解析、修改没算过哈希的树都不碰纪元；换了纪元后各个缓存走一遍子树校验摘要，没变的不必重新计算 */
+class HashCache{
+public:
+    HashCache() {}
+    // 复制出的子节点还没有标记，纪元不跟过来，第一次取用时校验一遍摘要
+    HashCache(const HashCache &another){
+        uint64_t digest = another.digest_.load(std::memory_order_acquire);
+        hash_.store(another.hash_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        digest_.store(digest, std::memory_order_release);
+    }
+    // 赋值的节点换了内容，缓存不跟过来
+    HashCache& operator=(const HashCache &) { return *this; }
+
+    static uint64_t epoch() { return epoch_.load(std::memory_order_relaxed); }
+    static void bump() { epoch_.fetch_add(1, std::memory_order_relaxed); }
+
+    bool cached() const { return digest_.load(std::memory_order_relaxed) != 0; }
+    /* 在epoch里算过或校验过 */
+    bool current(uint64_t epoch) const { return epoch_of_.load(std::memory_order_acquire) == epoch; }
+    /* 缓存是在子树处于digest时算的 */
+    bool matches(uint64_t digest) const { return digest_.load(std::memory_order_acquire) == digest; }
+    uint64_t digest() const { return digest_.load(std::memory_order_relaxed); }
+    uint64_t hash() const { return hash_.load(std::memory_order_relaxed); }
+
+    void set(uint64_t epoch, uint64_t digest, uint64_t h) const {
+        hash_.store(h, std::memory_order_relaxed);
+        digest_.store(digest, std::memory_order_release);
+        epoch_of_.store(epoch, std::memory_order_release);
+    }
+
+private:
+    static std::atomic<uint64_t> epoch_;
+    mutable std::atomic<uint64_t> hash_{0};
+    mutable std::atomic<uint64_t> digest_{0};       // 摘要总是奇数，0表示没有缓存
+    mutable std::atomic<uint64_t> epoch_of_{0};     // 纪元从1开始
+};
+
+/* 从depth层开始把node序列化成字符串，整棵树只走一遍、写进同一个缓冲区，见jsonWriter.h */
+std::string serialize(const JsonNode &node, const PrintFormatter &format, int depth = 0);
 
 class JsonNode{
 public:
@@ -50,6 +138,11 @@ public:
     virtual ~JsonNode() {}
 
     JsonNode(const JsonNode& jsvb);
+    JsonNode& operator=(const JsonNode &another){
+        touch();
+        type_ = another.type_;
+        return *this;
+    }
 
     JsonType getType() const { return type_; }
     // 是否为标量：字符串、数字、bool、null
@@ -58,25 +151,36 @@ public:
     bool isIterable() const { return type_ == JsonType::Object || type_ == JsonType::Array; }
     
     bool isString() { return type_ == JsonType::String; }
-    bool isNumber() { return isInteger() || isDouble(); }
+    bool isNumber() { return isInteger() || isInt64() || isUInt64() || isDouble(); }
     bool isInteger() { return type_ == JsonType::Integer; }
+    bool isInt64() { return type_ == JsonType::Int64; }
+    bool isUInt64() { return type_ == JsonType::UInt64; }
     bool isDouble() { return type_ == JsonType::Double; }
     bool isBoolean() { return type_ == JsonType::Boolean; }
     bool isNull() { return type_ == JsonType::Null; }
     bool isArray() { return type_ == JsonType::Array; }
     bool isObject() { return type_ == JsonType::Object; }
 
+    /* 只读的节点(如NodePool里共享的节点)被非const地访问或赋值时抛出JsonError，要修改时换成一份拷贝；拷贝出的节点不是只读的 */
+    bool readOnly() const { return read_only_; }
+    void setReadOnly() { read_only_ = true; }
+
+    /* 结构哈希：64位，与对象成员的顺序无关，不随进程和平台变化；相等(见operator==)的值哈希相同
+       容器的哈希缓存在节点里，子树里有节点被非const地访问(getValue、operator[]、add、del、赋值)过时重新计算，见HashCache
+       通过留下来的子节点指针修改也没问题，只是不要在算过哈希之后再通过之前拿到的非const引用修改 */
+    uint64_t hash() const;
+
     virtual std::string toString (const PrintFormatter &format = PrintFormatter(), int depth = 0) const { return ""; }
 
-    // std::string toString (bool ensure_ascii) const {
-    //     return toString({JsonFormatType::RAW, 0, ensure_ascii});
-    // }
-    // std::string toString (int indent, bool ensure_ascii) const {
-    //     return toString({JsonFormatType::RAW, indent, ensure_ascii});
-    // }
-    // std::string toString (const JsonFormatType &fmt, int indent, bool ensure_ascii) const {
-    //     return toString({fmt, indent, ensure_ascii});
-    // }
+    std::string toString (bool ensure_ascii) const {
+        return toString({JsonFormatType::RAW, 0, ensure_ascii});
+    }
+    std::string toString (int indent, bool ensure_ascii) const {
+        return toString({JsonFormatType::RAW, indent, ensure_ascii});
+    }
+    std::string toString (const JsonFormatType &fmt, int indent, bool ensure_ascii) const {
+        return toString({fmt, indent, ensure_ascii});
+    }
     std::string toString (int indent) const {
         return toString({JsonFormatType::RAW, indent});
     }
@@ -84,7 +188,7 @@ public:
         return toString({fmt, indent});
     }
 
-    virtual JsonNode& operator[](const std::string &key){
+    virtual JsonNode& operator[](std::string_view key){
         throw HAHA_JSON_ERROR("do not support operator[]");
     }
     virtual JsonNode& operator[](unsigned key){
@@ -94,13 +198,29 @@ public:
 protected:
     JsonNode::ptr copyFrom(JsonNode::ptr src);
 
+    /* 非const地访问之前调用：只读的节点抛出异常；节点参与过缓存的哈希时换新纪元，见HashCache */
+    void touch(){
+        if(read_only_){
+            throw HAHA_JSON_ERROR("node is read-only");
+        }
+        if(observed_.load(std::memory_order_relaxed)){
+            observed_.store(false, std::memory_order_relaxed);
+            HashCache::bump();
+        }
+    }
+
+private:
+    /* 标记节点，返回子树当前状态的摘要，容器过期的哈希顺便重新算好 */
+    uint64_t refresh() const;
+    /* 容器取refresh之后缓存的哈希，标量直接计算 */
+    uint64_t freshHash() const;
+
 protected:
     JsonType type_;
-    std::variant<bool, int, double,
-                decltype(nullptr),
-                std::string,
-                std::vector<JsonNode::ptr>,
-                std::map<JsonString, JsonNode::ptr>> val_ = nullptr;
+
+private:
+    mutable std::atomic<bool> observed_{false};     // 参与过缓存的哈希
+    bool read_only_ = false;
 };
 
 
@@ -109,22 +229,131 @@ class JsonValue : public JsonNode{
 public:
     using ValueType = T;
     JsonValue(JsonType type, const T& val)
-        :JsonNode(type){ val_ = val; }
+        :JsonNode(type),val_(val){}
+    explicit JsonValue(JsonType type):JsonNode(type){}
     JsonValue():JsonNode(){}
-    const T& getValue() const { return std::get<ValueType>(val_); }
-    T& getValue() { return std::get<ValueType>(val_); }
+    const T& getValue() const { return val_; }
+    T& getValue() {
+        this->touch();
+        return val_;
+    }
+
+protected:
+    // 每种节点只存自己类型的值，不再为最大的那种预留空间
+    T val_{};
 };
 
 
+/* 只读访问时才做的一次性工作(借用字符串的拷贝、延迟数字的转换)
+   多个线程同时第一次读取同一个节点时只有一个去做，其余等它做完，之后的读取只是一次原子加载 */
+class LazyOnce{
+public:
+    explicit LazyOnce(bool done = true):state_(done ? Done : Pending){}
+    // 复制时对方还没做完就当作没做过，由新节点自己再做一次
+    LazyOnce(const LazyOnce &another):LazyOnce(another.done()){}
+    LazyOnce& operator=(const LazyOnce &another){
+        state_.store(another.done() ? Done : Pending, std::memory_order_release);
+        return *this;
+    }
+
+    bool done() const { return state_.load(std::memory_order_acquire) == Done; }
+    /* 非const的路径上单线程地直接标记 */
+    void reset(bool done) { state_.store(done ? Done : Pending, std::memory_order_release); }
+
+    template<typename Fn>
+    void call(Fn &&fn) const {
+        uint8_t expected = Pending;
+        if(state_.compare_exchange_strong(expected, Running, std::memory_order_acquire)){
+            fn();
+            state_.store(Done, std::memory_order_release);
+            state_.notify_all();
+            return;
+        }
+        while(expected != Done){
+            state_.wait(expected, std::memory_order_acquire);
+            expected = state_.load(std::memory_order_acquire);
+        }
+    }
+
+private:
+    enum : uint8_t { Done, Pending, Running };
+    mutable std::atomic<uint8_t> state_;
+};
+
+
+/* 字符串内容是否需要转义，解析时顺手记下，序列化时据此跳过扫描
+   Clean：不含控制字符、'"'和'\\'；CleanAscii：在此基础上全是ascii */
+enum class EscapeHint : uint8_t { Unknown, Clean, CleanAscii };
+
 class JsonString : public JsonValue<std::string>{
 public:
     typedef std::shared_ptr<JsonString> ptr;
     explicit JsonString(const std::string &str):JsonValue(JsonType::String, str){}
-    // JsonString(const JsonString& another);
+    /* 借用模式：只引用view指向的字节，owner负责让这段内存活着（为空时由调用者保证） */
+    JsonString(std::string_view view, std::shared_ptr<const void> owner)
+        :JsonValue(JsonType::String),
+        view_(view),
+        owner_(std::move(owner)),
+        borrowed_(true),
+        copied_(false)
+    {
+    }
+    JsonString(const JsonString& another);
+    JsonString& operator=(const JsonString& another);
+
+    /* 借用的字符串在首次调用getValue时才拷贝成std::string；const的访问可以在多个线程上同时进行 */
+    const std::string& getValue() const {
+        if(borrowed_ && !copied_.done()){
+            copied_.call([this]{ const_cast<std::string&>(val_) = std::string(view_); });
+        }
+        return val_;
+    }
+    std::string& getValue() {
+        // 内容可能被改写，提示作废
+        touch();
+        ++version_;
+        hint_ = EscapeHint::Unknown;
+        return materialize();
+    }
+
+    /* 不拷贝地访问字符串内容 */
+    std::string_view view() const {
+        return borrowed_ ? view_ : std::string_view(val_);
+    }
+    bool isBorrowed() const { return borrowed_; }
+
+    EscapeHint escapeHint() const { return hint_; }
+    void setEscapeHint(EscapeHint hint) { hint_ = hint; }
+
+    /* 非const访问和赋值的次数，容器据此判断缓存的哈希是否过期 */
+    uint32_t version() const { return version_; }
+
     std::string toString(const PrintFormatter &format = PrintFormatter(), int depth = 0) const override;
     bool operator <(const JsonString &rhs) const{
-        return getValue() < rhs.getValue();
+        return view() < rhs.view();
     }
+
+private:
+    std::string& materialize(){
+        if(borrowed_){
+            if(!copied_.done()){
+                val_ = std::string(view_);
+            }
+            copied_.reset(true);
+            view_ = {};
+            owner_.reset();
+            borrowed_ = false;
+        }
+        return val_;
+    }
+
+private:
+    std::string_view view_;
+    std::shared_ptr<const void> owner_;
+    bool borrowed_ = false;
+    EscapeHint hint_ = EscapeHint::Unknown;
+    LazyOnce copied_;       // 借用时val_是否已经拷贝好
+    uint32_t version_ = 0;
 };
 
 
@@ -143,13 +372,107 @@ class JsonNumber : public JsonValue<T>{
 public:
     typedef std::shared_ptr<JsonNumber> ptr;
     explicit JsonNumber(const T& val):JsonValue<T>(JTYPE, val){}
+    /* 延迟模式：只记下数字在输入中的原文，owner负责让这段内存活着（为空时由调用者保证） */
+    JsonNumber(std::string_view raw, std::shared_ptr<const void> owner)
+        :JsonValue<T>(JTYPE),
+        raw_(raw),
+        owner_(std::move(owner)),
+        converted_(false)
+    {
+    }
+    // 转换还没完成时val_可能正被别的线程写，不去读它
+    JsonNumber(const JsonNumber &another)
+        :JsonValue<T>(JTYPE),
+        raw_(another.raw_),
+        owner_(another.owner_),
+        converted_(another.converted_),
+        version_(another.version_)
+    {
+        if(converted_.done()){
+            this->val_ = another.val_;
+        }
+    }
+    JsonNumber& operator=(const JsonNumber &another){
+        if(this != &another){
+            this->touch();
+            ++version_;
+            raw_ = another.raw_;
+            owner_ = another.owner_;
+            converted_ = another.converted_;
+            this->val_ = converted_.done() ? another.val_ : T{};
+        }
+        return *this;
+    }
+
+    /* 首次调用时才把原文转换成数值；const的访问可以在多个线程上同时进行 */
+    const T& getValue() const {
+        if(!converted_.done()){
+            converted_.call([this]{ const_cast<T&>(this->val_) = convert(raw_); });
+        }
+        return this->val_;
+    }
+    /* 返回的引用可能被修改，不再保留原文 */
+    T& getValue() {
+        this->touch();
+        ++version_;
+        if(!converted_.done()){
+            this->val_ = convert(raw_);
+            converted_.reset(true);
+        }
+        raw_ = {};
+        owner_.reset();
+        return JsonValue<T>::getValue();
+    }
+
+    /* 解析时的原文，没有或已被修改时为空 */
+    std::string_view raw() const { return raw_; }
+
+    /* 非const访问和赋值的次数，容器据此判断缓存的哈希是否过期 */
+    uint32_t version() const { return version_; }
+
+    /* 格式化后的文本，指向原文或buf，buf至少要number_buffer_size字节
+       未修改的数字原样输出，指定了浮点数记法时除外 */
+    std::string_view format(char *buf, const PrintFormatter &format) const {
+        if(!raw_.empty() && (JTYPE != JsonType::Double || format.floatFormat() == FloatFormat::Shortest)){
+            return raw_;
+        }
+        char *end;
+        if constexpr (JTYPE == JsonType::Double){
+            end = formatNumber(buf, getValue(), format.floatFormat(), format.precision());
+        }
+        else{
+            end = formatNumber(buf, getValue());
+        }
+        return std::string_view(buf, end - buf);
+    }
+
     std::string toString(const PrintFormatter &format = PrintFormatter(), int depth = 0) const override { 
-        return std::to_string(JsonValue<T>::getValue()); 
+        char buf[number_buffer_size];
+        return std::string(this->format(buf, format));
+    }
+
+private:
+    /* 原文在解析时已按类型和范围检查过 */
+    static T convert(std::string_view raw){
+        T val{};
+        std::from_chars(raw.data(), raw.data() + raw.size(), val);
+        return val;
     }
+
+private:
+    std::string_view raw_;
+    std::shared_ptr<const void> owner_;
+    LazyOnce converted_;
+    uint32_t version_ = 0;
 };
 
 using JsonInteger = JsonNumber<int, JsonType::Integer>;
 
+/* 超出int范围的整数，如id、纳秒时间戳 */
+using JsonInt64 = JsonNumber<int64_t, JsonType::Int64>;
+
+using JsonUInt64 = JsonNumber<uint64_t, JsonType::UInt64>;
+
 using JsonDouble = JsonNumber<double, JsonType::Double>;
 
 
@@ -174,6 +497,14 @@ public:
     JsonArray() : JsonValue(JsonType::Array, Array()){}
     JsonArray(const JsonArray &another);
 
+    const Array& getValue() const { return val_; }
+    /* 非const的访问可能修改成员，缓存的哈希随之过期 */
+    Array& getValue() {
+        touch();
+        ++version_;
+        return val_;
+    }
+
     ConstIterator begin() const { return getValue().begin(); }
     ConstIterator end() const { return getValue().end(); }
     Iterator begin() { return getValue().begin(); }
@@ -186,28 +517,13 @@ public:
     void add(const std::string &str) { getValue().emplace_back(std::make_shared<JsonString>(str)); }
     void add(bool val) { getValue().emplace_back(std::make_shared<JsonBoolean>(val)); }
     void add(int val) { getValue().emplace_back(std::make_shared<JsonInteger>(val)); }
+    void add(int64_t val) { getValue().emplace_back(std::make_shared<JsonInt64>(val)); }
+    void add(uint64_t val) { getValue().emplace_back(std::make_shared<JsonUInt64>(val)); }
     void add(double val) { getValue().emplace_back(std::make_shared<JsonDouble>(val)); }
     void add() { getValue().emplace_back(std::make_shared<JsonNull>()); }
 
     std::string toString(const PrintFormatter &format = PrintFormatter(), int depth = 0) const override {
-        std::string res = "[";
-        auto fmt = format.formatType();
-
-        for(size_t i = 0; i < getValue().size(); ++i){
-            if(fmt == JsonFormatType::NEWLINE){
-                res += '\n';
-                res += std::string(depth+1, '\t');
-            }
-            res += getValue()[i]->toString(format, depth+1);
-            res += i+1 < getValue().size() ? "," : "";
-            if(fmt == JsonFormatType::SPACE && i+1 < getValue().size()){
-                res += ' ';
-            }
-        }
-
-        res += fmt == JsonFormatType::NEWLINE && getValue().size() ? '\n' + std::string(depth, '\t') : "";
-        res += "]";
-        return res;
+        return serialize(*this, format, depth);
     }
 
     JsonArray& operator=(const JsonArray& another);
@@ -215,22 +531,41 @@ public:
     JsonNode& operator[](unsigned key){
         return *getValue()[key];
     }
+
+    /* 非const访问和赋值的次数 */
+    uint32_t version() const { return version_; }
+
+private:
+    friend class JsonNode;
+    friend bool operator==(const JsonNode &a, const JsonNode &b);
+    HashCache hash_;
+    uint32_t version_ = 0;
 };
 
 
-class JsonObject : public JsonValue<std::map<JsonString, JsonNode::ptr>>{
+/* 键是普通的std::string，成员按插入顺序存放 */
+class JsonObject : public JsonValue<ObjectMap<JsonNode::ptr>>{
 public:
-    typedef typename std::map<JsonString, JsonNode::ptr> Map;
+    typedef ObjectMap<JsonNode::ptr> Map;
     typedef typename Map::iterator Iterator;
     typedef typename Map::const_iterator ConstIterator;
 
     typedef std::shared_ptr<JsonObject> ptr;
-    typedef std::pair<std::string, JsonNode::ptr> kv_pair;
+    typedef std::pair<ObjectKey, JsonNode::ptr> kv_pair;
 
     JsonObject() : JsonValue(JsonType::Object, Map()){}
+    explicit JsonObject(ObjectIndexPolicy policy) : JsonValue(JsonType::Object, Map(policy)){}
 
     JsonObject(const JsonObject& another);
 
+    const Map& getValue() const { return val_; }
+    /* 非const的访问可能修改成员，缓存的哈希随之过期 */
+    Map& getValue() {
+        touch();
+        ++version_;
+        return val_;
+    }
+
     size_t size() const { return getValue().size(); }
 
     bool empty() const { return getValue().empty(); }
@@ -240,66 +575,103 @@ public:
     Iterator begin() { return getValue().begin(); }
     Iterator end() { return getValue().end(); }
 
+    /* 键按string_view传入，只有真正插入时才拷贝成std::string */
     void add(const JsonString::ptr key, JsonNode::ptr val){
-        getValue().insert({*key, val});
+        getValue().emplace(key->view(), val);
+    }
+    void add(const JsonString &key, JsonNode::ptr val){
+        getValue().emplace(key.view(), val);
+    }
+    void add(std::string_view key, JsonNode::ptr val){
+        getValue().emplace(key, val);
+    }
+    void add(std::string_view key, const std::string &val) { 
+        getValue().emplace(key, std::make_shared<JsonString>(val)); 
     }
-    void add(const JsonString key, JsonNode::ptr val){
-        getValue().insert({key, val});
+    void add(std::string_view key, bool val) { 
+        getValue().emplace(key, std::make_shared<JsonBoolean>(val)); 
     }
-    void add(const std::string &key, JsonNode::ptr val){
-        getValue().insert({JsonString(key), val});
+    void add(std::string_view key, int val) { 
+        getValue().emplace(key, std::make_shared<JsonInteger>(val)); 
     }
-    void add(const std::string &key, const std::string &val) { 
-        getValue().insert({JsonString(key), std::make_shared<JsonString>(val)}); 
+    void add(std::string_view key, int64_t val) { 
+        getValue().emplace(key, std::make_shared<JsonInt64>(val)); 
     }
-    void add(const std::string &key, bool val) { 
-        getValue().insert({JsonString(key), std::make_shared<JsonBoolean>(val)}); 
+    void add(std::string_view key, uint64_t val) { 
+        getValue().emplace(key, std::make_shared<JsonUInt64>(val)); 
     }
-    void add(const std::string &key, int val) { 
-        getValue().insert({JsonString(key), std::make_shared<JsonInteger>(val)}); 
+    void add(std::string_view key, double val) { 
+        getValue().emplace(key, std::make_shared<JsonDouble>(val)); 
     }
-    void add(const std::string &key, double val) { 
-        getValue().insert({JsonString(key), std::make_shared<JsonDouble>(val)}); 
+    void add(std::string_view key) { 
+        getValue().emplace(key, std::make_shared<JsonNull>()); 
     }
-    void add(const std::string &key) { 
-        getValue().insert({JsonString(key), std::make_shared<JsonNull>()}); 
+    size_t del(std::string_view key) {
+        return getValue().erase(key);
     }
-    size_t del(const std::string &key) {
-        return getValue().erase(JsonString(key));
+    size_t del(const JsonKey &key) {
+        return getValue().erase(key);
     }
 
+    /* 查找不分配内存，键不存在时抛出std::out_of_range */
     template<typename T = JsonNode>
-    T& get(const std::string &key){
-        return *std::static_pointer_cast<T>(getValue().at(JsonString(key)));
+    T& get(std::string_view key){
+        return *std::static_pointer_cast<T>(getValue().at(key));
+    }
+    template<typename T = JsonNode>
+    T& get(const JsonKey &key){
+        return *std::static_pointer_cast<T>(getValue().at(key));
+    }
+    /* 键不存在时返回nullptr */
+    JsonNode::ptr find(std::string_view key) const {
+        auto it = getValue().find(key);
+        return it == end() ? nullptr : it->second;
     }
+    JsonNode::ptr find(const JsonKey &key) const {
+        auto it = getValue().find(key);
+        return it == end() ? nullptr : it->second;
+    }
+    bool contains(std::string_view key) const { return getValue().count(key) != 0; }
 
     std::string toString(const PrintFormatter &format = PrintFormatter(), int depth = 0) const override {
-        std::string res = "{";
-        auto fmt = format.formatType();
-        int cnt = 0;
-        for(const auto &[k, v] : getValue()){
-            if(fmt == JsonFormatType::NEWLINE){
-                res += '\n';
-                res += std::string(depth+1, '\t');
-            }
-            res += k.toString(format, depth+1);
-            res += ':';
-            res += fmt == JsonFormatType::RAW ? "" : " ";
-            res += v->toString(format, depth+1);
-            res += (cnt + 1 < (int)getValue().size()) ? "," : "";
-            res += (cnt + 1 < (int)getValue().size() && fmt == JsonFormatType::SPACE) ? " " : "";
-            ++cnt;
-        }
-        res += fmt == JsonFormatType::NEWLINE && getValue().size() ? '\n' + std::string(depth, '\t') : "";
-        res += '}';
-        return res;
+        return serialize(*this, format, depth);
     }
 
     JsonObject& operator=(const JsonObject &another);
 
-    JsonNode& operator[](const std::string& key){
+    JsonNode& operator[](std::string_view key){
         return get(key);
     }
+    JsonNode& operator[](const JsonKey &key){
+        return get(key);
+    }
+
+    /* 非const访问和赋值的次数 */
+    uint32_t version() const { return version_; }
+
+private:
+    friend class JsonNode;
+    friend bool operator==(const JsonNode &a, const JsonNode &b);
+    HashCache hash_;
+    uint32_t version_ = 0;
+};
+
+
+/* 深比较：对象不看成员顺序；数字按数值比较，1与1.0相等
+   先比类型和大小，两边都缓存过哈希时再比哈希，发现不同立即返回 */
+bool operator==(const JsonNode &a, const JsonNode &b);
+inline bool operator!=(const JsonNode &a, const JsonNode &b) { return !(a == b); }
+
+/* 以节点的值作为哈希表的键，比如std::unordered_map<JsonNode::ptr, T, JsonNodeHash, JsonNodeEqual> */
+struct JsonNodeHash{
+    size_t operator()(const JsonNode &node) const { return node.hash(); }
+    size_t operator()(const JsonNode::ptr &node) const { return node ? node->hash() : 0; }
+};
+struct JsonNodeEqual{
+    bool operator()(const JsonNode &a, const JsonNode &b) const { return a == b; }
+    bool operator()(const JsonNode::ptr &a, const JsonNode::ptr &b) const {
+        return a == b || (a && b && *a == *b);
+    }
 };
 
 
@@ -309,6 +681,8 @@ T::ptr pointer_cast(JsonNode::ptr source){
     static_assert(
         std::is_same<T, JsonString>::value ||
         std::is_same<T, JsonInteger>::value ||
+        std::is_same<T, JsonInt64>::value ||
+        std::is_same<T, JsonUInt64>::value ||
         std::is_same<T, JsonDouble>::value ||
         std::is_same<T, JsonBoolean>::value ||
         std::is_same<T, JsonNull>::value ||
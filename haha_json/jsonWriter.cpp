@@ -0,0 +1,326 @@
+#include "jsonWriter.h"
+#include "jsonUtil.h"
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+
+namespace haha
+{
+
+namespace json
+{
+
+/* ---------------------------------------------sinks--------------------------------------------- */
+
+void FixedBufferSink::write(const char *data, size_t len){
+    size_t n = std::min(len, capacity_ - size_);
+    memcpy(buf_ + size_, data, n);
+    size_ += n;
+    if(n < len){
+        overflow_ = true;
+    }
+}
+
+
+void FileSink::write(const char *data, size_t len){
+    if(fwrite(data, 1, len, fp_) != len){
+        fail_ = true;
+    }
+}
+
+
+void FdSink::write(const char *data, size_t len){
+    while(len){
+        ssize_t n = ::write(fd_, data, len);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            fail_ = true;
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+/* ---------------------------------------------writer--------------------------------------------- */
+
+JsonWriter::JsonWriter(JsonSink &sink, const PrintFormatter &format)
+    :sink_(sink),
+    format_(format)
+{
+    if(format.formatType() == JsonFormatType::NEWLINE){
+        indent_.assign(256, format.indentChar());
+    }
+}
+
+
+JsonWriter::~JsonWriter(){
+    flush();
+}
+
+
+void JsonWriter::flush(){
+    drain();
+    sink_.flush();
+}
+
+
+void JsonWriter::drain(){
+    if(len_){
+        sink_.write(buf_, len_);
+        len_ = 0;
+    }
+}
+
+
+void JsonWriter::put(const char *data, size_t n){
+    if(n > buffer_size - len_){
+        drain();
+        // 比整个缓冲区还大的直接交给sink
+        if(n > buffer_size){
+            sink_.write(data, n);
+            return;
+        }
+    }
+    memcpy(buf_ + len_, data, n);
+    len_ += n;
+}
+
+
+void JsonWriter::newline(int depth){
+    put('\n');
+    size_t n = (size_t)depth * format_.indent();
+    while(n){
+        size_t k = std::min(n, indent_.size());
+        put(indent_.data(), k);
+        n -= k;
+    }
+}
+
+
+void JsonWriter::write(const JsonNode &node, int depth){
+    writeValue(node, depth);
+}
+
+
+void JsonWriter::writeValue(const JsonNode &node, int depth){
+    switch (node.getType())
+    {
+    case JsonType::Object:
+        writeObject(static_cast<const JsonObject&>(node), depth);
+        break;
+    case JsonType::Array:
+        writeArray(static_cast<const JsonArray&>(node), depth);
+        break;
+    case JsonType::String:
+        {
+            const auto &str = static_cast<const JsonString&>(node);
+            writeString(str.view(), str.escapeHint());
+        }
+        break;
+    case JsonType::Boolean:
+        put(static_cast<const JsonBoolean&>(node).getValue() ? std::string_view("true") : std::string_view("false"));
+        break;
+    case JsonType::Null:
+        put("null", 4);
+        break;
+
+    #define CASE(name) \
+        case JsonType::name: \
+            reserve(number_buffer_size); \
+            { \
+                auto text = static_cast<const Json##name&>(node).format(buf_ + len_, format_); \
+                if(text.data() == buf_ + len_){ \
+                    len_ += text.size(); \
+                } \
+                else{ \
+                    put(text); \
+                } \
+            } \
+            break;
+
+    CASE(Integer);
+    CASE(Int64);
+    CASE(UInt64);
+    CASE(Double);
+
+    #undef CASE
+
+    default:
+        break;
+    }
+}
+
+
+void JsonWriter::writeArray(const JsonArray &arr, int depth){
+    auto fmt = format_.formatType();
+    put('[');
+    size_t i = 0;
+    for(const auto &v : arr){
+        if(fmt == JsonFormatType::NEWLINE){
+            newline(depth + 1);
+        }
+        writeValue(*v, depth + 1);
+        if(++i < arr.size()){
+            put(',');
+            if(fmt == JsonFormatType::SPACE){
+                put(' ');
+            }
+        }
+    }
+    if(fmt == JsonFormatType::NEWLINE && !arr.empty()){
+        newline(depth);
+    }
+    put(']');
+}
+
+
+void JsonWriter::writeObject(const JsonObject &obj, int depth){
+    auto fmt = format_.formatType();
+    put('{');
+    size_t i = 0;
+    auto member = [&](std::string_view k, const JsonNode &v){
+        if(fmt == JsonFormatType::NEWLINE){
+            newline(depth + 1);
+        }
+        writeString(k);
+        put(':');
+        if(fmt != JsonFormatType::RAW){
+            put(' ');
+        }
+        writeValue(v, depth + 1);
+        if(++i < obj.size()){
+            put(',');
+            if(fmt == JsonFormatType::SPACE){
+                put(' ');
+            }
+        }
+    };
+    if(format_.sortKeys() && obj.size() > 1){
+        std::vector<const JsonObject::Map::value_type*> sorted;
+        sorted.reserve(obj.size());
+        for(const auto &kv : obj){
+            sorted.push_back(&kv);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](auto a, auto b){ return a->first < b->first; });
+        for(auto kv : sorted){
+            member(kv->first, *kv->second);
+        }
+    }
+    else{
+        for(const auto &[k, v] : obj){
+            member(k, *v);
+        }
+    }
+    if(fmt == JsonFormatType::NEWLINE && !obj.empty()){
+        newline(depth);
+    }
+    put('}');
+}
+
+
+void JsonWriter::writeString(std::string_view view, EscapeHint hint){
+    bool ascii = format_.ensureAscii();
+    put('"');
+    // 解析时已确认不用转义的直接整段拷贝
+    if(hint == EscapeHint::CleanAscii || (hint == EscapeHint::Clean && !ascii)){
+        put(view);
+        put('"');
+        return;
+    }
+    while(!view.empty()){
+        // 不用转义的一段整体拷贝，剩下的开头就是要转义的字符
+        size_t n = util::find_escape(view.data(), view.size(), ascii);
+        put(view.data(), n);
+        view.remove_prefix(n);
+        if(!view.empty()){
+            view.remove_prefix(writeEscape(view));
+        }
+    }
+    put('"');
+}
+
+
+size_t JsonWriter::writeEscape(std::string_view view){
+    unsigned char c = view[0];
+    char esc = 0;
+    switch (c)
+    {
+    case '\\':
+        esc = '\\';
+        break;
+    case '\"':
+        esc = '"';
+        break;
+    case '\b':
+        esc = 'b';
+        break;
+    case '\f':
+        esc = 'f';
+        break;
+    case '\n':
+        esc = 'n';
+        break;
+    case '\r':
+        esc = 'r';
+        break;
+    case '\t':
+        esc = 't';
+        break;
+    default:
+        break;
+    }
+    if(esc){
+        put('\\');
+        put(esc);
+        return 1;
+    }
+    if(c < 0x20){
+        writeUnicode(c);
+        return 1;
+    }
+    // 非ascii字符，只有ensure_ascii时才会走到这里
+    size_t len;
+    unsigned int u = util::decode_utf8(reinterpret_cast<const unsigned char*>(view.data()), view.size(), len);
+    if(u >= 0x10000){
+        u -= 0x10000;
+        writeUnicode(0xD800 | (u >> 10));
+        writeUnicode(0xDC00 | (u & 0x3FF));
+    }
+    else{
+        writeUnicode(u);
+    }
+    return len;
+}
+
+
+void JsonWriter::writeUnicode(unsigned int u){
+    static const char hex[] = "0123456789abcdef";
+    reserve(6);
+    char *p = buf_ + len_;
+    p[0] = '\\';
+    p[1] = 'u';
+    p[2] = hex[(u >> 12) & 0xF];
+    p[3] = hex[(u >> 8) & 0xF];
+    p[4] = hex[(u >> 4) & 0xF];
+    p[5] = hex[u & 0xF];
+    len_ += 6;
+}
+
+
+std::string serialize(const JsonNode &node, const PrintFormatter &format, int depth){
+    std::string res;
+    {
+        StringSink sink(res);
+        JsonWriter writer(sink, format);
+        writer.write(node, depth);
+    }
+    return res;
+}
+
+} // namespace json
+
+} // namespace haha
@@ -0,0 +1,131 @@
+#ifndef __HAHA_JSON_JSONWRITER_H__
+#define __HAHA_JSON_JSONWRITER_H__
+
+#include <string>
+#include <string_view>
+#include <stdio.h>
+#include "jsonValue.h"
+
+namespace haha
+{
+
+namespace json
+{
+
+/* 序列化的输出目标 */
+class JsonSink{
+public:
+    virtual ~JsonSink() {}
+    virtual void write(const char *data, size_t len) = 0;
+    virtual void flush() {}
+};
+
+
+/* 追加到可增长的std::string */
+class StringSink : public JsonSink{
+public:
+    explicit StringSink(std::string &out):out_(out){}
+    void write(const char *data, size_t len) override { out_.append(data, len); }
+private:
+    std::string &out_;
+};
+
+
+/* 写进调用者提供的定长缓冲区，放不下的部分丢弃并标记overflow */
+class FixedBufferSink : public JsonSink{
+public:
+    FixedBufferSink(char *buf, size_t capacity):buf_(buf),capacity_(capacity){}
+    void write(const char *data, size_t len) override;
+
+    size_t size() const { return size_; }
+    bool overflow() const { return overflow_; }
+private:
+    char *buf_;
+    size_t capacity_;
+    size_t size_ = 0;
+    bool overflow_ = false;
+};
+
+
+/* 写到FILE*，不负责关闭 */
+class FileSink : public JsonSink{
+public:
+    explicit FileSink(FILE *fp):fp_(fp){}
+    void write(const char *data, size_t len) override;
+    void flush() override { fflush(fp_); }
+
+    bool fail() const { return fail_; }
+private:
+    FILE *fp_;
+    bool fail_ = false;
+};
+
+
+/* 写到文件描述符，不负责关闭 */
+class FdSink : public JsonSink{
+public:
+    explicit FdSink(int fd):fd_(fd){}
+    void write(const char *data, size_t len) override;
+
+    bool fail() const { return fail_; }
+private:
+    int fd_;
+    bool fail_ = false;
+};
+
+
+/* 流式序列化：整棵树只遍历一次，先写进内部缓冲区，满了再整块交给sink
+   支持所有JsonFormatType以及PrintFormatter的缩进、ensure_ascii设置 */
+class JsonWriter{
+public:
+    static constexpr size_t buffer_size = 16 * 1024;
+
+    JsonWriter(JsonSink &sink, const PrintFormatter &format = PrintFormatter());
+    ~JsonWriter();
+
+    JsonWriter(const JsonWriter &) = delete;
+    JsonWriter &operator=(const JsonWriter &) = delete;
+
+    /* 写出以node为根的整棵树，depth为起始的缩进层数 */
+    void write(const JsonNode &node, int depth = 0);
+    /* 把缓冲区交给sink，并让sink把数据写到底(如FileSink的fflush) */
+    void flush();
+
+private:
+    void writeValue(const JsonNode &node, int depth);
+    void writeArray(const JsonArray &arr, int depth);
+    void writeObject(const JsonObject &obj, int depth);
+    void writeString(std::string_view str, EscapeHint hint = EscapeHint::Unknown);
+    /* 写出一个需要转义的字符开头的部分，返回用掉的字节数 */
+    size_t writeEscape(std::string_view str);
+    void writeUnicode(unsigned int u);
+    void newline(int depth);
+    /* 只把缓冲区交给sink，缓冲区满时用 */
+    void drain();
+
+    /* 保证缓冲区里至少还有n字节空闲，n不超过buffer_size */
+    void reserve(size_t n){
+        if(buffer_size - len_ < n){
+            drain();
+        }
+    }
+    void put(char c){
+        reserve(1);
+        buf_[len_++] = c;
+    }
+    void put(const char *data, size_t n);
+    void put(std::string_view s){ put(s.data(), s.size()); }
+
+private:
+    JsonSink &sink_;
+    PrintFormatter format_;
+    std::string indent_;
+    size_t len_ = 0;
+    char buf_[buffer_size];
+};
+
+} // namespace json
+
+} // namespace haha
+
+#endif
@@ -0,0 +1,74 @@
+#include <string>
+#include <iostream>
+#include <chrono>
+#include "json.h"
+
+namespace JSON = haha::json;
+
+/* 用不同线程数解析同一份NDJSON，取几次中最快的一次 */
+static double run(const std::string &input, const JSON::ParseOptions &popts, JSON::LinesOptions opts,
+                  JSON::LinesStats &stats){
+    double best = 1e30;
+    for(int k = 0; k < 5; ++k){
+        size_t sum = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        stats = JSON::parseLines(input, [&](JSON::LineResult &res){
+            if(res.value){
+                sum += res.value->isObject();
+            }
+        }, popts, opts);
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+        if(sum + stats.errors != stats.lines){
+            std::cout << "unexpected result" << std::endl;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char **argv){
+    std::string input;
+    if(argc > 1){
+        JSON::JsonBuffer buffer;
+        if(!buffer.readFile(argv[1])){
+            std::cout << "read " << argv[1] << " failed" << std::endl;
+            return 1;
+        }
+        input.assign(buffer.to_stringview());
+    }
+    else{
+        // 日志式的记录，每1000行混一行坏数据
+        for(int i = 0; i < 200000; ++i){
+            if(i % 1000 == 999){
+                input += "{\"id\": " + std::to_string(i) + ", \"broken\n";
+                continue;
+            }
+            input += "{\"id\":" + std::to_string(i) + ",\"name\":\"user" + std::to_string(i)
+                   + "\",\"active\":" + (i % 2 ? "true" : "false")
+                   + ",\"score\":" + std::to_string(i * 0.25)
+                   + ",\"path\":\"/api/v1/items/" + std::to_string(i % 97) + "\\/detail\""
+                   + ",\"tags\":[1,2,null]}\n";
+        }
+    }
+    std::cout << "input " << input.size() / 1024 / 1024.0 << " MB, hardware threads "
+              << std::thread::hardware_concurrency() << std::endl;
+
+    JSON::ParseOptions popts;
+    for(bool arena : {false, true}){
+        double base = 0;
+        for(unsigned threads : {1u, 2u, 4u, 8u}){
+            JSON::LinesOptions opts;
+            opts.threads = threads;
+            opts.arena = arena;
+            JSON::LinesStats stats;
+            double ms = run(input, popts, opts, stats);
+            if(threads == 1){
+                base = ms;
+            }
+            std::cout << (arena ? "arena " : "heap  ") << threads << " threads: " << ms << " ms, "
+                      << stats.bytes / 1024 / 1024.0 / (ms / 1000) << " MB/s, speedup " << base / ms
+                      << ", lines " << stats.lines << ", errors " << stats.errors << std::endl;
+        }
+    }
+    return 0;
+}
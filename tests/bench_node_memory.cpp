@@ -0,0 +1,85 @@
+#include <string>
+#include <iostream>
+#include <malloc.h>
+#include "json.h"
+
+namespace JSON = haha::json;
+
+/* 统计树里的节点数，对象的键不算节点 */
+static size_t count_nodes(JSON::JsonNode &node){
+    size_t n = 1;
+    if(node.isArray()){
+        for(auto &v : static_cast<JSON::JsonArray&>(node)){
+            n += count_nodes(*v);
+        }
+    }
+    else if(node.isObject()){
+        for(auto &kv : static_cast<JSON::JsonObject&>(node)){
+            n += count_nodes(*kv.second);
+        }
+    }
+    return n;
+}
+
+int main(int argc, char **argv){
+    std::string input;
+    if(argc > 1){
+        auto js = JSON::fromFile(argv[1]);
+        if(js == nullptr){
+            std::cout << "parse " << argv[1] << " failed" << std::endl;
+            return 1;
+        }
+        input = js->toString();
+    }
+    else{
+        // 类似日志/接口返回的记录：短键为主，一个长键，小整数、短字符串、布尔和浮点数
+        auto root = std::make_shared<JSON::JsonArray>();
+        for(int i = 0; i < 200000; ++i){
+            auto obj = std::make_shared<JSON::JsonObject>();
+            obj->add("id", i);
+            obj->add("name", std::string("user") + std::to_string(i));
+            obj->add("active", i % 2 == 0);
+            obj->add("score", i * 0.25);
+            obj->add("last_login_timestamp", (int64_t)1700000000000 + i);
+            auto tags = std::make_shared<JSON::JsonArray>();
+            tags->add(1);
+            tags->add(2);
+            tags->add();
+            obj->add("tags", std::static_pointer_cast<JSON::JsonNode>(tags));
+            root->add(std::static_pointer_cast<JSON::JsonNode>(obj));
+        }
+        input = root->toString();
+    }
+
+    std::cout << "sizeof: JsonNode " << sizeof(JSON::JsonNode)
+              << ", JsonBoolean " << sizeof(JSON::JsonBoolean)
+              << ", JsonInteger " << sizeof(JSON::JsonInteger)
+              << ", JsonDouble " << sizeof(JSON::JsonDouble)
+              << ", JsonNull " << sizeof(JSON::JsonNull)
+              << ", JsonString " << sizeof(JSON::JsonString)
+              << ", JsonArray " << sizeof(JSON::JsonArray)
+              << ", JsonObject " << sizeof(JSON::JsonObject) << std::endl;
+
+    size_t before = mallinfo2().uordblks;
+    auto js = JSON::parse(input);
+    size_t after = mallinfo2().uordblks;
+    size_t nodes = count_nodes(*js);
+
+    std::cout << "input " << input.size() << " bytes, " << nodes << " nodes, heap "
+              << (after - before) << " bytes, " << (double)(after - before) / nodes
+              << " bytes/node" << std::endl;
+    js.reset();
+
+    // 同样的输入，键从驻留池里取
+    JSON::KeyPool pool;
+    JSON::ParseOptions opts;
+    opts.key_pool = &pool;
+    before = mallinfo2().uordblks;
+    js = JSON::parse(input, opts);
+    after = mallinfo2().uordblks;
+
+    std::cout << "with key pool: heap " << (after - before) << " bytes, " << (double)(after - before) / nodes
+              << " bytes/node; pool " << pool.size() << " keys, " << pool.memoryBytes() << " bytes, "
+              << pool.hits() << " hits, " << pool.misses() << " misses" << std::endl;
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <string>
+#include <iostream>
+#include <chrono>
+#include "json.h"
+
+namespace JSON = haha::json;
+
+/* 原来逐字节的实现，作为对照，和原来一样不内联 */
+__attribute__((noinline)) static std::string_view skip_loop(std::string_view str){
+    while(!str.empty() && JSON::util::isCtrlAndSpace(str[0])){
+        str.remove_prefix(1);
+    }
+    return str;
+}
+
+/* 每跳过一段空白再前进一个字节，模拟解析器在记号之间反复调用 */
+template<typename F>
+static double run(const std::string &input, int rounds, F skip, size_t &checksum){
+    auto start = std::chrono::steady_clock::now();
+    for(int r = 0; r < rounds; ++r){
+        std::string_view view = input;
+        while(!view.empty()){
+            view = skip(view);
+            checksum += view.size();
+            if(!view.empty()){
+                view.remove_prefix(1);
+            }
+        }
+    }
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+    return input.size() * (double)rounds / cost.count() / 1e6;
+}
+
+static void bench(const std::string &name, const std::string &input, int rounds){
+    size_t c1 = 0, c2 = 0;
+    double loop = run(input, rounds, skip_loop, c1);
+    double simd = run(input, rounds, [](std::string_view v){ return JSON::util::skip_CtrlAndSpace(v); }, c2);
+    std::cout << name << ": loop " << loop << " MB/s, simd " << simd << " MB/s"
+              << (c1 == c2 ? "" : "  (result mismatch!)") << std::endl;
+}
+
+int main(){
+    // 本库NEWLINE格式输出的深层嵌套文档
+    auto root = std::make_shared<JSON::JsonArray>();
+    for(int i = 0; i < 2000; ++i){
+        auto obj = std::make_shared<JSON::JsonObject>();
+        obj->add("id", i);
+        obj->add("name", std::string("item") + std::to_string(i));
+        auto inner = std::make_shared<JSON::JsonArray>();
+        auto deep = std::make_shared<JSON::JsonObject>();
+        deep->add("level", std::string("deep"));
+        inner->add(std::static_pointer_cast<JSON::JsonNode>(deep));
+        obj->add("children", std::static_pointer_cast<JSON::JsonNode>(inner));
+        root->add(std::static_pointer_cast<JSON::JsonNode>(obj));
+    }
+    std::string pretty = root->toString({JSON::JsonFormatType::NEWLINE, 1});
+    std::string raw = root->toString();
+
+    // 四空格缩进的深层文档
+    std::string spaces;
+    for(int i = 0; i < 20000; ++i){
+        spaces += "\n" + std::string(4 * (i % 12), ' ') + "x,";
+    }
+
+    // 大段空白
+    std::string blank = std::string(1 << 20, ' ') + "x";
+
+    std::cout << "kernel: " << JSON::StructuralIndex::kernelName() << std::endl;
+    bench("NEWLINE tabs", pretty, 200);
+    bench("RAW", raw, 200);
+    bench("4-space indent", spaces, 100);
+    bench("1MB blank", blank, 200);
+    return 0;
+}
@@ -0,0 +1,1385 @@
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <limits>
+#include <cmath>
+#include <climits>
+#include <string.h>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include "json.h"
+
+namespace JSON = haha::json;
+
+/* 行为测试：每个检查失败时打印出来，最后有失败则返回非0 */
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do{ \
+        if(!(cond)){ \
+            std::cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+            ++failures; \
+        } \
+    }while(0)
+
+/* fn是否抛出异常 */
+template<typename Fn>
+static bool throws(Fn &&fn){
+    try{
+        fn();
+    }
+    catch(const std::exception &){
+        return true;
+    }
+    return false;
+}
+
+/* 按chunk字节一块地喂给PushParser */
+static JSON::JsonNode::ptr push_parse(std::string_view text, size_t chunk){
+    JSON::PushParser parser;
+    for(size_t i = 0; i < text.size(); i += chunk){
+        parser.feed(text.substr(i, chunk));
+    }
+    return parser.finish();
+}
+
+
+/* 把content写进一个临时文件，返回文件名 */
+static std::string write_temp(std::string_view content){
+    char path[] = "/tmp/haha_json_testXXXXXX";
+    int fd = mkstemp(path);
+    if(fd >= 0){
+        CHECK(write(fd, content.data(), content.size()) == (ssize_t)content.size());
+        close(fd);
+    }
+    return path;
+}
+
+/* p是否落在text里 */
+static bool inside(const char *p, std::string_view text){
+    return p >= text.data() && p < text.data() + text.size();
+}
+
+
+/* ---------------------------------------------push parser--------------------------------------------- */
+
+static void test_push(){
+    // 代理对和数字在每个位置被切开，结果都与一次性解析相同
+    std::string text = "{\"s\":\"a\\ud83d\\ude00b\",\"n\":-12.5e-3,\"big\":12345678901234567890}";
+    std::string want = JSON::parse(text)->toString();
+    for(size_t chunk = 1; chunk <= text.size(); ++chunk){
+        auto js = push_parse(text, chunk);
+        CHECK(js != nullptr && js->toString() == want);
+    }
+    auto js = push_parse(text, 3);
+    CHECK(static_cast<JSON::JsonString&>((*js)["s"]).getValue() == "a\xF0\x9F\x98\x80" "b");
+    CHECK(static_cast<JSON::JsonDouble&>((*js)["n"]).getValue() == -12.5e-3);
+    CHECK((*js)["big"].getType() == JSON::JsonType::UInt64);
+
+    // 跨很多块的长字符串
+    std::string big = "[\"" + std::string(100000, 'x') + "\\n\"]";
+    js = push_parse(big, 4096);
+    CHECK(js != nullptr && static_cast<JSON::JsonString&>((*js)[0]).getValue().size() == 100001);
+
+    // 截断的输入报错
+    CHECK(push_parse("[\"\\ud83d", 2) == nullptr);
+    CHECK(push_parse("[1.", 1) == nullptr);
+}
+
+
+/* ---------------------------------------------structural index--------------------------------------------- */
+
+/* 两种方式的结果相同：都失败，或者序列化出的文本一样 */
+static bool same_as_default(std::string_view text, const JSON::ParseOptions &opts){
+    auto want = JSON::parse(text);
+    auto got = JSON::parse(text, opts);
+    if(want == nullptr || got == nullptr){
+        return want == got;
+    }
+    return want->toString() == got->toString();
+}
+
+static void test_structural_index(){
+    JSON::ParseOptions opts;
+    opts.structural_index = true;
+
+    // 含转义的字符串(结束引号带escape_flag)，包括键和紧跟括号、逗号的位置
+    std::vector<std::string> valid = {
+        R"({"a\"b":"x\\","c":["\"]\"",{"d\u00e9":"\ud83d\ude00"}],"e":"\n"})",
+        R"(["\\","\"",""," \" "])",
+        "\"\\u0041\"",
+        "  \t\r\n [ 1 , \n 2.5e-3 ,\t true , null , \"s\" , { \"k\" :\n-0 } ]  \n ",
+        "\n\n42\n\n",
+        "[1,2,]",
+        R"({"a":{},"b":[],"c":[[]]})",
+    };
+    // 跨过simd块边界的长字符串和大量空白
+    std::string big = "[";
+    for(int i = 0; i < 200; ++i){
+        big += std::string(i % 7, ' ') + "\"v" + std::to_string(i) + (i % 3 ? "\\\"" : "") + "\"" + std::string(i % 5, '\n') + ",";
+    }
+    big += "{\"end\":" + std::string(70, ' ') + "1}]";
+    valid.push_back(big);
+    for(auto &text : valid){
+        CHECK(JSON::parse(text, opts) != nullptr);
+        CHECK(same_as_default(text, opts));
+    }
+
+    // 不合法的输入两种方式都拒绝，包括根值之后多出的内容
+    for(auto text : {"[]]", "0]", "1]5", "0\"\"", "01", R"("x y"\/x y")", "{}x", "[1] [2]", "\"a\" 1",
+                     "[1 2]", "{\"a\" 1}", "{\"a\":}", "[\"a]", "tru", "-", "", "   ", "{,}", "[,]"}){
+        CHECK(JSON::parse(text) == nullptr);
+        CHECK(JSON::parse(text, opts) == nullptr);
+    }
+}
+
+
+/* ---------------------------------------------lazy document--------------------------------------------- */
+
+static void test_lazy(){
+    // 跳过的子树里的字符串含有括号、引号和转义，之后的成员仍能找到
+    std::string text = R"({"skip":{"a":"]}","b":["[\"]", "x\\"],"c":{"d":"}]"}},)"
+                       R"("arr":[["]"],{"k":"]"},3],"id":42,"name":"n\u00e9"})";
+    JSON::LazyDocument doc;
+    CHECK(doc.parse(text));
+    auto root = doc.root();
+    CHECK(root["id"].getInt() == 42);
+    CHECK(root["arr"].size() == 3);
+    CHECK(root["arr"][2].getInt() == 3);
+    CHECK(root["arr"][1]["k"].getString() == "]");
+    CHECK(root["skip"]["c"]["d"].getString() == "}]");
+    CHECK(root["name"].toNode()->toString() == JSON::parse(R"("n\u00e9")")->toString());
+    // 再次访问走记下的位置，结果不变
+    CHECK(root["id"].getInt() == 42);
+    CHECK(!root.find("missing").valid());
+    CHECK(root.toNode()->toString() == JSON::parse(text)->toString());
+
+    // 跨过simd块边界的长字符串，转义的引号后面紧跟括号
+    std::string fill;
+    for(int i = 0; i < 50; ++i){
+        fill += "ab]\\\"}[";
+    }
+    std::string long_text = "[{\"s\":\"" + fill + "\"},[\"" + fill + "\"],7]";
+    JSON::LazyDocument long_doc;
+    CHECK(long_doc.parse(long_text));
+    CHECK(long_doc.root()[2].getInt() == 7);
+    CHECK(long_doc.root().size() == 3);
+}
+
+
+/* ---------------------------------------------projection--------------------------------------------- */
+
+static void test_projection(){
+    std::string text = R"({"user":{"id":7,"name":"x"},"events":[{"ts":1,"p":"a"},{"p":"b"},{"ts":3}],)"
+                       R"("cfg":{"a":{"on":true,"v":1},"b":{"on":false},"c":5},"arr":[10,[20,"]"],30]})";
+    auto select = [&](JSON::Projection proj){
+        auto js = JSON::parse(text, proj);
+        return js ? js->toString() : std::string("null");
+    };
+    // 数组上的*：没有选中字段的元素不保留
+    CHECK(select({"/events/*/ts"}) == R"({"events":[{"ts":1},{"ts":3}]})");
+    // 对象上的*，以及与具体键重叠时取并集
+    CHECK(select({"/cfg/*/on"}) == R"({"cfg":{"a":{"on":true},"b":{"on":false}}})");
+    CHECK(select({"/cfg/*/on", "/cfg/a"}) == R"({"cfg":{"a":{"on":true,"v":1},"b":{"on":false}}})");
+    CHECK(select({"/*/id"}) == R"({"user":{"id":7}})");
+    // 选中的值整个保留，其中的字符串含有括号也不影响
+    CHECK(select({"/arr/1"}) == R"({"arr":[[20,"]"]]})");
+    CHECK(select({"/user", "/arr/*"}) == R"({"user":{"id":7,"name":"x"},"arr":[10,[20,"]"],30]})");
+    CHECK(select({"/nothing"}) == "{}");
+    // 跳过的部分有语法错误时仍然报错
+    CHECK(JSON::parse(R"({"a":1,"b":[1,}")", JSON::Projection{"/a"}) == nullptr);
+}
+
+
+/* ---------------------------------------------json path--------------------------------------------- */
+
+static std::string select_all(const JSON::JsonNode &root, std::string_view path){
+    std::vector<const JSON::JsonNode*> out;
+    JSON::JsonPath::compile(path).select(root, out);
+    std::string res;
+    for(auto node : out){
+        res += (res.empty() ? "" : " ") + node->toString();
+    }
+    return res;
+}
+
+static bool compile_throws(std::string_view path, bool pointer = false){
+    try{
+        pointer ? JSON::JsonPath::fromPointer(path) : JSON::JsonPath::compile(path);
+    }
+    catch(const std::exception &){
+        return true;
+    }
+    return false;
+}
+
+static void test_path(){
+    auto js = JSON::parse(R"({"store":{"book":[{"t":"a","price":8},{"t":"b","price":8.0},{"t":"c","price":12.5},)"
+                          R"({"t":"d","price":9007199254740993},{"t":"e","price":"8"},{"t":"f"}],"t":"top"},)"
+                          R"("a~b":{"c/d":1}})");
+    // 过滤：整数与浮点数按数值比较，大整数精确比较，类型不同只满足!=，缺少字段的不参与比较
+    CHECK(select_all(*js, "$.store.book[?(@.price == 8)].t") == R"("a" "b")");
+    CHECK(select_all(*js, "$.store.book[?(@.price < 10)].t") == R"("a" "b")");
+    CHECK(select_all(*js, "$.store.book[?(@.price >= 8.5)].t") == R"("c" "d")");
+    CHECK(select_all(*js, "$.store.book[?(@.price != 8)].t") == R"("c" "d" "e")");
+    CHECK(select_all(*js, "$.store.book[?(@.price == 9007199254740993)].t") == R"("d")");
+    CHECK(select_all(*js, "$.store.book[?(@.price == 9007199254740992)].t") == "");
+    CHECK(select_all(*js, "$.store.book[?(@.price == '8')].t") == R"("e")");
+    CHECK(select_all(*js, "$.store.book[?(@.price)].t") == R"("a" "b" "c" "d" "e")");
+    // ..：先是节点自身的匹配，再依次是各个后代的
+    CHECK(select_all(*js, "$..t") == R"("top" "a" "b" "c" "d" "e" "f")");
+    // 负数下标从末尾数，越界时没有匹配
+    CHECK(select_all(*js, "$.store.book[-1].t") == R"("f")");
+    CHECK(select_all(*js, "$.store.book[-6].t") == R"("a")");
+    CHECK(select_all(*js, "$.store.book[-7].t") == "");
+    CHECK(select_all(*js, "$['a~b']['c/d']") == "1");
+
+    // JSON Pointer
+    CHECK(JSON::JsonPath::fromPointer("").first(*js) == js.get());
+    CHECK(JSON::JsonPath::fromPointer("/a~0b/c~1d").first(*js)->toString() == "1");
+    CHECK(JSON::JsonPath::fromPointer("/store/book/-").first(*js) == nullptr);
+    CHECK(JSON::JsonPath::fromPointer("/store/book/01").first(*js) == nullptr);
+
+    // 不合法的路径在编译时抛出异常
+    for(auto path : {"store", "$.", "$..", "$[", "$[1", "$['a]", "$.a]", "$[?(@.a ==)]", "$[?(@.a == 1)"}){
+        CHECK(compile_throws(path));
+    }
+    for(auto pointer : {"a", "/a~2", "/a~"}){
+        CHECK(compile_throws(pointer, true));
+    }
+}
+
+
+/* ---------------------------------------------snapshot--------------------------------------------- */
+
+static void test_snapshot(){
+    std::string text = R"({"user":{"name":"amy","tags":["a","b"]},"limits":{"qps":5},"debug":true})";
+    JSON::JsonSnapshot base(JSON::parse(text));
+    JSON::JsonSnapshot v1 = base;
+    JSON::JsonSnapshot v2 = base;
+    CHECK(v1.sharedWith(base) == 9);
+
+    v1.set("/user/name", std::make_shared<JSON::JsonString>("bob"));
+    v1.edit<JSON::JsonInteger>("/limits/qps").getValue() = 10;
+    v2.erase("/debug");
+    v2.set("/user/tags/-", std::make_shared<JSON::JsonString>("c"));
+
+    // 各个版本互不影响，原来的版本不变
+    CHECK(base.root()->toString() == JSON::parse(text)->toString());
+    CHECK(v1.root()->toString() == R"({"user":{"name":"bob","tags":["a","b"]},"limits":{"qps":10},"debug":true})");
+    CHECK(v2.root()->toString() == R"({"user":{"name":"amy","tags":["a","b","c"]},"limits":{"qps":5}})");
+    // 没改到的子树仍然共享
+    CHECK(JSON::JsonPath::fromPointer("/user/tags").first(*v1.root()) == JSON::JsonPath::fromPointer("/user/tags").first(*base.root()));
+    CHECK(JSON::JsonPath::fromPointer("/limits").first(*v2.root()) == JSON::JsonPath::fromPointer("/limits").first(*base.root()));
+
+    // 从一个版本再复制出的版本修改时，前一个版本也不变
+    JSON::JsonSnapshot v3 = v1;
+    v3.set("/user/tags/0", std::make_shared<JSON::JsonString>("z"));
+    CHECK(v1.get("/user/tags/0")->toString() == R"("a")");
+    CHECK(v3.get("/user/tags/0")->toString() == R"("z")");
+    CHECK(base.get("/user/tags/0")->toString() == R"("a")");
+
+    CHECK(!v1.erase("/missing"));
+    CHECK(v1.get("/missing") == nullptr);
+}
+
+
+/* ---------------------------------------------equality and hash--------------------------------------------- */
+
+static void test_hash(){
+    auto a = JSON::parse("[[1]]");
+    auto b = JSON::parse("[[2]]");
+    const JSON::JsonArray &outer = static_cast<const JSON::JsonArray&>(*a);
+    auto inner = JSON::pointer_cast<JSON::JsonArray>(outer.getValue()[0]);
+    CHECK(*a != *b);
+    CHECK(a->hash() != b->hash());
+    // 通过子节点自己改，祖先缓存的哈希不能再用
+    static_cast<JSON::JsonInteger&>(*inner->getValue()[0]).getValue() = 2;
+    CHECK(a->toString() == b->toString());
+    CHECK(*a == *b);
+    CHECK(a->hash() == b->hash());
+
+    // 换掉子节点同样如此
+    inner->getValue()[0] = std::make_shared<JSON::JsonString>("x");
+    CHECK(*a != *b);
+    CHECK(a->hash() == JSON::parse(R"([["x"]])")->hash());
+
+    // 对象与成员顺序无关，数字按数值比较
+    auto x = JSON::parse(R"({"a":1,"b":[1.0,"s"]})");
+    auto y = JSON::parse(R"({"b":[1,"s"],"a":1.0})");
+    CHECK(*x == *y);
+    CHECK(x->hash() == y->hash());
+
+    // 作为哈希表的键，修改后按新值查找
+    std::unordered_map<JSON::JsonNode::ptr, int, JSON::JsonNodeHash, JSON::JsonNodeEqual> map;
+    map[x] = 1;
+    CHECK(map.count(y) == 1);
+    static_cast<JSON::JsonObject&>(*y).get<JSON::JsonDouble>("a").getValue() = 5;
+    CHECK(*x != *y);
+    CHECK(x->hash() != y->hash());
+
+    // 缓存有效时不重新计算：绕过访问器改掉一个字节，哈希仍是改之前的
+    auto tree = JSON::parse(R"([{"k":"abc"},[1,2]])");
+    uint64_t h = tree->hash();
+    auto &k = static_cast<const JSON::JsonObject&>(*static_cast<const JSON::JsonArray&>(*tree).getValue()[0]).getValue().at("k");
+    const_cast<std::string&>(static_cast<const JSON::JsonString&>(*k).getValue())[0] = 'x';
+    CHECK(tree->hash() == h);
+    // 解析别的文档、修改和遍历别的树(包括算过哈希的)都不让这棵树的缓存失效
+    auto other = JSON::parse(R"({"a":[1],"b":2})");
+    other->hash();
+    static_cast<JSON::JsonObject&>(*other).add("c", 3);
+    for(auto &kv : static_cast<JSON::JsonObject&>(*other)){
+        (void)kv;
+    }
+    CHECK(JSON::parse(R"({"k":1})") != nullptr);
+    CHECK(other->hash() == JSON::parse(R"({"a":[1],"b":2,"c":3})")->hash());
+    CHECK(tree->hash() == h);
+    // 正常地访问过之后重新计算
+    static_cast<JSON::JsonString&>(*k).getValue();
+    CHECK(tree->hash() == JSON::parse(R"([{"k":"xbc"},[1,2]])")->hash());
+
+    // 复制出的树有自己的缓存，修改副本不影响原来的
+    auto copy = std::make_shared<JSON::JsonArray>(static_cast<const JSON::JsonArray&>(*a));
+    CHECK(copy->hash() == a->hash());
+    auto &first = static_cast<const JSON::JsonArray&>(*copy->getValue()[0]).getValue()[0];
+    static_cast<JSON::JsonString&>(*first).getValue() = "y";
+    CHECK(copy->hash() == JSON::parse(R"([["y"]])")->hash());
+    CHECK(a->hash() == JSON::parse(R"([["x"]])")->hash());
+}
+
+
+/* ---------------------------------------------node pool--------------------------------------------- */
+
+static void test_node_pool(){
+    std::string text = R"([{"unit":"ms"},{"unit":"ms"},"host","host"])";
+    JSON::NodePool pool;
+    JSON::ParseOptions opts;
+    opts.node_pool = &pool;
+    auto js = JSON::parse(text, opts);
+    CHECK(js->toString() == JSON::parse(text)->toString());
+    // 默认只合并标量：相同的字符串共享，容器各是各的
+    auto &arr = static_cast<JSON::JsonArray&>(*js).getValue();
+    CHECK(arr[2] == arr[3]);
+    CHECK(arr[0] != arr[1]);
+    CHECK(pool.stats().merged == 2);
+    // 给一个对象加成员不影响另一个
+    static_cast<JSON::JsonObject&>(*arr[0]).add("x", 1);
+    CHECK(js->toString() == R"([{"unit":"ms","x":1},{"unit":"ms"},"host","host"])");
+    // 池里的节点是只读的：改一处会抛出异常，别处不变；换掉节点可以
+    CHECK(arr[2]->readOnly());
+    CHECK(throws([&]{ static_cast<JSON::JsonString&>(*arr[2]).getValue() = "db"; }));
+    CHECK(throws([&]{ static_cast<JSON::JsonString&>(*arr[3]) = JSON::JsonString("db"); }));
+    CHECK(js->toString() == R"([{"unit":"ms","x":1},{"unit":"ms"},"host","host"])");
+    arr[2] = std::make_shared<JSON::JsonString>("db");
+    CHECK(js->toString() == R"([{"unit":"ms","x":1},{"unit":"ms"},"db","host"])");
+    // 再次解析时拿到的还是池里那一份，内容没被改过
+    auto again = JSON::parse(text, opts);
+    CHECK(again->toString() == JSON::parse(text)->toString());
+    CHECK(static_cast<const JSON::JsonArray&>(*again).getValue()[3] == arr[3]);
+    // 拷贝出的节点可以改
+    JSON::JsonString copy(static_cast<const JSON::JsonString&>(*arr[3]));
+    copy.getValue() = "db";
+    CHECK(copy.view() == "db" && static_cast<const JSON::JsonString&>(*arr[3]).view() == "host");
+
+    // 共享子树时相同的对象只留一份，经JsonSnapshot修改时另一处不变
+    JSON::NodePool shared(true);
+    opts.node_pool = &shared;
+    JSON::JsonSnapshot snap(JSON::parse(text, opts));
+    auto &list = static_cast<const JSON::JsonArray&>(*snap.root()).getValue();
+    CHECK(list[0] == list[1]);
+    CHECK(throws([&]{ static_cast<JSON::JsonObject&>(*list[0]).add("x", 1); }));
+    snap.set("/0/x", std::make_shared<JSON::JsonInteger>(1));
+    CHECK(snap.root()->toString() == R"([{"unit":"ms","x":1},{"unit":"ms"},"host","host"])");
+    // 池放掉节点后只读的标记还在，JsonSnapshot照样先复制
+    shared.clear();
+    snap.set("/1/unit", std::make_shared<JSON::JsonString>("s"));
+    CHECK(snap.root()->toString() == R"([{"unit":"ms","x":1},{"unit":"s"},"host","host"])");
+    // 已经合并过(只读)的树交给另一个池
+    JSON::NodePool other(true);
+    CHECK(other.dedup(JSON::parse(text, opts))->toString() == JSON::parse(text)->toString());
+
+    // 已有的树去重
+    JSON::DedupStats stats;
+    auto tree = JSON::dedup(JSON::parse(text), &stats);
+    CHECK(stats.merged == 2);
+    CHECK(tree->toString() == JSON::parse(text)->toString());
+}
+
+
+/* ---------------------------------------------json lines--------------------------------------------- */
+
+static void test_lines(){
+    // 空行和只有空白的行跳过，CRLF的\r不算内容，出错的行只影响自己
+    std::string input = "{\"a\":1}\n[1,2]\r\n\n  \nbad\n\"s\"\r\n3 4\n5";
+    JSON::LinesOptions opts;
+    opts.threads = 3;
+    opts.batch_bytes = 1;
+    std::vector<JSON::LineResult> got;
+    auto stats = JSON::parseLines(input, [&](JSON::LineResult &res){ got.push_back(res); }, JSON::ParseOptions(), opts);
+    CHECK(stats.ok && stats.lines == 6 && stats.errors == 2);
+    std::vector<size_t> lines;
+    for(auto &res : got){
+        lines.push_back(res.line);
+    }
+    CHECK((lines == std::vector<size_t>{1, 2, 5, 6, 7, 8}));
+    if(got.size() == 6){
+        CHECK(got[1].text == "[1,2]" && got[1].value->toString() == "[1,2]");
+        CHECK(got[2].text == "bad" && got[2].value == nullptr);
+        CHECK(got[3].text == "\"s\"" && got[3].offset == input.find("\"s\""));
+        CHECK(got[4].text == "3 4" && got[4].value == nullptr);
+        CHECK(got[5].value != nullptr && got[5].value->toString() == "5");
+    }
+
+    // 很多批：按顺序交付时行号递增；不按顺序时同样的行都交付了，每批内仍按顺序
+    std::string many;
+    std::vector<std::string> want;
+    for(int i = 0; i < 500; ++i){
+        want.push_back("{\"i\":" + std::to_string(i) + ",\"s\":[\"" + std::string(i % 13, 'x') + "\"]}");
+        many += want.back() + (i % 2 ? "\r\n" : "\n");
+    }
+    opts.batch_bytes = 64;
+    for(bool ordered : {true, false}){
+        for(bool arena : {false, true}){
+            opts.ordered = ordered;
+            opts.arena = arena;
+            std::vector<bool> seen(want.size(), false);
+            size_t last = 0;
+            bool in_order = true, match = true;
+            stats = JSON::parseLines(many, [&](JSON::LineResult &res){
+                in_order = in_order && res.line > last;
+                last = res.line;
+                // 内存池模式下节点只在回调里有效，这里就比较
+                match = match && res.value && res.value->toString() == want[res.line - 1];
+                seen[res.line - 1] = true;
+            }, JSON::ParseOptions(), opts);
+            CHECK(stats.lines == want.size() && stats.errors == 0);
+            CHECK(match);
+            CHECK(std::find(seen.begin(), seen.end(), false) == seen.end());
+            if(ordered){
+                CHECK(in_order);
+            }
+        }
+    }
+
+    // 在调用者给的线程池的线程里调用，只有一个线程时也不能死锁
+    JSON::ThreadPool pool(1);
+    opts.pool = &pool;
+    opts.ordered = true;
+    opts.arena = false;
+    size_t count = 0;
+    {
+        JSON::TaskGroup group(pool);
+        group.run([&](unsigned){
+            JSON::parseLines(many, [&](JSON::LineResult &res){ count += res.value != nullptr; }, JSON::ParseOptions(), opts);
+        });
+    }
+    CHECK(count == want.size());
+}
+
+
+/* ---------------------------------------------parallel--------------------------------------------- */
+
+static void test_parallel(){
+    // 切分只发生在不小于4096字节的容器上，输入要足够大才真的并行
+    std::string arr = "[";
+    std::string obj = "{";
+    for(int i = 0; i < 3000; ++i){
+        std::string k = "\"k" + std::to_string(i % 1000) + "\"";   // 每个键出现三次，分散在不同的段里
+        std::string v = "{\"id\":" + std::to_string(i) + ",\"tags\":[\"a\\\"b\",[" + std::to_string(i % 7) + ",[]]],\"id\":-1}";
+        arr += (i ? "," : "") + v;
+        obj += (i ? "," : "") + k + ":" + v;
+    }
+    arr += "]";
+    obj += "}";
+    std::string nested = "{\"arr\":" + arr + ",\"obj\":" + obj + ",\"arr\":[]}";
+
+    JSON::ParseOptions par;
+    par.threads = 3;
+    par.parallel_min_bytes = 0;
+    JSON::ThreadPool pool(2);
+    JSON::ParseOptions with_pool = par;
+    with_pool.threads = 1;
+    with_pool.pool = &pool;
+    for(auto &text : {arr, obj, nested}){
+        auto want = JSON::parse(text);
+        CHECK(want != nullptr);
+        for(auto &opts : {par, with_pool}){
+            auto got = JSON::parse(text, opts);
+            CHECK(got != nullptr && got->toString() == want->toString());
+        }
+    }
+    // 重复的键保留第一个，与逐个解析相同
+    auto js = JSON::parse(nested, par);
+    CHECK(js != nullptr && (*js)["arr"].getType() == JSON::JsonType::Array && static_cast<JSON::JsonArray&>((*js)["arr"]).size() == 3000);
+    CHECK(js != nullptr && static_cast<JSON::JsonObject&>((*js)["obj"]).size() == 1000);
+    CHECK(js != nullptr && static_cast<JSON::JsonInteger&>((*js)["obj"]["k5"]["id"]).getValue() == 5);
+
+    // 错误在任何一段里都要报出来，根值之后的内容同样拒绝
+    std::string bad = arr;
+    bad[bad.size() / 2] = '?';
+    CHECK(JSON::parse(bad, par) == nullptr);
+    CHECK(JSON::parse(arr + "]", par) == nullptr);
+    CHECK(JSON::parse(arr + " x", par) == nullptr);
+    CHECK(JSON::parse(arr + " \n", par) != nullptr);
+
+    // 不并行的情况照常解析：根是标量、没有足够大的容器、Document的节点在内存池里
+    CHECK(JSON::parse("\"" + std::string(10000, 's') + "\"", par) != nullptr);
+    CHECK(JSON::parse("[1,[2],{\"a\":3}]", par)->toString() == "[1,[2],{\"a\":3}]");
+    JSON::Document doc;
+    CHECK(doc.parse(nested, par) && doc.root()->toString() == JSON::parse(nested)->toString());
+}
+
+
+/* ---------------------------------------------borrowed--------------------------------------------- */
+
+static void test_borrowed(){
+    JSON::ParseOptions opts;
+    opts.borrowed = true;
+    const std::string input = R"({"plain":"abc","esc":"x\ny\u00e9","k\"ey":[""]})";
+    const std::string original = input;
+
+    // 只读的输入：无转义的字符串引用输入，含转义的反转义进解析器的字符串池，输入不变
+    auto js = JSON::parse(std::string_view(input), opts);
+    CHECK(js != nullptr);
+    auto &plain = static_cast<JSON::JsonString&>((*js)["plain"]);
+    auto &esc = static_cast<JSON::JsonString&>((*js)["esc"]);
+    CHECK(plain.isBorrowed() && inside(plain.view().data(), input) && plain.view() == "abc");
+    CHECK(esc.isBorrowed() && !inside(esc.view().data(), input) && esc.view() == "x\ny\xC3\xA9");
+    CHECK(input == original);
+    CHECK(js->toString() == JSON::parse(input)->toString());
+
+    // 修改时先拷贝，不再引用输入
+    plain.getValue() += "d";
+    CHECK(!plain.isBorrowed() && !inside(plain.view().data(), input) && plain.view() == "abcd");
+
+    // 可写的输入：含转义的字符串原地反转义，同样引用输入
+    std::string buf = original;
+    JSON::ParseContext ctx(opts);
+    ctx.setWritable(buf.data(), buf.data() + buf.size(), nullptr);
+    std::string_view view = buf;
+    js = JSON::parse_value(view, ctx);
+    CHECK(js != nullptr);
+    auto &esc2 = static_cast<JSON::JsonString&>((*js)["esc"]);
+    CHECK(inside(esc2.view().data(), buf) && esc2.view() == "x\ny\xC3\xA9");
+    CHECK(buf != original);
+    CHECK(static_cast<JSON::JsonString&>((*js)[std::string("k\"ey")][0]).view().empty());
+
+    // 内存池里的文档：只读的输入先拷进内存池，反转义后的字符串也在内存池里
+    JSON::Document doc;
+    CHECK(doc.parse(original) && !inside(static_cast<const JSON::JsonString&>((*doc.root())["plain"]).view().data(), original));
+
+    // fromFile：缓冲区由节点持有，取出的子节点比根和文件都活得久
+    std::string path = write_temp(original);
+    js = JSON::fromFile(path, opts);
+    unlink(path.c_str());
+    CHECK(js != nullptr);
+    JSON::JsonNode::ptr child;
+    if(js){
+        child = static_cast<JSON::JsonObject&>(*js).getValue().find("esc")->second;
+    }
+    js = nullptr;
+    CHECK(child != nullptr && static_cast<JSON::JsonString&>(*child).view() == "x\ny\xC3\xA9");
+}
+
+
+/* ---------------------------------------------numbers--------------------------------------------- */
+
+static void test_numbers(){
+    // 放得下int的用Integer，其余依次是Int64、UInt64，都放不下才是Double
+    struct Case{ const char *text; JSON::JsonType type; };
+    for(auto c : std::initializer_list<Case>{
+        {"2147483647", JSON::JsonType::Integer},
+        {"2147483648", JSON::JsonType::Int64},
+        {"-2147483648", JSON::JsonType::Integer},
+        {"-2147483649", JSON::JsonType::Int64},
+        {"-9223372036854775808", JSON::JsonType::Int64},
+        {"9223372036854775807", JSON::JsonType::Int64},
+        {"9223372036854775808", JSON::JsonType::UInt64},
+        {"18446744073709551615", JSON::JsonType::UInt64},
+        {"18446744073709551616", JSON::JsonType::Double},
+        {"-9223372036854775809", JSON::JsonType::Double},
+        {"-0", JSON::JsonType::Integer},
+        {"0.0", JSON::JsonType::Double},
+        {"1E5", JSON::JsonType::Double},
+    }){
+        auto js = JSON::parse(c.text);
+        CHECK(js != nullptr && js->getType() == c.type);
+    }
+    CHECK(static_cast<JSON::JsonInt64&>(*JSON::parse("-9223372036854775808")).getValue() == INT64_MIN);
+    CHECK(static_cast<JSON::JsonUInt64&>(*JSON::parse("18446744073709551615")).getValue() == UINT64_MAX);
+    CHECK(static_cast<JSON::JsonDouble&>(*JSON::parse("18446744073709551616")).getValue() == 18446744073709551616.0);
+    CHECK(JSON::parse("[9223372036854775808]")->toString() == "[9223372036854775808]");
+
+    // 严格的语法：不合法的数字返回nullptr而不是抛出异常，超出double范围的也拒绝
+    for(auto text : {"01", "-01", "1.", "-", ".5", "1e", "1e+", "+1", "0x1", "1.e5", "[1.]", "{\"a\":01}", "1e400", "-1e400"}){
+        JSON::JsonNode::ptr js;
+        CHECK(!throws([&]{ js = JSON::parse(text); }));
+        CHECK(js == nullptr);
+    }
+}
+
+
+/* ---------------------------------------------lazy numbers--------------------------------------------- */
+
+static void test_lazy_numbers(){
+    JSON::ParseOptions opts;
+    opts.lazy_numbers = true;
+
+    // 未修改的数字原样输出，逐字节相同
+    std::string text = "[1E-5,-0,1e10,0.10,12345678901234567890,-7]";
+    auto js = JSON::parse(text, opts);
+    CHECK(js != nullptr && js->toString() == text);
+    auto &arr = static_cast<JSON::JsonArray&>(*js);
+    CHECK(static_cast<const JSON::JsonDouble&>(arr[0]).getValue() == 1e-5);
+    CHECK(static_cast<const JSON::JsonInteger&>(arr[1]).getValue() == 0);
+    CHECK(static_cast<const JSON::JsonDouble&>(arr[2]).getValue() == 1e10);
+    CHECK(arr[4].getType() == JSON::JsonType::UInt64);
+    // const访问转换之后仍保留原文
+    CHECK(js->toString() == text);
+
+    // 修改之后不再输出原文
+    static_cast<JSON::JsonDouble&>(arr[2]).getValue() = 2.5;
+    auto &neg = static_cast<JSON::JsonInteger&>(arr[5]);
+    CHECK(neg.getValue() == -7 && neg.raw().empty());
+    neg.getValue() = 8;
+    CHECK(js->toString() == "[1E-5,-0,2.5,0.10,12345678901234567890,8]");
+
+    // 超出double范围的数字同非延迟模式一样拒绝
+    for(auto bad : {"1e400", "[1,-1e400]", "01", "1."}){
+        CHECK(JSON::parse(bad, opts) == nullptr);
+    }
+    CHECK(JSON::parse("1e308", opts) != nullptr);
+
+    // 多个线程同时第一次转换同一个数字
+    for(int round = 0; round < 50; ++round){
+        auto num = JSON::parse("[3.25e2]", opts);
+        const auto &d = static_cast<const JSON::JsonDouble&>(static_cast<JSON::JsonArray&>(*num)[0]);
+        std::vector<double> got(4);
+        std::vector<std::thread> threads;
+        for(size_t i = 0; i < got.size(); ++i){
+            threads.emplace_back([&, i]{ got[i] = d.getValue(); });
+        }
+        for(auto &t : threads){
+            t.join();
+        }
+        CHECK(std::count(got.begin(), got.end(), 325.0) == (long)got.size());
+    }
+}
+
+
+/* ---------------------------------------------number format--------------------------------------------- */
+
+static std::string format(double d, JSON::FloatFormat ff = JSON::FloatFormat::Shortest, int precision = -1){
+    char buf[JSON::number_buffer_size];
+    return std::string(buf, JSON::formatNumber(buf, d, ff, precision));
+}
+
+static void test_number_format(){
+    // 最短表示，像整数的补上.0，非有限值输出null
+    CHECK(format(0.1) == "0.1");
+    CHECK(format(0.30000000000000004) == "0.30000000000000004");
+    CHECK(format(1e308) == "1e+308");
+    CHECK(format(1e-9) == "1e-09");
+    CHECK(format(5e-324) == "5e-324");
+    CHECK(format(1.0) == "1.0");
+    CHECK(format(-0.0) == "-0.0");
+    CHECK(format(123456789012345680.0) == "123456789012345680.0");
+    CHECK(format(std::numeric_limits<double>::quiet_NaN()) == "null");
+    CHECK(format(std::numeric_limits<double>::infinity()) == "null");
+    CHECK(format(-std::numeric_limits<double>::infinity()) == "null");
+
+    // 指定记法和精度
+    CHECK(format(2.0 / 3, JSON::FloatFormat::Fixed, 3) == "0.667");
+    CHECK(format(1234.5, JSON::FloatFormat::Scientific, 2) == "1.23e+03");
+    CHECK(JSON::JsonDouble(3).toString(JSON::PrintFormatter().setFloatFormat(JSON::FloatFormat::Fixed, 2)) == "3.00");
+
+    // 整数
+    char buf[JSON::number_buffer_size];
+    CHECK(std::string(buf, JSON::formatNumber(buf, INT_MIN)) == "-2147483648");
+    CHECK(std::string(buf, JSON::formatNumber(buf, (int64_t)INT64_MIN)) == "-9223372036854775808");
+    CHECK(std::string(buf, JSON::formatNumber(buf, (uint64_t)UINT64_MAX)) == "18446744073709551615");
+    CHECK(std::string(buf, JSON::formatNumber(buf, 0)) == "0");
+
+    // 输出能原样读回，类型仍是Double
+    uint64_t x = 88172645463325252ull;
+    for(int i = 0; i < 2000; ++i){
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        double d;
+        memcpy(&d, &x, sizeof(d));
+        if(!std::isfinite(d)){
+            continue;
+        }
+        auto js = JSON::parse(format(d));
+        CHECK(js != nullptr && js->getType() == JSON::JsonType::Double && static_cast<JSON::JsonDouble&>(*js).getValue() == d);
+    }
+
+    // 树里的非有限值同样输出null，结果仍是合法的JSON
+    JSON::JsonArray arr;
+    arr.add(std::numeric_limits<double>::infinity());
+    arr.add(2.0);
+    CHECK(arr.toString() == "[null,2.0]");
+}
+
+
+/* ---------------------------------------------writer--------------------------------------------- */
+
+/* 读出整个文件 */
+static std::string read_all(FILE *fp){
+    std::string out;
+    char buf[4096];
+    rewind(fp);
+    while(size_t n = fread(buf, 1, sizeof(buf), fp)){
+        out.append(buf, n);
+    }
+    return out;
+}
+
+static void test_writer(){
+    auto js = JSON::parse(R"({"b":[1,{"d":"x","c":null}],"a":{},"e":[]})");
+    CHECK(js->toString() == R"({"b":[1,{"d":"x","c":null}],"a":{},"e":[]})");
+    CHECK(js->toString(JSON::PrintFormatter(JSON::JsonFormatType::SPACE)) == R"({"b": [1, {"d": "x", "c": null}], "a": {}, "e": []})");
+    // 缩进的字符和个数，空容器不换行
+    CHECK(js->toString(JSON::PrintFormatter(JSON::JsonFormatType::NEWLINE, 2).setIndentChar(' ')) ==
+          "{\n  \"b\": [\n    1,\n    {\n      \"d\": \"x\",\n      \"c\": null\n    }\n  ],\n  \"a\": {},\n  \"e\": []\n}");
+    CHECK(js->toString(JSON::PrintFormatter(JSON::JsonFormatType::NEWLINE)) ==
+          "{\n\t\"b\": [\n\t\t1,\n\t\t{\n\t\t\t\"d\": \"x\",\n\t\t\t\"c\": null\n\t\t}\n\t],\n\t\"a\": {},\n\t\"e\": []\n}");
+    // 每一层都按键排序，树本身的顺序不变
+    CHECK(js->toString(JSON::PrintFormatter().setSortKeys(true)) == R"({"a":{},"b":[1,{"c":null,"d":"x"}],"e":[]})");
+    CHECK(js->toString() == R"({"b":[1,{"d":"x","c":null}],"a":{},"e":[]})");
+
+    // 比内部缓冲区大得多的输出，各个sink的结果都与toString相同
+    JSON::JsonArray big;
+    for(int i = 0; i < 5000; ++i){
+        big.add("item \"" + std::to_string(i) + "\"\n");
+        big.add(i * 0.5);
+    }
+    auto fmt = JSON::PrintFormatter(JSON::JsonFormatType::NEWLINE, 1);
+    std::string want = big.toString(fmt);
+    CHECK(want.size() > 4 * JSON::JsonWriter::buffer_size);
+
+    std::string out;
+    {
+        JSON::StringSink sink(out);
+        JSON::JsonWriter writer(sink, fmt);
+        writer.write(big);
+    }
+    CHECK(out == want);
+
+    // 定长缓冲区：放得下时完整写入，放不下时截断并标记overflow
+    std::vector<char> buf(want.size());
+    {
+        JSON::FixedBufferSink sink(buf.data(), buf.size());
+        JSON::JsonWriter writer(sink, fmt);
+        writer.write(big);
+        writer.flush();
+        CHECK(!sink.overflow() && sink.size() == want.size() && std::string_view(buf.data(), buf.size()) == want);
+    }
+    {
+        JSON::FixedBufferSink sink(buf.data(), 100);
+        JSON::JsonWriter writer(sink, fmt);
+        writer.write(big);
+        writer.flush();
+        CHECK(sink.overflow() && sink.size() == 100 && std::string_view(buf.data(), 100) == want.substr(0, 100));
+    }
+
+    FILE *fp = tmpfile();
+    {
+        JSON::FileSink sink(fp);
+        JSON::JsonWriter writer(sink, fmt);
+        writer.write(big);
+        writer.flush();
+        CHECK(!sink.fail());
+    }
+    CHECK(read_all(fp) == want);
+    fclose(fp);
+
+    fp = tmpfile();
+    {
+        JSON::FdSink sink(fileno(fp));
+        JSON::JsonWriter writer(sink, fmt);
+        writer.write(big);
+        writer.flush();
+        CHECK(!sink.fail());
+    }
+    CHECK(read_all(fp) == want);
+    fclose(fp);
+    {
+        JSON::FdSink sink(-1);
+        JSON::JsonWriter writer(sink);
+        writer.write(big);
+        writer.flush();
+        CHECK(sink.fail());
+    }
+}
+
+
+/* ---------------------------------------------escape--------------------------------------------- */
+
+/* 逐字节的参考实现，不处理ensure_ascii */
+static std::string escape_ref(std::string_view str){
+    std::string out = "\"";
+    for(unsigned char c : str){
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if(c < 0x20){
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+            else{
+                out += (char)c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+static void test_escape(){
+    auto ascii = JSON::PrintFormatter(JSON::JsonFormatType::RAW, 0, true);
+
+    // 没有名字的控制字符输出\u00XX，DEL和'/'不转义
+    std::string ctrl("a\x01\x1f\x7f\b\f\n\r\t\"\\/\0z", 14);
+    CHECK(JSON::JsonString(ctrl).toString() == "\"a\\u0001\\u001f\x7f\\b\\f\\n\\r\\t\\\"\\\\/\\u0000z\"");
+    auto back = JSON::parse(JSON::JsonString(ctrl).toString());
+    CHECK(back != nullptr && static_cast<JSON::JsonString&>(*back).getValue() == ctrl);
+
+    // ensure_ascii：BMP内的字符输出\uXXXX，之外的输出代理对，非法的UTF-8输出U+FFFD
+    std::string utf8 = "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80";
+    CHECK(JSON::JsonString(utf8).toString(ascii) == "\"\\u00e9\\u20ac\\ud83d\\ude00\"");
+    CHECK(JSON::JsonString(utf8).toString() == "\"" + utf8 + "\"");
+    CHECK(JSON::JsonString(std::string("\xff\xC3")).toString(ascii) == "\"\\ufffd\\ufffd\"");
+    back = JSON::parse(JSON::JsonString(utf8).toString(ascii));
+    CHECK(back != nullptr && static_cast<JSON::JsonString&>(*back).getValue() == utf8);
+
+    // 要转义的字符落在simd块的各个位置，与逐字节的结果相同
+    for(size_t len : {15, 16, 17, 31, 32, 33, 63, 64, 65, 100}){
+        for(size_t pos = 0; pos < len; ++pos){
+            for(char c : {'"', '\\', '\n', '\x02'}){
+                std::string str(len, 'x');
+                str[pos] = c;
+                CHECK(JSON::JsonString(str).toString() == escape_ref(str));
+                CHECK(JSON::JsonString(str).toString(ascii) == escape_ref(str));
+            }
+        }
+    }
+
+    // 解析时记下的"不用转义"提示：修改后作废，照样转义
+    auto js = JSON::parse(R"(["clean","caf\u00e9"])");
+    auto &clean = static_cast<JSON::JsonString&>((*js)[0]);
+    CHECK(js->toString(ascii) == R"(["clean","caf\u00e9"])");
+    CHECK(js->toString() == "[\"clean\",\"caf\xC3\xA9\"]");
+    clean.getValue() = "a\"b";
+    CHECK(js->toString() == "[\"a\\\"b\",\"caf\xC3\xA9\"]");
+}
+
+
+/* ---------------------------------------------file input--------------------------------------------- */
+
+static void test_file_input(){
+    // 普通文件走mmap，私有映射上的修改不写回文件
+    std::string text = R"({"k":"v\n","n":[1,2,3]})";
+    std::string path = write_temp(text);
+    {
+        JSON::JsonBuffer buffer;
+        CHECK(buffer.readFile(path.c_str()) && buffer.to_stringview() == text);
+        buffer.data()[2] = 'X';
+        JSON::JsonBuffer again;
+        CHECK(again.readFile(path.c_str()) && again.to_stringview() == text);
+    }
+    // 借用模式在映射上原地反转义，同样不改动文件
+    JSON::ParseOptions borrowed;
+    borrowed.borrowed = true;
+    auto js = JSON::fromFile(path, borrowed);
+    CHECK(js != nullptr && js->toString() == text);
+    js = JSON::fromFile(path);
+    CHECK(js != nullptr && js->toString() == text);
+    unlink(path.c_str());
+
+    // 空文件和打不开的文件
+    path = write_temp("");
+    {
+        JSON::JsonBuffer buffer;
+        CHECK(buffer.readFile(path.c_str()) && buffer.len() == 0);
+    }
+    CHECK(JSON::fromFile(path) == nullptr);
+    unlink(path.c_str());
+    CHECK(JSON::fromFile(path) == nullptr);
+
+    // 管道取不到大小，退回read()；数据比初始的匿名映射大，要mremap扩容几次
+    std::string big = "[";
+    while(big.size() < 10 * JSON::JsonBuffer::read_block_size){
+        big += "\"" + std::string(1000, 'p') + "\",";
+    }
+    big += "0]";
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    std::thread writer([&]{
+        size_t off = 0;
+        while(off < big.size()){
+            ssize_t n = write(fds[1], big.data() + off, big.size() - off);
+            if(n <= 0){
+                break;
+            }
+            off += n;
+        }
+        close(fds[1]);
+    });
+    {
+        JSON::JsonBuffer buffer;
+        std::string fdpath = "/dev/fd/" + std::to_string(fds[0]);
+        CHECK(buffer.readFile(fdpath.c_str()) && buffer.to_stringview() == big);
+    }
+    writer.join();
+    close(fds[0]);
+
+    // /proc下的文件大小为0，同样读得出内容
+    JSON::JsonBuffer proc;
+    CHECK(proc.readFile("/proc/self/stat") && proc.len() > 0);
+}
+
+
+/* ---------------------------------------------document--------------------------------------------- */
+
+static void test_document(){
+    std::string text = R"({"s":"a\tb","n":[1,2.5,-3],"o":{"k":true}})";
+    JSON::Document doc;
+    CHECK(doc.arenaBytes() == 0 && doc.root() == nullptr);
+    CHECK(doc.parse(text) && doc.root()->toString() == text);
+    CHECK(doc.arenaBytes() >= text.size());
+    // 输入拷进了内存池，调用者的输入可以随即释放
+    CHECK(static_cast<const JSON::JsonString&>((*doc.root())["s"]).view() == "a\tb");
+
+    // 失败时没有根，同一个文档可以重新解析
+    CHECK(!doc.parse("[1,") && doc.root() == nullptr);
+    CHECK(!doc.parse("[1] x") && doc.root() == nullptr);
+    CHECK(doc.parse("[true]") && doc.root()->toString() == "[true]");
+
+    std::string path = write_temp(text);
+    JSON::Document from_file;
+    CHECK(from_file.parseFile(path.c_str()) && from_file.root()->toString() == text);
+    unlink(path.c_str());
+    CHECK(!from_file.parseFile(path.c_str()) && from_file.root() == nullptr);
+
+    // 移动赋值：先释放旧树再换内存池，旧树的节点不能在它的内存池释放之后才析构
+    JSON::Document other;
+    CHECK(other.parse(text));
+    doc = std::move(other);
+    CHECK(doc.root() != nullptr && doc.root()->toString() == text);
+    JSON::Document moved(std::move(doc));
+    CHECK(moved.root() != nullptr && moved.root()->toString() == text);
+    moved = JSON::Document();
+    CHECK(moved.root() == nullptr);
+}
+
+
+/* ---------------------------------------------tape--------------------------------------------- */
+
+static void test_tape(){
+    std::string text = R"({"a":[1,-2147483649,18446744073709551615,2.5,"s\n",true,false,null,[],{}],"b":{"c":{"d":"e"}},"a2":[[[0]]]})";
+    JSON::JsonTape tape;
+    CHECK(tape.parse(text));
+    auto root = tape.root();
+    CHECK(root.valid() && root.isObject() && root.size() == 3);
+    CHECK(root.toNode()->toString() == JSON::parse(text)->toString());
+    CHECK(root.toString() == JSON::parse(text)->toString());
+    CHECK(root["b"].toNode()->toString() == R"({"c":{"d":"e"}})");
+
+    auto a = root["a"];
+    CHECK(a.isArray() && a.size() == 10);
+    CHECK(a[0].getInt() == 1 && a[0].getInt64() == 1 && a[0].getDouble() == 1.0);
+    CHECK(a[1].isInt64() && a[1].getInt64() == -2147483649ll);
+    CHECK(a[2].isUInt64() && a[2].getUInt64() == UINT64_MAX);
+    CHECK(a[3].getDouble() == 2.5 && a[4].getString() == "s\n");
+    CHECK(a[5].getBool() && !a[6].getBool() && a[7].isNull());
+    CHECK(a[8].isArray() && a[8].size() == 0 && a[9].isObject() && a[9].size() == 0);
+    CHECK(root["b"]["c"]["d"].getString() == "e");
+
+    // find找不到返回无效视图，operator[]越界、找不到或类型不符时抛出异常
+    CHECK(!root.find("x").valid() && root.find("a2").valid());
+    CHECK(throws([&]{ root["x"]; }));
+    CHECK(throws([&]{ a[10]; }));
+    CHECK(throws([&]{ a[0]["k"]; }));
+    CHECK(throws([&]{ a[4].getInt(); }));
+    CHECK(throws([&]{ a[3].getInt(); }));
+
+    // 迭代器按顺序给出键和值，跳过嵌套的容器
+    std::vector<std::string> keys;
+    for(auto it = root.begin(); it != root.end(); ++it){
+        keys.emplace_back(it.key());
+    }
+    CHECK((keys == std::vector<std::string>{"a", "b", "a2"}));
+    size_t n = 0;
+    for(auto v : a){
+        CHECK(v.getType() == (*JSON::parse(text))["a"][n].getType());
+        ++n;
+    }
+    CHECK(n == 10);
+
+    // 元素个数超过max_count时开始字里的个数饱和，size()逐个数
+    std::string many = "[";
+    for(uint64_t i = 0; i < JSON::JsonTape::max_count + 2; ++i){
+        many += "0,";
+    }
+    many.back() = ']';
+    CHECK(tape.parse(many) && tape.root().size() == JSON::JsonTape::max_count + 2);
+    std::string small = "[" + std::string("1,1,1") + "]";
+    CHECK(tape.parse(small) && tape.root().size() == 3);
+
+    // 不合法的输入返回false并清空tape
+    for(auto bad : {"", "[,1]", "{\"a\"}", "[1 2]", "[\"a]", "01", "[1]]", "{\"a\":1 \"b\":2}", "nul", "[1e400]", "[\"\\x\"]"}){
+        CHECK(!tape.parse(bad) && !tape.root().valid());
+    }
+    // 末尾多余的逗号同parse()一样接受
+    CHECK(tape.parse("[1,]") && tape.root().size() == 1 && JSON::parse("[1,]") != nullptr);
+    CHECK(tape.parse("{\"a\":1,}") && tape.root().size() == 1 && JSON::parse("{\"a\":1,}") != nullptr);
+}
+
+
+/* ---------------------------------------------object map--------------------------------------------- */
+
+static void test_object_map(){
+    using Policy = JSON::ObjectIndexPolicy;
+    // 各种查找方式下，成员数跨过hash_threshold前后都按插入顺序排列、查找结果相同
+    for(auto policy : {Policy::Auto, Policy::Linear, Policy::Hash}){
+        JSON::ObjectMap<int> map(policy);
+        std::vector<std::string> keys;
+        for(int i = 0; i < 40; ++i){
+            keys.push_back(i % 2 ? "field_" + std::to_string(i) : "a_rather_long_key_number_" + std::to_string(i));
+            CHECK(map.emplace(keys.back(), i).second);
+            for(int j = 0; j <= i; ++j){
+                auto it = map.find(keys[j]);
+                CHECK(it != map.end() && it->second == j);
+            }
+            CHECK(map.find("missing") == map.end() && map.find("") == map.end());
+        }
+        // 键已存在时不覆盖
+        auto [it, inserted] = map.emplace(keys[3], 100);
+        CHECK(!inserted && it->second == 3 && map.size() == 40);
+        int expect = 0;
+        for(auto &kv : map){
+            CHECK(kv.first.view() == keys[expect] && kv.second == expect);
+            ++expect;
+        }
+
+        // 删除之后重建索引，其余成员的顺序和查找都不受影响；删到阈值以下再加回来
+        for(int i = 0; i < 40; i += 3){
+            CHECK(map.erase(keys[i]) == 1);
+            CHECK(map.erase(keys[i]) == 0);
+        }
+        for(int i = 0; i < 40; ++i){
+            auto it = map.find(keys[i]);
+            CHECK(i % 3 == 0 ? it == map.end() : it != map.end() && it->second == i);
+        }
+        int prev = -1;
+        for(auto &kv : map){
+            CHECK(kv.second > prev);
+            prev = kv.second;
+        }
+        for(int i = 0; i < 40; ++i){
+            if(i % 3 != 0 && i > 5){
+                map.erase(keys[i]);
+            }
+        }
+        CHECK(map.size() == 4 && map.find(keys[4])->second == 4 && map.find(keys[6]) == map.end());
+        map.emplace(keys[6], 6);
+        CHECK(map.find(keys[6])->second == 6 && (map.end() - 1)->first.view() == keys[6]);
+
+        CHECK(throws([&]{ map.at(std::string_view("missing")); }));
+        map.clear();
+        CHECK(map.empty() && map.find(keys[1]) == map.end());
+    }
+
+    // 解析出的对象按原文的顺序输出，重复的键保留第一个
+    std::string text = "{";
+    for(int i = 30; i > 0; --i){
+        text += "\"k" + std::to_string(i) + "\":" + std::to_string(i) + ",";
+    }
+    text += "\"k7\":0}";
+    for(auto policy : {Policy::Auto, Policy::Linear, Policy::Hash}){
+        JSON::ParseOptions opts;
+        opts.object_index = policy;
+        auto js = JSON::parse(text, opts);
+        CHECK(js != nullptr && static_cast<JSON::JsonObject&>(*js).size() == 30);
+        CHECK(static_cast<JSON::JsonInteger&>((*js)["k7"]).getValue() == 7);
+        CHECK(js->toString().compare(0, 14, "{\"k30\":30,\"k29") == 0);
+        CHECK(static_cast<JSON::JsonObject&>(*js).getValue().policy() == policy);
+    }
+}
+
+
+/* ---------------------------------------------keys--------------------------------------------- */
+
+static void test_keys(){
+    // 不超过16字节的键就地存放，更长的单独分配，拷贝和移动后内容不变
+    std::string long_key(40, 'L');
+    for(auto text : {std::string(""), std::string(16, 's'), std::string(17, 'h'), long_key}){
+        JSON::ObjectKey key(text);
+        CHECK(!key.isInterned() && key.view() == text);
+        JSON::ObjectKey copy(key);
+        CHECK(copy == key && copy.view() == text && (text.size() <= 16 || copy.data() != key.data()));
+        JSON::ObjectKey moved(std::move(copy));
+        CHECK(moved.view() == text && copy.empty());
+        JSON::ObjectKey assigned("x");
+        assigned = moved;
+        CHECK(assigned.view() == text);
+        assigned = JSON::ObjectKey(long_key);
+        CHECK(assigned.view() == long_key && key.view() == text);
+    }
+
+    // 按string_view、字面量和JsonKey查找、删除
+    auto js = JSON::parse(R"({"id":1,"name":"n","tags":[]})");
+    auto &obj = static_cast<JSON::JsonObject&>(*js);
+    JSON::JsonKey name("name");
+    CHECK(obj.get<JSON::JsonString>("name").getValue() == "n");
+    CHECK(obj.get<JSON::JsonString>(name).getValue() == "n" && name.hint() == 1);
+    CHECK(obj.find("nope") == nullptr && obj.find(JSON::JsonKey("nope")) == nullptr);
+    CHECK(throws([&]{ obj.get("nope"); }));
+    CHECK(obj.contains(std::string("tags")));
+
+    // 提示在同样结构的对象间复用；结构不同时提示失效，照常查找并更新提示
+    JSON::JsonKey id("id");
+    auto rows = JSON::parse(R"([{"id":1,"v":0},{"id":2,"v":0},{"v":0,"id":3},{"v":0},{"a":0,"b":0,"c":0,"id":5}])");
+    std::vector<int64_t> got;
+    std::vector<uint32_t> hints;
+    for(auto &row : static_cast<JSON::JsonArray&>(*rows)){
+        auto found = static_cast<JSON::JsonObject&>(*row).find(id);
+        got.push_back(found ? static_cast<JSON::JsonInteger&>(*found).getValue() : -1);
+        hints.push_back(id.hint());
+    }
+    CHECK((got == std::vector<int64_t>{1, 2, 3, -1, 5}));
+    CHECK((hints == std::vector<uint32_t>{0, 0, 1, 1, 3}));
+    // 提示超出小对象的范围时不会越界
+    CHECK(static_cast<JSON::JsonInteger&>((*JSON::parse(R"({"id":9})"))[id]).getValue() == 9);
+
+    // 删除后用同一个JsonKey查不到
+    CHECK(obj.del(name) == 1 && obj.find(name) == nullptr && obj.del("name") == 0);
+    CHECK(obj.toString() == R"({"id":1,"tags":[]})");
+}
+
+
+/* ---------------------------------------------key pool--------------------------------------------- */
+
+static void test_key_pool(){
+    JSON::KeyPool pool;
+    JSON::ParseOptions opts;
+    opts.key_pool = &pool;
+
+    // 多次解析共用一个池：相同的键只有一份，对象里存的是池里的指针
+    std::string long_key(30, 'k');
+    std::string text = R"({"id":1,"name":"a",")" + long_key + R"(":{"id":2}})";
+    auto a = JSON::parse(text, opts);
+    auto b = JSON::parse(text, opts);
+    CHECK(a != nullptr && b != nullptr && pool.size() == 3);
+    CHECK(pool.misses() == 3 && pool.hits() == 1 + 4);
+    auto &ka = static_cast<JSON::JsonObject&>(*a).begin()->first;
+    auto &kb = static_cast<JSON::JsonObject&>(*b).begin()->first;
+    CHECK(ka.isInterned() && kb.isInterned() && ka.interned() == kb.interned());
+    CHECK(ka.interned() == pool.find("id") && pool.find("nope") == nullptr);
+    CHECK(static_cast<JSON::JsonObject&>(*a).getValue().find(long_key)->first.interned() == pool.find(long_key));
+    CHECK(*a == *b && a->toString() == text);
+
+    // 驻留的键与普通的键、别的池里的键按内容比较
+    JSON::KeyPool other;
+    JSON::ObjectKey plain("id");
+    JSON::ObjectKey from_other(other.intern("id"));
+    CHECK(ka == plain && plain == ka && ka == from_other && ka != JSON::ObjectKey(other.intern("name")));
+    auto c = JSON::parse(text);
+    CHECK(*a == *c && c->toString() == text);
+
+    // 驻留的键可以照常查找、删除、复制
+    auto &obj = static_cast<JSON::JsonObject&>(*a);
+    CHECK(static_cast<JSON::JsonInteger&>(obj.get(JSON::JsonKey("id"))).getValue() == 1);
+    JSON::JsonObject copy(obj);
+    CHECK(copy.begin()->first.interned() == pool.find("id"));
+    CHECK(obj.del("name") == 1 && copy.contains("name"));
+
+    // 多个线程同时用一个池解析
+    pool.resetStats();
+    CHECK(pool.hits() == 0 && pool.misses() == 0);
+    std::vector<std::thread> threads;
+    std::vector<char> ok(4, false);
+    for(int t = 0; t < 4; ++t){
+        threads.emplace_back([&, t]{
+            bool good = true;
+            for(int i = 0; i < 200; ++i){
+                std::string doc = "{\"shared\":1,\"t" + std::to_string(t) + "_" + std::to_string(i % 50) + "\":2}";
+                auto js = JSON::parse(doc, opts);
+                good = good && js != nullptr && js->toString() == doc;
+            }
+            ok[t] = good;
+        });
+    }
+    for(auto &t : threads){
+        t.join();
+    }
+    CHECK(std::count(ok.begin(), ok.end(), true) == 4);
+    CHECK(pool.size() == 3 + 1 + 4 * 50 && pool.hits() + pool.misses() == 4 * 200 * 2);
+    CHECK(pool.memoryBytes() > 0);
+}
+
+
+/* ---------------------------------------------sax--------------------------------------------- */
+
+/* 把事件记成一串文本，stop_key为遇到时要求停止的键 */
+struct Recorder : JSON::SaxHandler{
+    std::string log;
+    std::string_view stop_key;
+
+    bool onNull() { log += "n "; return true; }
+    bool onBool(bool b) { log += b ? "t " : "f "; return true; }
+    bool onInt(int v) { log += "i" + std::to_string(v) + " "; return true; }
+    bool onInt64(int64_t v) { log += "l" + std::to_string(v) + " "; return true; }
+    bool onUInt64(uint64_t v) { log += "u" + std::to_string(v) + " "; return true; }
+    bool onDouble(double v) { log += "d" + std::to_string(v) + " "; return true; }
+    bool onString(std::string_view s) { log += "s" + std::string(s) + " "; return true; }
+    bool onKey(std::string_view k) {
+        log += "k" + std::string(k) + " ";
+        return k != stop_key;
+    }
+    bool onObjectStart() { log += "{ "; return true; }
+    bool onObjectEnd(size_t n) { log += "}" + std::to_string(n) + " "; return true; }
+    bool onArrayStart() { log += "[ "; return true; }
+    bool onArrayEnd(size_t n) { log += "]" + std::to_string(n) + " "; return true; }
+};
+
+/* 跳过所有数组 */
+struct SkipArrays : Recorder{
+    bool skipValue(char first) { return first == '['; }
+};
+
+/* 整个接管对象：只数个数，交给另一个SaxReader把它读完 */
+struct TakeObjects : Recorder{
+    int taken = 0;
+    bool takeContainer(std::string_view &str, bool &ok){
+        if(str[0] != '{'){
+            return false;
+        }
+        JSON::SaxHandler inner;
+        ok = JSON::SaxReader<JSON::SaxHandler>(inner).parseValue(str) == JSON::SaxResult::Ok;
+        ++taken;
+        return true;
+    }
+};
+
+/* 只用原文的事件 */
+struct Raw : JSON::SaxHandler{
+    std::vector<std::string> numbers;
+    std::vector<bool> integer;
+    std::vector<std::string> strings;
+    std::vector<const char*> escaped;
+    std::vector<JSON::EscapeHint> hints;
+
+    bool onRawNumber(std::string_view raw, const JSON::NumberToken &tok){
+        numbers.emplace_back(raw);
+        integer.push_back(tok.integer);
+        return true;
+    }
+    bool onRawString(std::string_view value, const char *esc, JSON::EscapeHint hint){
+        strings.emplace_back(value);
+        escaped.push_back(esc);
+        hints.push_back(hint);
+        return true;
+    }
+};
+
+static void test_sax(){
+    // 事件的顺序和容器的成员个数；分块的事件解析给出同样的事件
+    std::string text = R"({"a":[1,-2147483649,18446744073709551615,2.5,"x\ty",true,false,null],"b":{},"c":[[]]})";
+    std::string want = "{ ka [ i1 l-2147483649 u18446744073709551615 d2.500000 sx\ty t f n ]8 kb { }0 kc [ [ ]0 ]1 }3 ";
+    Recorder rec;
+    CHECK(JSON::parse_sax(text, rec) == JSON::SaxResult::Ok && rec.log == want);
+    for(size_t chunk : {1, 3, 7}){
+        Recorder pushed;
+        JSON::SaxPushParser<Recorder> parser(pushed);
+        for(size_t i = 0; i < text.size(); i += chunk){
+            parser.feed(std::string_view(text).substr(i, chunk));
+        }
+        CHECK(parser.finish() == JSON::SaxResult::Ok && pushed.log == want);
+    }
+
+    // 处理器返回false时立即停止，之后没有事件
+    Recorder stop;
+    stop.stop_key = "b";
+    CHECK(JSON::parse_sax(text, stop) == JSON::SaxResult::Stopped);
+    CHECK(stop.log == "{ ka [ i1 l-2147483649 u18446744073709551615 d2.500000 sx\ty t f n ]8 kb ");
+
+    // 语法错误：出错之前的事件已经发出；根值之后多出的内容和超出范围的数字同样报错
+    Recorder bad;
+    CHECK(JSON::parse_sax(R"({"a":[1,2 3]})", bad) == JSON::SaxResult::Error && bad.log == "{ ka [ i1 i2 ");
+    for(auto text : {"[1] x", "[1e400]", "{\"a\" 1}", "", "01"}){
+        Recorder r;
+        CHECK(JSON::parse_sax(text, r) == JSON::SaxResult::Error);
+    }
+
+    // 跳过的值不产生事件，也不检查里面的语法
+    SkipArrays skip;
+    CHECK(JSON::parse_sax(R"({"a":[1,{]],"b":"s","c":[tru]})", skip) == JSON::SaxResult::Ok);
+    CHECK(skip.log == "{ ka kb ss kc }3 ");
+    SkipArrays unclosed;
+    CHECK(JSON::parse_sax(R"({"a":[1,2})", unclosed) == JSON::SaxResult::Error);
+
+    // 接管的容器不产生事件，接管出错时整个解析报错
+    TakeObjects take;
+    CHECK(JSON::parse_sax(R"([{"a":[1]},2,{"b":{}}])", take) == JSON::SaxResult::Ok);
+    CHECK(take.taken == 2 && take.log == "[ i2 ]3 ");
+    TakeObjects take_bad;
+    CHECK(JSON::parse_sax(R"([{"a":}])", take_bad) == JSON::SaxResult::Error);
+
+    // 原文事件：数字给出原文，含转义的字符串给出反转义后的内容和在输入中的位置
+    Raw raw;
+    std::string raw_text = R"(["plain","caf\u00e9",1E-5,-0,12345678901234567890123,"\u00e9"])";
+    CHECK(JSON::parse_sax(raw_text, raw) == JSON::SaxResult::Ok);
+    CHECK((raw.numbers == std::vector<std::string>{"1E-5", "-0", "12345678901234567890123"}));
+    CHECK((raw.integer == std::vector<bool>{false, true, true}));
+    CHECK((raw.strings == std::vector<std::string>{"plain", "caf\xC3\xA9", "\xC3\xA9"}));
+    CHECK(raw.escaped.size() == 3 && raw.escaped[0] == nullptr);
+    CHECK(raw.escaped.size() == 3 && inside(raw.escaped[1], raw_text) && std::string_view(raw.escaped[1], 4) == "caf\\");
+    CHECK(raw.escaped.size() == 3 && inside(raw.escaped[2], raw_text) && raw.escaped[2][0] == '\\');
+    CHECK(raw.hints.size() == 3 && raw.hints[0] == JSON::EscapeHint::CleanAscii);
+}
+
+
+int main(){
+    test_structural_index();
+    test_push();
+    test_lazy();
+    test_projection();
+    test_path();
+    test_snapshot();
+    test_hash();
+    test_node_pool();
+    test_lines();
+    test_parallel();
+    test_borrowed();
+    test_numbers();
+    test_lazy_numbers();
+    test_number_format();
+    test_writer();
+    test_escape();
+    test_file_input();
+    test_document();
+    test_tape();
+    test_object_map();
+    test_keys();
+    test_key_pool();
+    test_sax();
+
+    if(failures){
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all passed" << std::endl;
+    return 0;
+}